@@ -0,0 +1,109 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_BACKGROUNDEVALUATION_H
+#define THRAX_BACKGROUNDEVALUATION_H
+
+#include <random>
+#include <string>
+#include <thread>
+
+#include <thrax/model/AbstractModel.h>
+#include <thrax/struct/Data.h>
+#include "Evaluation.h"
+
+/**
+ * Early stopping evaluation that runs on a background thread while training goes on. The parameters of the trained
+ * model are copied into a second model of the same type, which is evaluated on the validation data and, if it
+ * performs better than the best model so far, dumped. One evaluation runs at a time.
+ */
+class BackgroundEvaluation {
+public:
+    /**
+     * @param snapshotModel model of the same type and size as the trained model, receives the copied parameters
+     * @param data validation data
+     * @param limit number of triples to estimate the performance, -1 means use all
+     * @param confidence confidence of the sequential estimate, see Evaluation::sequentialMRR; 0 evaluates limit triples
+     * @param blockSize number of triples of the first block of the sequential estimate
+     */
+    BackgroundEvaluation(AbstractModel* snapshotModel, Data* data, TripleId limit, double confidence, TripleId blockSize):
+    snapshotModel(snapshotModel),
+    data(data),
+    limit(limit),
+    confidence(confidence),
+    blockSize(blockSize),
+    epoch(-1) {}
+
+    ~BackgroundEvaluation() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+        delete snapshotModel;
+    }
+
+    /**
+     * Copies the parameters of a model and starts to evaluate them. The caller has to synchronize the model.
+     * @param model
+     * @param evaluation has to outlive the evaluation
+     * @param epoch index of the epoch after which the parameters are copied
+     * @param bestValue best filtered MRR so far, the snapshot is dumped if it performs better
+     * @param dumpLocation
+     * @param seed seed of the selection of the validation triples
+     */
+    void start(AbstractModel* model, Evaluation* evaluation, int epoch, double bestValue, std::string dumpLocation, unsigned seed) {
+        snapshotModel->copyParameters(model);
+        this->epoch = epoch;
+        thread = std::thread([this, evaluation, bestValue, dumpLocation, seed]() {
+            std::mt19937 generator(seed);
+            if (confidence > 0.0) {
+                TripleId n = evaluation->sequentialMRR(snapshotModel, data, limit, bestValue, confidence, blockSize, rawMRR, filteredMRR, generator);
+                BOOST_LOG_TRIVIAL(info) << "Early stopping: estimated the MRR on " << n << " validation triples";
+            } else {
+                evaluation->MRR(snapshotModel, data, limit, rawMRR, filteredMRR, generator);
+            }
+            isDumped = filteredMRR > bestValue;
+            if (isDumped) {
+                snapshotModel->dump(dumpLocation);
+            }
+        });
+    }
+
+    /**
+     * Whether an evaluation was started and its result was not taken by wait yet
+     * @return
+     */
+    bool isPending() const {
+        return thread.joinable();
+    }
+
+    /**
+     * Waits for the result of the evaluation
+     * @param rawMRR
+     * @param filteredMRR
+     * @param isDumped whether the snapshot was dumped as the new best model
+     * @return index of the epoch of the snapshot
+     */
+    int wait(double& rawMRR, double& filteredMRR, bool& isDumped) {
+        thread.join();
+        rawMRR = this->rawMRR;
+        filteredMRR = this->filteredMRR;
+        isDumped = this->isDumped;
+        return epoch;
+    }
+
+private:
+    AbstractModel* snapshotModel; /** evaluated copy of the trained model, owned **/
+    Data* data; /** validation data **/
+    TripleId limit; /** number of validation triples, -1 means all **/
+    double confidence; /** confidence of the sequential estimate, 0 if the estimate uses limit triples **/
+    TripleId blockSize; /** number of triples of the first block of the sequential estimate **/
+    std::thread thread; /** runs the evaluation **/
+    int epoch; /** index of the epoch of the snapshot **/
+    double rawMRR; /** result of the last evaluation **/
+    double filteredMRR; /** result of the last evaluation **/
+    bool isDumped; /** whether the snapshot of the last evaluation was dumped **/
+};
+
+
+#endif //THRAX_BACKGROUNDEVALUATION_H
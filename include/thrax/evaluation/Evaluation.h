@@ -5,71 +5,163 @@
 #ifndef THRAX_EVALUATION_H
 #define THRAX_EVALUATION_H
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <Eigen/Dense>
+#include <boost/algorithm/string.hpp>
+#include <boost/math/distributions/normal.hpp>
 #include <boost/timer/timer.hpp>
 #include <boost/filesystem.hpp>
 #include <fstream>
 #include <iostream>
+#include <random>
+
+#include <thrax/struct/CandidateIndex.h>
+#include <thrax/struct/Span.h>
+#include <thrax/struct/TripleIndex.h>
+#include <thrax/util/RandomUtil.h>
 
 using namespace Eigen;
 namespace fs = boost::filesystem;
 
 class Evaluation {
 public:
-    Evaluation(std::vector<Data*> lookupDataSets = std::vector<Data*>()) : lookupDataSets(lookupDataSets) {}
+    /**
+     * Rank of a triple whose score equals the scores of other triples
+     */
+    enum TiePolicy {
+        OPTIMISTIC, /** ranked before all tied triples **/
+        PESSIMISTIC, /** ranked after all tied triples **/
+        REALISTIC /** mean of the optimistic and the pessimistic rank, i.e. the expected rank if ties are broken randomly **/
+    };
+
+    /**
+     * @param lookupDataSets data sets of the existing triples, which are not counted in the filtered setting
+     * @param candidateIndex type constraints of the relations, may be nullptr. If set, evaluate additionally reports
+     * type-constrained metrics and MRR and sequentialMRR rank only the candidates of the relation
+     * @param tiePolicy
+     */
+    Evaluation(std::vector<Data*> lookupDataSets = std::vector<Data*>(), CandidateIndex* candidateIndex = nullptr, TiePolicy tiePolicy = OPTIMISTIC) :
+    lookupDataSets(lookupDataSets), candidateIndex(candidateIndex), tiePolicy(tiePolicy), sampledCandidateIndex(0), sampledOnly(false) {
+        // merge the triples of all lookup data sets into one membership index
+        for (auto data: lookupDataSets) {
+            knownTriples.insert(data->getTriples());
+        }
+    }
+    /**
+     * Parses the tie policy of the config
+     * @param name optimistic, pessimistic or realistic
+     * @return
+     */
+    static TiePolicy parseTiePolicy(std::string name) {
+        boost::algorithm::to_lower(name);
+        if (name == "optimistic") {
+            return OPTIMISTIC;
+        } else if (name == "pessimistic") {
+            return PESSIMISTIC;
+        } else if (name == "realistic") {
+            return REALISTIC;
+        }
+        BOOST_LOG_TRIVIAL(error) << "Unknown tie policy " << name << ", use optimistic, pessimistic or realistic";
+        exit(1);
+    }
+
+    /**
+     * Enables the sampled evaluation: evaluate additionally ranks each triple only against a fixed sample of the
+     * entities and dumps the metrics to the files with the suffix -sampled. With type constraints, the candidates of
+     * each relation are sampled as well. The sample only depends on the seed, so the metrics of runs are comparable.
+     * @param numberOfEntities
+     * @param numberOfCandidates size of the sample
+     * @param seed
+     * @param sampledOnly whether evaluate skips the ranking against all entities
+     */
+    void setSampledCandidates(EntityId numberOfEntities, EntityId numberOfCandidates, unsigned seed, bool sampledOnly) {
+        std::mt19937 generator(seed);
+        std::vector<EntityId> entities(numberOfEntities);
+        std::iota(entities.begin(), entities.end(), 0);
+        sampledEntities = CandidateIndex::sampleSorted(entities, numberOfCandidates, generator);
+        if (candidateIndex != nullptr) {
+            sampledCandidateIndex = candidateIndex->sample(numberOfCandidates, generator);
+        }
+        this->sampledOnly = sampledOnly;
+        BOOST_LOG_TRIVIAL(info) << "Sampled evaluation: ranking against " << sampledEntities.size() << " of " << numberOfEntities << " entities";
+    }
+
     /**
      * Performs evaluation for the model (that was trained on trainData) on the data.
-     * Dumps results to file found in path.
+     * Dumps results to file found in path. With type constraints, the metrics of ranking only the candidates of the
+     * relations are dumped to the files with the suffix -type-constrained, with a sampled evaluation the metrics of
+     * ranking only the sampled entities to the files with the suffix -sampled.
      * @param model
      * @param data
      */
     void evaluate(AbstractModel* model, Data* data, std::string path) {
-        int m = data->getNumberOfTriples();
-        int N = data->getNumberOfEntities();
-        int numberOfRelations = data->getNumberOfRelations();
+        model->synchronize();
+        for (bool sampled: {false, true}) {
+            if (sampled ? sampledEntities.empty() : sampledOnly) {
+                continue;
+            }
+            evaluate(model, data, path, false, sampled);
+            if (candidateIndex != nullptr) {
+                evaluate(model, data, path, true, sampled);
+            }
+        }
+    }
+
+    /**
+     * Ranks all triples of data and dumps the metrics
+     * @param model
+     * @param data
+     * @param path
+     * @param typeConstrained whether only the candidates of the relations are ranked
+     * @param sampled whether only the sampled entities are ranked
+     */
+    void evaluate(AbstractModel* model, Data* data, std::string path, bool typeConstrained, bool sampled) {
+        TripleId m = data->getNumberOfTriples();
+        EntityId N = data->getNumberOfEntities();
+        RelationId numberOfRelations = data->getNumberOfRelations();
 
         // temporary variables
         double positiveScore;
-        VectorXd scores(N);
-        int rawRank;
-        int filteredRank;
+        RankBuffers buffers;
+        double rawRank;
+        double filteredRank;
 
         // rank data structures
-        VectorXi allRanksRaw = VectorXi::Zero(2 * m); /** raw ranks by replacing subject and object **/
-        VectorXi allRanksFiltered = VectorXi::Zero(2 * m); /** filtered ranks by replacing subject and object **/
-        VectorXi subjectRanksRaw = VectorXi::Zero(m); /** raw ranks by replacing subject **/
-        VectorXi subjectRanksFiltered = VectorXi::Zero(m); /** filtered ranks by replacing subject **/
-        VectorXi objectRanksRaw = VectorXi::Zero(m); /** raw ranks by replacing object **/
-        VectorXi objectRanksFiltered = VectorXi::Zero(m); /** filtered ranks by replacing object **/
-
-        std::vector<VectorXi> allRanksRawByRelation(numberOfRelations); /** raw ranks by replacing subject and object by relation**/
-        std::vector<VectorXi> allRanksFilteredByRelation(numberOfRelations); /** filtered ranks by replacing subject and object by relation**/
-        std::vector<VectorXi> subjectRanksRawByRelation(numberOfRelations); /** raw ranks by replacing subject by relation**/
-        std::vector<VectorXi> subjectRanksFilteredByRelation(numberOfRelations); /** filtered ranks by replacing subject by relation**/
-        std::vector<VectorXi> objectRanksRawByRelation(numberOfRelations); /** raw ranks by replacing object by relation**/
-        std::vector<VectorXi> objectRanksFilteredByRelation(numberOfRelations); /** filtered ranks by replacing object by relation**/
-        for (int i = 0; i < numberOfRelations; ++i) {
-            allRanksRawByRelation[i] = VectorXi::Zero(2 * m);
-            allRanksFilteredByRelation[i] =  VectorXi::Zero(2 * m);
-            subjectRanksRawByRelation[i] =  VectorXi::Zero(m);
-            subjectRanksFilteredByRelation[i] =  VectorXi::Zero(m);
-            objectRanksRawByRelation [i] =  VectorXi::Zero(m);
-            objectRanksFilteredByRelation[i] =  VectorXi::Zero(m);
+        VectorXd allRanksRaw = VectorXd::Zero(2 * m); /** raw ranks by replacing subject and object **/
+        VectorXd allRanksFiltered = VectorXd::Zero(2 * m); /** filtered ranks by replacing subject and object **/
+        VectorXd subjectRanksRaw = VectorXd::Zero(m); /** raw ranks by replacing subject **/
+        VectorXd subjectRanksFiltered = VectorXd::Zero(m); /** filtered ranks by replacing subject **/
+        VectorXd objectRanksRaw = VectorXd::Zero(m); /** raw ranks by replacing object **/
+        VectorXd objectRanksFiltered = VectorXd::Zero(m); /** filtered ranks by replacing object **/
+
+        std::vector<VectorXd> allRanksRawByRelation(numberOfRelations); /** raw ranks by replacing subject and object by relation**/
+        std::vector<VectorXd> allRanksFilteredByRelation(numberOfRelations); /** filtered ranks by replacing subject and object by relation**/
+        std::vector<VectorXd> subjectRanksRawByRelation(numberOfRelations); /** raw ranks by replacing subject by relation**/
+        std::vector<VectorXd> subjectRanksFilteredByRelation(numberOfRelations); /** filtered ranks by replacing subject by relation**/
+        std::vector<VectorXd> objectRanksRawByRelation(numberOfRelations); /** raw ranks by replacing object by relation**/
+        std::vector<VectorXd> objectRanksFilteredByRelation(numberOfRelations); /** filtered ranks by replacing object by relation**/
+        for (RelationId i = 0; i < numberOfRelations; ++i) {
+            allRanksRawByRelation[i] = VectorXd::Zero(2 * m);
+            allRanksFilteredByRelation[i] =  VectorXd::Zero(2 * m);
+            subjectRanksRawByRelation[i] =  VectorXd::Zero(m);
+            subjectRanksFilteredByRelation[i] =  VectorXd::Zero(m);
+            objectRanksRawByRelation [i] =  VectorXd::Zero(m);
+            objectRanksFilteredByRelation[i] =  VectorXd::Zero(m);
         }
 
         // timer
         boost::timer::cpu_timer timer;
         // loop over test triples
-        for (int i = 0; i < m; ++i) {
+        for (TripleId i = 0; i < m; ++i) {
             // get test triple
-            Triple &triple = data->getTriple(i);
+            Triple triple = data->getTriple(i);
             // calculate positive score
             positiveScore = model->score(triple);
 
-            // calculate scores by replacing object with all entities
-            calculateScores(model, triple, scores, false);
-            // calculate rank
-            calculateRank(triple, positiveScore, scores, rawRank, filteredRank, false);
+            // calculate rank by replacing object with all entities or the candidates
+            rankTriple(model, N, triple, positiveScore, buffers, rawRank, filteredRank, false, replacements(triple, false, typeConstrained, sampled));
             allRanksRaw[i] = rawRank;
             allRanksFiltered[i] = filteredRank;
             objectRanksRaw[i] = rawRank;
@@ -79,10 +171,8 @@ public:
             objectRanksRawByRelation[triple.relation][i] = rawRank;
             objectRanksFilteredByRelation[triple.relation][i] = filteredRank;
 
-            // calculate scores by replacing object with all entities
-            calculateScores(model, triple, scores, true);
-            // calculate rank
-            calculateRank(triple, positiveScore, scores, rawRank, filteredRank, true);
+            // calculate rank by replacing subject with all entities or the candidates
+            rankTriple(model, N, triple, positiveScore, buffers, rawRank, filteredRank, true, replacements(triple, true, typeConstrained, sampled));
             allRanksRaw[m+i] = rawRank;
             allRanksFiltered[m+i] = filteredRank;
             subjectRanksRaw[i] = rawRank;
@@ -100,12 +190,14 @@ public:
         int n;
 
         // dump metrics to file
+        std::string suffix = std::string(typeConstrained ? "-type-constrained" : "") + (sampled ? "-sampled" : "");
+        std::string label = std::string(typeConstrained ? "TYPE-CONSTRAINED " : "") + (sampled ? "SAMPLED " : "");
         fs::path dir(path);
-        fs::path metricsPath = dir / "metrics.csv";
+        fs::path metricsPath = dir / ("metrics" + suffix + ".csv");
         std::ofstream outf(metricsPath.string());
         outf << "MR,hits@10,hits@1,MRR,filtered,target" << std::endl;
 
-        BOOST_LOG_TRIVIAL(info) << "##### RAW SETTING #####";
+        BOOST_LOG_TRIVIAL(info) << "##### " << label << "RAW SETTING #####";
         calculateMetrics(allRanksRaw, meanRank, hitsAtTen, hitsAtOne, meanReciprocalRank, n);
         BOOST_LOG_TRIVIAL(info) << "Combined: MR: " << meanRank << ", MRR: " << meanReciprocalRank << ", hits@10: " << hitsAtTen << ", hits@1: " << hitsAtOne;
         outf << meanRank << "," << hitsAtTen << "," << hitsAtOne << "," << meanReciprocalRank << "," << "false" << "," << "combined" << std::endl;
@@ -116,7 +208,7 @@ public:
         BOOST_LOG_TRIVIAL(info) << "Predicting subjects: MR: " << meanRank << ", MRR: " << meanReciprocalRank << ", hits@10: " << hitsAtTen << ", hits@1: " << hitsAtOne;
         outf << meanRank << "," << hitsAtTen << "," << hitsAtOne << "," << meanReciprocalRank << "," << "false" << "," << "subject" << std::endl;
 
-        BOOST_LOG_TRIVIAL(info) << "##### FILTERED SETTING #####";
+        BOOST_LOG_TRIVIAL(info) << "##### " << label << "FILTERED SETTING #####";
         calculateMetrics(allRanksFiltered, meanRank, hitsAtTen, hitsAtOne, meanReciprocalRank, n);
         BOOST_LOG_TRIVIAL(info) << "Combined: MR: " << meanRank << ", MRR: " << meanReciprocalRank << ", hits@10: " << hitsAtTen << ", hits@1: " << hitsAtOne;
         outf << meanRank << "," << hitsAtTen << "," << hitsAtOne << "," << meanReciprocalRank << "," << "true" << "," << "combined" << std::endl;
@@ -130,10 +222,10 @@ public:
         outf.close();
 
         // dump metrics by relation to file
-        fs::path metricsByRelationPath = dir / "metrics-by-relation.csv";
+        fs::path metricsByRelationPath = dir / ("metrics-by-relation" + suffix + ".csv");
         outf.open(metricsByRelationPath.string());
         outf << "relation,MR,hits@10,hits@1,MRR,filtered,target,n" << std::endl;
-        for (int i = 0; i < numberOfRelations; ++i) {
+        for (RelationId i = 0; i < numberOfRelations; ++i) {
             calculateMetrics(allRanksRawByRelation[i], meanRank, hitsAtTen, hitsAtOne, meanReciprocalRank, n);
             outf << i << "," << meanRank << "," << hitsAtTen << "," << hitsAtOne << "," << meanReciprocalRank << "," << "false" << "," << "combined" << "," << n << std::endl;
             calculateMetrics(allRanksFilteredByRelation[i], meanRank, hitsAtTen, hitsAtOne, meanReciprocalRank, n);
@@ -150,7 +242,7 @@ public:
         outf.close();
 
         timer.stop();
-        BOOST_LOG_TRIVIAL(info) << "Finished evaluation in " << timer.format(3, "%w sec");
+        BOOST_LOG_TRIVIAL(info) << "Finished " << (typeConstrained ? "type-constrained " : "") << (sampled ? "sampled " : "") << "evaluation in " << timer.format(3, "%w sec");
     }
 
     /**
@@ -159,46 +251,44 @@ public:
      * @param data
      * @param model
      * @param limit number of triples to estimate the performance, -1 means use all
+     * @param generator selects the triples if limit > -1, e.g. a generator of its own when evaluating in the background
      * @return
      */
-    void MRR(AbstractModel* model, Data* data, int limit, double& rawMRR, double& filteredMRR) {
-        int m = data->getNumberOfTriples();
+    void MRR(AbstractModel* model, Data* data, TripleId limit, double& rawMRR, double& filteredMRR, std::mt19937& generator = RandomUtil::gen) {
+        model->synchronize();
+        TripleId m = data->getNumberOfTriples();
         // create vector of indices
-        std::vector<int> indices(m);
+        std::vector<TripleId> indices(m);
         std::iota(indices.begin(), indices.end(), 0);
 
         if (limit > -1) {
             // use only a subset of triples, shuffle indices // TODO can be done more efficiently
             m = limit;
-            std::random_shuffle(indices.begin(), indices.end());
+            std::shuffle(indices.begin(), indices.end(), generator);
         }
-        int N = data->getNumberOfEntities();
-        VectorXi rawRanks(2 * m);
-        VectorXi filteredRanks(2 * m);
+        EntityId N = data->getNumberOfEntities();
+        VectorXd rawRanks(2 * m);
+        VectorXd filteredRanks(2 * m);
         double positiveScore;
-        VectorXd scores(N);
+        RankBuffers buffers;
 
-        int rawRank;
-        int filteredRank;
+        double rawRank;
+        double filteredRank;
 
         // loop over test triples
-        for (int i = 0; i < m; ++i) {
+        for (TripleId i = 0; i < m; ++i) {
             // get test triple
-            Triple& triple = data->getTriple(indices[i]);
+            Triple triple = data->getTriple(indices[i]);
             // calculate positive score
             positiveScore = model->score(triple);
 
-            // calculate scores by replacing object with all entities
-            calculateScores(model, triple, scores, false);
-            // calculate rank
-            calculateRank(triple, positiveScore, scores, rawRank, filteredRank, false);
+            // calculate rank by replacing object with all entities or the candidates
+            rankTriple(model, N, triple, positiveScore, buffers, rawRank, filteredRank, false, replacements(triple, false, candidateIndex != nullptr, false));
             rawRanks[i] = rawRank;
             filteredRanks[i] = filteredRank;
 
-            // calculate scores by replacing object with all entities
-            calculateScores(model, triple, scores, true);
-            // calculate rank
-            calculateRank(triple, positiveScore, scores, rawRank, filteredRank, true);
+            // calculate rank by replacing subject with all entities or the candidates
+            rankTriple(model, N, triple, positiveScore, buffers, rawRank, filteredRank, true, replacements(triple, true, candidateIndex != nullptr, false));
             rawRanks[m+i] = rawRank;
             filteredRanks[m+i] = filteredRank;
         }
@@ -213,56 +303,266 @@ public:
         calculateMetrics(filteredRanks, meanRank, hitsAtTen, hitsAtOne, filteredMRR, n);
     }
 
-    void calculateScores(AbstractModel* model, Triple& triple, VectorXd& scores, bool alterSubject) {
-        if (alterSubject) {
-            model->scoreRelationObject(triple.relation, triple.object, scores);
-        } else {
-            model->scoreSubjectRelation(triple.subject, triple.relation, scores);
+    /**
+     * Sequential estimate of the mean reciprocal rank for early stopping: evaluates randomly drawn triples until a
+     * confidence interval on the filtered MRR lies completely above or below bestValue, looking after blockSize,
+     * 2 * blockSize, 4 * blockSize, ... triples, or until limit triples are evaluated. Each triple contributes the
+     * mean of its filtered reciprocal ranks of both directions. The interval after the k-th block uses the normal
+     * quantile of 1 - (1 - confidence) / 2^k, so the error probability of all looks together is at most 1 - confidence.
+     * @param model
+     * @param data
+     * @param limit maximum number of triples, -1 means use all
+     * @param bestValue filtered MRR to compare with
+     * @param confidence e.g. 0.95
+     * @param blockSize number of triples of the first block
+     * @param rawMRR
+     * @param filteredMRR
+     * @param generator draws the triples
+     * @return number of evaluated triples
+     */
+    TripleId sequentialMRR(AbstractModel* model, Data* data, TripleId limit, double bestValue, double confidence, TripleId blockSize,
+                           double& rawMRR, double& filteredMRR, std::mt19937& generator = RandomUtil::gen) {
+        model->synchronize();
+        TripleId m = data->getNumberOfTriples();
+        if (limit > -1) {
+            m = std::min(m, limit);
         }
+        std::vector<TripleId> indices(data->getNumberOfTriples());
+        std::iota(indices.begin(), indices.end(), 0);
+        RankBuffers buffers;
+        double positiveScore;
+        double rawRank;
+        double filteredRank;
+        double rawSum = 0.0;
+        double filteredSum = 0.0;
+        double filteredSquares = 0.0;
+        TripleId n = 0;
+        TripleId end = 0;
+        double error = 1.0 - confidence;
+        while (n < m) {
+            end = std::min(m, end == 0 ? blockSize : 2 * end);
+            for (; n < end; ++n) {
+                // draw the next triple by a step of a Fisher-Yates shuffle
+                std::swap(indices[n], indices[std::uniform_int_distribution<TripleId>(n, indices.size() - 1)(generator)]);
+                Triple triple = data->getTriple(indices[n]);
+                positiveScore = model->score(triple);
+                double raw = 0.0;
+                double filtered = 0.0;
+                for (bool alterSubject: {false, true}) {
+                    rankTriple(model, data->getNumberOfEntities(), triple, positiveScore, buffers, rawRank, filteredRank, alterSubject, replacements(triple, alterSubject, candidateIndex != nullptr, false));
+                    raw += 0.5 / rawRank;
+                    filtered += 0.5 / filteredRank;
+                }
+                rawSum += raw;
+                filteredSum += filtered;
+                filteredSquares += filtered * filtered;
+            }
+            if (n < 2) {
+                continue;
+            }
+            // confidence interval of the mean, spending half of the remaining error probability on each look
+            error /= 2;
+            double mean = filteredSum / n;
+            double variance = std::max(0.0, (filteredSquares - n * mean * mean) / (n - 1));
+            double halfWidth = boost::math::quantile(boost::math::normal(), 1.0 - error / 2) * std::sqrt(variance / n);
+            if (mean - halfWidth > bestValue || mean + halfWidth < bestValue) {
+                break;
+            }
+        }
+        rawMRR = n > 0 ? rawSum / n : -1;
+        filteredMRR = n > 0 ? filteredSum / n : -1;
+        return n;
     }
 
 private:
+    static const EntityId CHUNK_SIZE = 1024; /** number of entities scored at once, the scores of a chunk stay in the L1 cache **/
+
+    /**
+     * Re-usable buffers of the ranking of one query, their size does not depend on the number of entities
+     */
+    struct RankBuffers {
+        VectorXd scores; /** scores of the entities of a chunk **/
+        std::vector<EntityId> candidates; /** type-constrained candidates of a chunk **/
+        std::vector<EntityId> known; /** sorted entities that complete the query to an existing triple **/
+    };
+
     std::vector<Data*> lookupDataSets; /** used to check if the existence of triples in the filtered setting **/
+    TripleIndex knownTriples; /** merged membership index of the triples of all lookup data sets **/
+    CandidateIndex* candidateIndex; /** type constraints of the relations, nullptr if not used **/
+    TiePolicy tiePolicy; /** rank of a triple with the same score as others **/
+    std::vector<EntityId> sampledEntities; /** sorted sample of the entities of the sampled evaluation, empty if not used **/
+    CandidateIndex sampledCandidateIndex; /** sampled candidates of the relations of the sampled evaluation **/
+    bool sampledOnly; /** whether evaluate skips the ranking against all entities **/
 
-    static int rawRank(Triple triple, double& positiveScore, const VectorXd& scores) {
-        int rawRank = 1;
-        for (int i = 0; i < scores.size(); ++i) {
-            // if score is better than the score of the positive triple, increase the raw rank
-            if (scores[i] > positiveScore) {
-                rawRank++;
+    /**
+     * Entities that replace subject or object of a triple
+     * @param triple
+     * @param alterSubject
+     * @param typeConstrained whether the candidates of the relation are used, if the relation has any
+     * @param sampled whether the sampled entities or candidates are used
+     * @return sorted entities, nullptr for all entities
+     */
+    const std::vector<EntityId>* replacements(const Triple& triple, bool alterSubject, bool typeConstrained, bool sampled) const {
+        if (typeConstrained) {
+            const CandidateIndex& index = sampled ? sampledCandidateIndex : *candidateIndex;
+            const std::vector<EntityId>& candidates = alterSubject ? index.getSubjects(triple.relation) : index.getObjects(triple.relation);
+            if (!candidates.empty()) {
+                return &candidates;
             }
         }
-        return rawRank;
+        return sampled ? &sampledEntities : nullptr;
     }
 
     /**
-     * Calculate the rank
+     * Calculates the rank of the triple among the triples obtained by replacing subject or object with all entities or
+     * with candidates. The replacements are scored in chunks of CHUNK_SIZE entities and each chunk
+     * is counted right away, so the scores of all entities are never held at once. The better and tied scores of a
+     * chunk are counted without branches, a separate pass over the existing triples of the query in the chunk yields
+     * the correction of the filtered rank. The triple itself is ranked even if its entity is not a candidate.
+     * @param model
+     * @param numberOfEntities
      * @param triple original triple
      * @param positiveScore score of original triple
-     * @param scores scores of all triples obtained by either replacing subject or object
+     * @param buffers
      * @param rawRank used to store raw rank
      * @param filteredRank used to store filtered rank
      * @param alterSubject whether subject (true) or object (false) is altered
+     * @param candidates sorted entities that are ranked, nullptr for all entities
      */
-    void calculateRank(Triple triple, double& positiveScore, const VectorXd& scores,
-                       int &rawRank, int &filteredRank, bool alterSubject) {
-        rawRank = 1;
-        filteredRank = 1;
-        for (int i = 0; i < scores.size(); ++i) {
-            // if score is better than the score of the positive triple, increase the raw rank
-            if (scores[i] > positiveScore) {
-                rawRank++;
-                // if additionally the triple does not already exist, also increase the filtered rank
+    void rankTriple(AbstractModel* model, EntityId numberOfEntities, Triple& triple, double& positiveScore, RankBuffers& buffers,
+                    double& rawRank, double& filteredRank, bool alterSubject, const std::vector<EntityId>* candidates) {
+        EntityId entity = alterSubject ? triple.subject : triple.object;
+        EntityId end = candidates != nullptr ? candidates->size() : numberOfEntities;
+        // the replacements are visited in ascending order, so are the sorted existing ones
+        bool merge = collectKnown(triple, alterSubject, buffers.known);
+        size_t next = 0;
+        Triple replaced = triple;
+        long better = 0;
+        long ties = 0;
+        long knownBetter = 0;
+        long knownTies = 0;
+        for (EntityId first = 0; first < end; first += CHUNK_SIZE) {
+            EntityId count = std::min((EntityId)CHUNK_SIZE, end - first);
+            if (candidates != nullptr) {
+                buffers.candidates.assign(candidates->begin() + first, candidates->begin() + first + count);
                 if (alterSubject) {
-                    triple.subject = i;
+                    model->scoreRelationObjectCandidates(triple.relation, triple.object, buffers.candidates, buffers.scores);
                 } else {
-                    triple.object = i;
+                    model->scoreSubjectRelationCandidates(triple.subject, triple.relation, buffers.candidates, buffers.scores);
                 }
-                if (!tripleExistsGlobal(triple)) {
-                    filteredRank++;
+            } else if (alterSubject) {
+                model->scoreRelationObjectChunk(triple.relation, triple.object, first, count, buffers.scores);
+            } else {
+                model->scoreSubjectRelationChunk(triple.subject, triple.relation, first, count, buffers.scores);
+            }
+            countBetterAndTies(buffers.scores.data(), count, positiveScore, better, ties);
+
+            // position of an entity in the chunk, -1 if it is not in the chunk
+            auto position = [&](EntityId e) -> long {
+                if (candidates == nullptr) {
+                    return e >= first && e < first + count ? e - first : -1;
                 }
+                std::vector<EntityId>::const_iterator it = std::lower_bound(buffers.candidates.begin(), buffers.candidates.end(), e);
+                return it != buffers.candidates.end() && *it == e ? it - buffers.candidates.begin() : -1;
+            };
+            // the batched score of the triple itself may differ from positiveScore by rounding, it is not counted
+            long self = position(entity);
+            if (self >= 0) {
+                better -= buffers.scores[self] > positiveScore;
+                ties -= buffers.scores[self] == positiveScore;
+            }
+            // the filtered rank does not count triples that already exist
+            if (merge) {
+                EntityId last = candidates != nullptr ? buffers.candidates.back() : first + count - 1;
+                for (; next < buffers.known.size() && buffers.known[next] <= last; ++next) {
+                    long i = position(buffers.known[next]);
+                    if (i >= 0 && buffers.known[next] != entity) {
+                        knownBetter += buffers.scores[i] > positiveScore;
+                        knownTies += buffers.scores[i] == positiveScore;
+                    }
+                }
+            } else {
+                for (EntityId i = 0; i < count; ++i) {
+                    EntityId candidate = candidates != nullptr ? buffers.candidates[i] : first + i;
+                    if (buffers.scores[i] < positiveScore || candidate == entity) {
+                        continue;
+                    }
+                    if (alterSubject) {
+                        replaced.subject = candidate;
+                    } else {
+                        replaced.object = candidate;
+                    }
+                    if (knownTriples.contains(replaced)) {
+                        knownBetter += buffers.scores[i] > positiveScore;
+                        knownTies += buffers.scores[i] == positiveScore;
+                    }
+                }
+            }
+        }
+        rawRank = tieRank(better, ties);
+        filteredRank = tieRank(better - knownBetter, ties - knownTies);
+    }
+
+    /**
+     * Counts the scores that are larger than and equal to a score. The loop has no branches, so that the compiler
+     * vectorizes it.
+     * @param scores
+     * @param n number of scores
+     * @param score
+     * @param better incremented by the number of larger scores
+     * @param ties incremented by the number of equal scores
+     */
+    static void countBetterAndTies(const double* scores, EntityId n, double score, long& better, long& ties) {
+        long larger = 0;
+        long equal = 0;
+        for (EntityId i = 0; i < n; ++i) {
+            larger += scores[i] > score;
+            equal += scores[i] == score;
+        }
+        better += larger;
+        ties += equal;
+    }
+
+    /**
+     * Rank of a triple according to the tie policy
+     * @param better number of triples that score better
+     * @param ties number of other triples with the same score
+     * @return
+     */
+    double tieRank(long better, long ties) const {
+        switch (tiePolicy) {
+            case PESSIMISTIC:
+                return better + ties + 1;
+            case REALISTIC:
+                return better + 0.5 * ties + 1;
+            default:
+                return better + 1;
+        }
+    }
+
+    /**
+     * Collects the entities that complete the query to an existing triple of the lookup data sets, if there are at
+     * most CHUNK_SIZE of them
+     * @param triple original triple
+     * @param alterSubject whether subject (true) or object (false) is altered
+     * @param known receives the sorted entities without duplicates
+     * @return whether the entities were collected, otherwise the membership index has to be probed
+     */
+    bool collectKnown(const Triple& triple, bool alterSubject, std::vector<EntityId>& known) {
+        known.clear();
+        for (auto data: lookupDataSets) {
+            SpanList<EntityId> entities = alterSubject ? data->getSubjectsForRelationObject(triple.relation, triple.object)
+                                                       : data->getObjectsForSubjectRelation(triple.subject, triple.relation);
+            if (known.size() + entities.size() > CHUNK_SIZE) {
+                return false;
+            }
+            for (int p = 0; p < entities.getNumberOfParts(); ++p) {
+                known.insert(known.end(), entities.getPart(p).begin(), entities.getPart(p).end());
             }
         }
+        std::sort(known.begin(), known.end());
+        known.erase(std::unique(known.begin(), known.end()), known.end());
+        return true;
     }
 
     /**
@@ -273,7 +573,7 @@ private:
      * @param hitsAtOne
      * @param meanReciprocalRank
      */
-    void calculateMetrics(const VectorXi& ranks, double& meanRank, double& hitsAtTen, double& hitsAtOne, double& meanReciprocalRank, int& n) {
+    void calculateMetrics(const VectorXd& ranks, double& meanRank, double& hitsAtTen, double& hitsAtOne, double& meanReciprocalRank, int& n) {
         n = 0;
         meanRank = 0.0;
         hitsAtTen = 0.0;
@@ -307,20 +607,6 @@ private:
             meanReciprocalRank /= n;
         }
     }
-
-    /**
-     * Checks whether a triple exists globally in at least one of the lookupDataSets
-     * @param triple
-     * @return
-     */
-    bool tripleExistsGlobal(Triple& triple) {
-        for (int i = 0; i < lookupDataSets.size(); ++i) {
-            if (lookupDataSets[i]->hasTriple(triple)) {
-                return true;
-            }
-        }
-        return false;
-    }
 };
 
 
@@ -0,0 +1,407 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_TRIPLECLASSIFICATION_H
+#define THRAX_TRIPLECLASSIFICATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/timer/timer.hpp>
+
+#include <thrax/model/AbstractModel.h>
+#include <thrax/struct/CandidateIndex.h>
+#include <thrax/struct/Data.h>
+#include <thrax/struct/TripleIndex.h>
+#include <thrax/util/FileUtil.h>
+
+using namespace Eigen;
+namespace fs = boost::filesystem;
+
+/**
+ * Decides whether triples are true by comparing their scores with a threshold of their relation. The thresholds are
+ * calibrated on validation data, where each triple is paired with a generated negative triple, to maximize the accuracy
+ * of each relation. Triples are scored in batches with AbstractModel::scoreTriples, batches are scored by the OpenMP
+ * threads in parallel if the model allows it.
+ */
+class TripleClassification {
+public:
+    /**
+     * @param trainData provides the vocabularies and the number of entities
+     * @param lookupDataSets data sets of the existing triples, which are not generated as negatives
+     * @param candidateIndex type constraints of the relations, negatives are drawn from the candidates if set, may be nullptr
+     * @param batchSize number of triples scored at once
+     * @param seed seed of the generated negatives
+     */
+    TripleClassification(const Data* trainData, std::vector<Data*> lookupDataSets, CandidateIndex* candidateIndex, TripleId batchSize, unsigned seed):
+    trainData(trainData), candidateIndex(candidateIndex), batchSize(batchSize), generator(seed) {
+        for (auto data: lookupDataSets) {
+            knownTriples.insert(data->getTriples());
+        }
+    }
+
+    /**
+     * Calibrates the threshold of each relation on the triples of data and generated negatives and dumps the thresholds
+     * to thresholds.csv in path. Relations without triples in data get the threshold calibrated on all triples.
+     * @param model
+     * @param data
+     * @param path
+     */
+    void calibrate(AbstractModel* model, Data* data, std::string path) {
+        model->synchronize();
+        std::vector<Triple> triples;
+        std::vector<bool> labels;
+        generateLabeledTriples(data, triples, labels);
+        VectorXd scores;
+        scoreBatches(model, triples, scores);
+
+        RelationId numberOfRelations = trainData->getNumberOfRelations();
+        std::vector<std::vector<std::pair<double, bool> > > examplesByRelation(numberOfRelations);
+        std::vector<std::pair<double, bool> > examples(triples.size());
+        for (size_t i = 0; i < triples.size(); ++i) {
+            examples[i] = std::make_pair(scores[i], (bool)labels[i]);
+            examplesByRelation[triples[i].relation].push_back(examples[i]);
+        }
+        double accuracy;
+        double globalThreshold = calibrateThreshold(examples, accuracy);
+        BOOST_LOG_TRIVIAL(info) << "Triple classification: accuracy of one threshold for all relations on " << examples.size() << " calibration triples: " << accuracy;
+
+        thresholds.assign(numberOfRelations, globalThreshold);
+        double correct = 0.0;
+        fs::path thresholdsPath = fs::path(path) / "thresholds.csv";
+        std::ofstream outf(thresholdsPath.string());
+        outf << "relation,threshold,accuracy,n" << std::endl;
+        for (RelationId relation = 0; relation < numberOfRelations; ++relation) {
+            std::vector<std::pair<double, bool> >& relationExamples = examplesByRelation[relation];
+            accuracy = -1;
+            if (!relationExamples.empty()) {
+                thresholds[relation] = calibrateThreshold(relationExamples, accuracy);
+                correct += accuracy * relationExamples.size();
+            }
+            outf << relation << "," << thresholds[relation] << "," << accuracy << "," << relationExamples.size() << std::endl;
+        }
+        outf.close();
+        BOOST_LOG_TRIVIAL(info) << "Triple classification: accuracy of the thresholds by relation on the calibration triples: "
+                                << (examples.empty() ? -1 : correct / examples.size());
+    }
+
+    /**
+     * Classifies the triples of data and generated negatives with the calibrated thresholds and dumps accuracy,
+     * precision, recall and F1 to classification.csv in path
+     * @param model
+     * @param data
+     * @param path
+     */
+    void evaluate(AbstractModel* model, Data* data, std::string path) {
+        checkCalibrated();
+        model->synchronize();
+        std::vector<Triple> triples;
+        std::vector<bool> labels;
+        generateLabeledTriples(data, triples, labels);
+        VectorXd scores;
+        scoreBatches(model, triples, scores);
+
+        long truePositives = 0;
+        long falsePositives = 0;
+        long trueNegatives = 0;
+        long falseNegatives = 0;
+        for (size_t i = 0; i < triples.size(); ++i) {
+            bool positive = isPositive(triples[i].relation, scores[i]);
+            if (labels[i]) {
+                positive ? ++truePositives : ++falseNegatives;
+            } else {
+                positive ? ++falsePositives : ++trueNegatives;
+            }
+        }
+        long n = triples.size();
+        double accuracy = n > 0 ? (double)(truePositives + trueNegatives) / n : -1;
+        double precision = truePositives + falsePositives > 0 ? (double)truePositives / (truePositives + falsePositives) : -1;
+        double recall = truePositives + falseNegatives > 0 ? (double)truePositives / (truePositives + falseNegatives) : -1;
+        double f1 = precision + recall > 0 ? 2 * precision * recall / (precision + recall) : -1;
+        BOOST_LOG_TRIVIAL(info) << "Triple classification: accuracy: " << accuracy << ", precision: " << precision << ", recall: " << recall << ", F1: " << f1 << " on " << n << " triples";
+
+        fs::path metricsPath = fs::path(path) / "classification.csv";
+        std::ofstream outf(metricsPath.string());
+        outf << "accuracy,precision,recall,F1,n" << std::endl;
+        outf << accuracy << "," << precision << "," << recall << "," << f1 << "," << n << std::endl;
+        outf.close();
+    }
+
+    /**
+     * Classifies the triples of a file, which is read and written block by block, so its size is not limited by
+     * memory. Each line <subject>\t<relation>\t<object> is written to outputPath with the score and the decision
+     * true or false appended, lines with names that are not in the vocabularies or that are no triple get the decision
+     * unknown.
+     * @param model
+     * @param inputPath file, files ending with .gz or .zst are decompressed while reading
+     * @param outputPath
+     */
+    void classify(AbstractModel* model, const std::string& inputPath, const std::string& outputPath) {
+        checkCalibrated();
+        model->synchronize();
+        if (!fs::is_regular_file(inputPath)) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot find file " << inputPath;
+            exit(1);
+        }
+        boost::iostreams::filtering_istream in;
+        FileUtil::openInput(inputPath, in);
+        std::ofstream out(outputPath);
+        if (!out.is_open()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not open file " << outputPath << " to write the classified triples";
+            exit(1);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Triple classification: classifying the triples of " << inputPath << " with " << omp_get_max_threads() << " threads";
+
+        // lines are read and written in blocks, the batches of a block are parsed, scored and formatted in parallel
+        size_t numberOfBatches = omp_get_max_threads();
+        bool concurrent = model->canScoreTriplesConcurrently();
+        std::vector<std::string> lines;
+        std::vector<std::string> outputs(numberOfBatches); /** formatted decisions of each batch of the block **/
+        std::vector<TripleId> unknown(numberOfBatches); /** number of unknown lines of each batch of the block **/
+        TripleId numberOfLines = 0;
+        TripleId numberOfUnknown = 0;
+        TripleId nextProgress = PROGRESS_INTERVAL;
+        boost::timer::cpu_timer timer;
+        std::string line;
+        bool done = false;
+        while (!done) {
+            lines.clear();
+            while (lines.size() < numberOfBatches * batchSize) {
+                if (!std::getline(in, line)) {
+                    done = true;
+                    break;
+                }
+                if (!boost::trim_copy(line).empty()) {
+                    lines.push_back(line);
+                }
+            }
+            #pragma omp parallel for schedule(dynamic) if(concurrent)
+            for (size_t b = 0; b < numberOfBatches; ++b) {
+                size_t first = std::min(b * batchSize, lines.size());
+                size_t last = std::min(first + batchSize, lines.size());
+                classifyBatch(model, lines, first, last, outputs[b], unknown[b]);
+            }
+            for (size_t b = 0; b < numberOfBatches; ++b) {
+                out << outputs[b];
+                numberOfUnknown += unknown[b];
+            }
+            numberOfLines += lines.size();
+            if (numberOfLines >= nextProgress) {
+                BOOST_LOG_TRIVIAL(info) << "Triple classification: classified " << numberOfLines << " triples, " << throughput(numberOfLines, timer) << " triples/sec";
+                nextProgress += PROGRESS_INTERVAL;
+            }
+        }
+        out.close();
+        if (out.fail()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not write the classified triples to " << outputPath;
+            exit(1);
+        }
+        timer.stop();
+        BOOST_LOG_TRIVIAL(info) << "Triple classification: classified " << numberOfLines << " triples (" << numberOfUnknown << " unknown) in "
+                                << timer.format(3, "%w sec") << ": " << throughput(numberOfLines, timer) << " triples/sec, written to " << outputPath;
+    }
+
+    /**
+     * Decides whether a triple is true
+     * @param relation
+     * @param score score of the triple
+     * @return
+     */
+    bool isPositive(RelationId relation, double score) const {
+        return score >= thresholds[relation];
+    }
+
+private:
+    static const TripleId PROGRESS_INTERVAL = 1000000; /** number of classified triples between two progress logs **/
+    static const int MAX_ATTEMPTS = 100; /** number of drawn entities to find a negative, the first half from the candidates **/
+
+    const Data* trainData; /** provides the vocabularies and the number of entities **/
+    TripleIndex knownTriples; /** merged membership index of the triples of all lookup data sets **/
+    CandidateIndex* candidateIndex; /** type constraints of the relations, nullptr if not used **/
+    TripleId batchSize; /** number of triples scored at once **/
+    std::mt19937 generator; /** draws the negatives **/
+    std::vector<double> thresholds; /** threshold of each relation, triples with at least this score are positive **/
+
+    /**
+     * Scores triples in batches, which are scored in parallel if the model allows it
+     * @param model
+     * @param triples
+     * @param scores receives the score of each triple
+     */
+    void scoreBatches(AbstractModel* model, const std::vector<Triple>& triples, VectorXd& scores) {
+        scores.resize(triples.size());
+        long numberOfBatches = (triples.size() + batchSize - 1) / batchSize;
+        bool concurrent = model->canScoreTriplesConcurrently();
+        #pragma omp parallel for schedule(dynamic) if(concurrent)
+        for (long b = 0; b < numberOfBatches; ++b) {
+            size_t first = b * batchSize;
+            size_t last = std::min(first + batchSize, triples.size());
+            std::vector<Triple> batch(triples.begin() + first, triples.begin() + last);
+            VectorXd batchScores;
+            model->scoreTriples(batch, batchScores);
+            scores.segment(first, last - first) = batchScores;
+        }
+    }
+
+    /**
+     * Parses, scores and classifies lines of a file
+     * @param model
+     * @param lines
+     * @param first index of the first line of the batch
+     * @param last index after the last line of the batch
+     * @param output receives the lines with score and decision
+     * @param unknown receives the number of lines with unknown names or that are no triple
+     */
+    void classifyBatch(AbstractModel* model, const std::vector<std::string>& lines, size_t first, size_t last, std::string& output, TripleId& unknown) const {
+        std::vector<Triple> triples;
+        std::vector<long> lineTriples; /** index of the triple of each line, -1 if unknown **/
+        std::vector<std::string> splits;
+        for (size_t i = first; i < last; ++i) {
+            boost::split(splits, boost::trim_copy(lines[i]), boost::is_any_of("\t"));
+            long index = -1;
+            if (splits.size() == 3) {
+                EntityId subject = trainData->getEntityVocabulary()->find(boost::trim_copy(splits[0]));
+                RelationId relation = trainData->getRelationVocabulary()->find(boost::trim_copy(splits[1]));
+                EntityId object = trainData->getEntityVocabulary()->find(boost::trim_copy(splits[2]));
+                if (subject >= 0 && relation >= 0 && object >= 0) {
+                    index = triples.size();
+                    triples.push_back(Triple(subject, relation, object));
+                }
+            }
+            lineTriples.push_back(index);
+        }
+        VectorXd scores;
+        model->scoreTriples(triples, scores);
+
+        std::ostringstream formatted;
+        unknown = 0;
+        for (size_t i = first; i < last; ++i) {
+            long index = lineTriples[i - first];
+            formatted << boost::trim_copy(lines[i]);
+            if (index < 0) {
+                formatted << "\t\tunknown\n";
+                ++unknown;
+            } else {
+                formatted << "\t" << scores[index] << "\t" << (isPositive(triples[index].relation, scores[index]) ? "true" : "false") << "\n";
+            }
+        }
+        output = formatted.str();
+    }
+
+    /**
+     * Collects the triples of data as positives, each followed by a generated negative
+     * @param data
+     * @param triples
+     * @param labels whether the triple of the same index is a positive
+     */
+    void generateLabeledTriples(Data* data, std::vector<Triple>& triples, std::vector<bool>& labels) {
+        triples.clear();
+        labels.clear();
+        Triple negative;
+        for (TripleId i = 0; i < data->getNumberOfTriples(); ++i) {
+            Triple triple = data->getTriple(i);
+            triples.push_back(triple);
+            labels.push_back(true);
+            if (generateNegative(triple, negative)) {
+                triples.push_back(negative);
+                labels.push_back(false);
+            }
+        }
+    }
+
+    /**
+     * Replaces subject or object of a triple with a random entity, from the candidates of the relation first, such
+     * that the triple does not exist
+     * @param triple
+     * @param negative receives the negative triple
+     * @return whether a negative was found
+     */
+    bool generateNegative(const Triple& triple, Triple& negative) {
+        bool alterSubject = std::bernoulli_distribution(0.5)(generator);
+        const std::vector<EntityId>* candidates = nullptr;
+        if (candidateIndex != nullptr) {
+            candidates = alterSubject ? &candidateIndex->getSubjects(triple.relation) : &candidateIndex->getObjects(triple.relation);
+        }
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+            EntityId entity;
+            if (candidates != nullptr && !candidates->empty() && attempt < MAX_ATTEMPTS / 2) {
+                entity = (*candidates)[std::uniform_int_distribution<size_t>(0, candidates->size() - 1)(generator)];
+            } else {
+                entity = std::uniform_int_distribution<EntityId>(0, trainData->getNumberOfEntities() - 1)(generator);
+            }
+            negative = triple;
+            if (alterSubject) {
+                negative.subject = entity;
+            } else {
+                negative.object = entity;
+            }
+            if (!knownTriples.contains(negative)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Finds the threshold with the highest accuracy: triples with at least the threshold are classified as positive
+     * @param examples score and label of each triple, sorted by score
+     * @param accuracy receives the accuracy of the threshold
+     * @return threshold between two scores, -1 accuracy if there are no examples
+     */
+    static double calibrateThreshold(std::vector<std::pair<double, bool> >& examples, double& accuracy) {
+        if (examples.empty()) {
+            accuracy = -1;
+            return 0.0;
+        }
+        std::sort(examples.begin(), examples.end());
+        // the lowest threshold classifies all triples as positive, each step classifies the next triple as negative
+        long correct = 0;
+        for (auto& example: examples) {
+            correct += example.second;
+        }
+        long best = correct;
+        double threshold = examples.front().first;
+        for (size_t i = 0; i < examples.size(); ++i) {
+            correct += examples[i].second ? -1 : 1;
+            // triples with the same score get the same decision
+            if (i + 1 < examples.size() && examples[i + 1].first == examples[i].first) {
+                continue;
+            }
+            if (correct > best) {
+                best = correct;
+                threshold = i + 1 < examples.size() ? 0.5 * (examples[i].first + examples[i + 1].first)
+                                                    : std::nextafter(examples[i].first, std::numeric_limits<double>::infinity());
+            }
+        }
+        accuracy = (double)best / examples.size();
+        return threshold;
+    }
+
+    void checkCalibrated() const {
+        if (thresholds.empty()) {
+            BOOST_LOG_TRIVIAL(error) << "Triple classification needs calibrated thresholds";
+            exit(1);
+        }
+    }
+
+    static double throughput(TripleId n, const boost::timer::cpu_timer& timer) {
+        double seconds = timer.elapsed().wall * 1e-9;
+        return seconds > 0 ? n / seconds : 0.0;
+    }
+};
+
+
+#endif //THRAX_TRIPLECLASSIFICATION_H
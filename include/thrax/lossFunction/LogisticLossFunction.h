@@ -17,7 +17,7 @@ private:
         double positiveScore = model->score(positive);
         loss += MathUtil::softplus(-positiveScore); // TODO add regularization term
         double scale = - MathUtil::sigmoid(-positiveScore);
-        model->gradient(positive, scale/numberOfTriplesInBatch);
+        modelGradient(positive, scale/numberOfTriplesInBatch);
 
         // negative triples
         double negativeScore;
@@ -26,7 +26,7 @@ private:
             negativeScore = model->score(negatives[i]);
             loss += MathUtil::softplus(negativeScore); // TODO add regularization term
             scale = MathUtil::sigmoid(negativeScore);
-            model->gradient(negatives[i], scale/numberOfTriplesInBatch);
+            modelGradient(negatives[i], scale/numberOfTriplesInBatch);
         }
     }
 
@@ -19,6 +19,7 @@ protected:
     std::string type;
     double numberOfTriplesInBatch; /** counts the number of gradient computations per epoch **/
     double numberOfGradientComputations; /** number of gradient computations per epoch, used for loss logging **/
+    double numberOfGradientCalls; /** number of calls to the model's gradient function per epoch **/
     int numberOfNegatives;
     int batchSize;
 
@@ -29,16 +30,29 @@ protected:
         reset();
     }
 
+    /**
+     * Calculates the model's gradient of a single triple and counts the call
+     * @param triple
+     * @param scale
+     */
+    void modelGradient(Triple& triple, double scale) {
+        model->gradient(triple, scale);
+        ++numberOfGradientCalls;
+    }
+
 public:
     LossFunction(AbstractModel *model, pt::ptree& config) : model(model), config(config) {
         init();
     }
 
+    virtual ~LossFunction() {}
+
     virtual void gradient(std::vector<Triple*> positives, std::vector<std::vector<Triple> >& negatives) = 0;
 
     void reset() {
         loss = 0.0;
         numberOfGradientComputations = 0.0;
+        numberOfGradientCalls = 0.0;
     }
 
     std::string getType() {
@@ -49,6 +63,26 @@ public:
         return loss;
     }
 
+    double getNumberOfGradientCalls() {
+        return numberOfGradientCalls;
+    }
+
+    double getNumberOfGradientComputations() {
+        return numberOfGradientComputations;
+    }
+
+    /**
+     * Adds the statistics of another loss function, e.g. of a worker process
+     * @param loss
+     * @param gradientComputations
+     * @param gradientCalls
+     */
+    void accumulate(double loss, double gradientComputations, double gradientCalls) {
+        this->loss += loss;
+        numberOfGradientComputations += gradientComputations;
+        numberOfGradientCalls += gradientCalls;
+    }
+
     virtual void printLoss() = 0;
 
 };
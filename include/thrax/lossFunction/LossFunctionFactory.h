@@ -11,6 +11,7 @@
 #include "SoftmaxLossFunction.h"
 #include "LogisticLossFunction.h"
 #include "PairwiseLossFunction.h"
+#include "SelfAdversarialLossFunction.h"
 
 namespace pt = boost::property_tree;
 
@@ -25,6 +26,8 @@ public:
             lossFunction = new SoftmaxLossFunction(model, config);
         } else if (lossFunctionType == "logistic") {
             lossFunction = new LogisticLossFunction(model, config);
+        } else if (lossFunctionType == "selfadversarial") {
+            lossFunction = new SelfAdversarialLossFunction(model, config);
         } else {
             BOOST_LOG_TRIVIAL(error) << "Loss function " << lossFunctionType << " not implemented";
         }
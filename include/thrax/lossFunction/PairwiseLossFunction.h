@@ -23,8 +23,8 @@ private:
         // only calculate gradient for non-negative losses
         if (pairwiseLoss(positive, negative) > 0) {
             loss += 1.0;
-            model->gradient(positive, -1.0/numberOfTriplesInBatch);
-            model->gradient(negative, 1.0/numberOfTriplesInBatch);
+            modelGradient(positive, -1.0/numberOfTriplesInBatch);
+            modelGradient(negative, 1.0/numberOfTriplesInBatch);
         }
     }
 
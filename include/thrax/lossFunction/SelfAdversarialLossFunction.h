@@ -0,0 +1,75 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_SELFADVERSARIALLOSSFUNCTION_H
+#define THRAX_SELFADVERSARIALLOSSFUNCTION_H
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/util/MathUtil.h>
+#include "LossFunction.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Logistic loss with self-adversarial negative weighting. The negatives of a positive triple are scored in one batched
+ * call and weighted by a softmax over their scores (with temperature), so hard negatives dominate the loss. The weights
+ * are treated as constants, and negatives whose weight is negligible are skipped in the backward pass.
+ */
+class SelfAdversarialLossFunction: public LossFunction {
+private:
+    double temperature; /** inverse temperature of the softmax over negative scores **/
+    double weightThreshold; /** negatives with weight below weightThreshold/numberOfNegatives are not backpropagated **/
+    VectorXd negativeScores;
+    VectorXd weights;
+
+    void selfAdversarialGradient(Triple& positive, std::vector<Triple>& negatives, double& loss) {
+        double positiveScore = model->score(positive);
+        loss += MathUtil::softplus(-positiveScore);
+        modelGradient(positive, -MathUtil::sigmoid(-positiveScore)/numberOfTriplesInBatch);
+
+        // score all negatives at once and weight them by a softmax over their scores
+        model->scoreTriples(negatives, negativeScores);
+        weights = temperature * negativeScores;
+        weights = (weights.array() - MathUtil::logsumexp(weights)).exp();
+
+        double minimumWeight = weightThreshold / negatives.size();
+        for (int i = 0; i < negatives.size(); ++i) {
+            loss += weights[i] * MathUtil::softplus(negativeScores[i]);
+            // skip easy negatives, they hardly contribute to the gradient
+            if (weights[i] >= minimumWeight) {
+                modelGradient(negatives[i], weights[i] * MathUtil::sigmoid(negativeScores[i])/numberOfTriplesInBatch);
+            }
+        }
+    }
+
+    void init() {
+        temperature = config.get<double>("optimizer.selfAdversarial.temperature", 1.0);
+        weightThreshold = config.get<double>("optimizer.selfAdversarial.weightThreshold", 0.1);
+        // the positive and the weighted negatives count as one term each
+        numberOfTriplesInBatch = 2 * batchSize;
+        negativeScores.resize(numberOfNegatives);
+        weights.resize(numberOfNegatives);
+    }
+
+public:
+    SelfAdversarialLossFunction(AbstractModel *model, pt::ptree& config) : LossFunction(model, config) {
+        init();
+    }
+
+    virtual void gradient(std::vector<Triple*> positives, std::vector<std::vector<Triple> >& negatives) {
+        for (int i = 0; i < positives.size(); ++i) {
+            selfAdversarialGradient(*positives[i], negatives[i], loss);
+        }
+        model->l2(1.0/numberOfTriplesInBatch);
+        numberOfGradientComputations += numberOfTriplesInBatch;
+    }
+
+    virtual void printLoss() {
+        BOOST_LOG_TRIVIAL(info) << "Loss: " << loss / (double)numberOfGradientComputations;
+    }
+};
+
+
+#endif //THRAX_SELFADVERSARIALLOSSFUNCTION_H
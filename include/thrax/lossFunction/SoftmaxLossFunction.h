@@ -31,13 +31,13 @@ private:
             negativeScores[i] = model->score(negatives[i]);
         }
         // gradient of positive triple
-        model->gradient(positive, -1/numberOfTriplesInBatch);
+        modelGradient(positive, -1/numberOfTriplesInBatch);
 
         // gradient of negative triples
         double negativeLoss;
         for (int i = 0; i < negatives.size(); ++i) {
             negativeLoss = exp(MathUtil::logSoftmax(negativeScores[i], negativeScores));
-            model->gradient(negatives[i], negativeLoss/numberOfTriplesInBatch);
+            modelGradient(negatives[i], negativeLoss/numberOfTriplesInBatch);
         }
     }
 
@@ -13,12 +13,15 @@
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <unordered_map>
 #include <string>
 #include <sys/time.h>
 #include <time.h>
 
 #include <thrax/model/EmbeddingParameterSet.h>
+#include <thrax/model/ModelSnapshot.h>
+#include <thrax/parameterServer/Message.h>
 #include <thrax/initializer/Initializer.h>
 #include <thrax/initializer/InitializerFactory.h>
 #include <thrax/struct/Gradient.h>
@@ -38,7 +41,7 @@ class AbstractModel {
 public:
     /** ##### CONSTRUCTORS ##### **/
 
-    AbstractModel() {
+    AbstractModel(): pipelined(false), data(nullptr) {
 
     }
 
@@ -47,11 +50,15 @@ public:
      * @param data
      * @param config property tree of config
      */
-    AbstractModel(Data* data, pt::ptree& config): config(config), data(data), numberOfEntities(data->getNumberOfEntities()), numberOfRelations(data->getNumberOfRelations()) {
+    AbstractModel(Data* data, pt::ptree& config): config(config), numberOfEntities(data->getNumberOfEntities()), numberOfRelations(data->getNumberOfRelations()), pipelined(false), data(data) {
         init();
     }
 
-    void initParameterUpdater() {
+    virtual void initParameterUpdater() {
+        // a model that only scores triples is never updated
+        if (scoringOnly) {
+            return;
+        }
         // initialize updater
         updater = ParameterUpdaterFactory::buildParameterUpdater(parameters, config.get_child("update"));
     }
@@ -98,7 +105,7 @@ public:
     }
 
     /** ##### DESTRUCTOR ##### **/
-    ~AbstractModel() {
+    virtual ~AbstractModel() {
         delete initializer;
         delete updater;
     }
@@ -142,6 +149,100 @@ public:
         }
     }
 
+    /**
+     * Calculate scores of <subject, relation, ?> triples with a chunk of consecutive objects, so that the scores of all
+     * entities need not be held at once. Naively calls score computation for each triple separately, can be
+     * overwritten to be more efficient
+     * @param subjectId
+     * @param relationId
+     * @param first first object of the chunk
+     * @param count number of objects of the chunk
+     * @param scores receives the score of each object of the chunk
+     */
+    virtual void scoreSubjectRelationChunk(int subjectId, int relationId, EntityId first, EntityId count, VectorXd& scores) {
+        Triple triple(subjectId, relationId, 0);
+        scores.resize(count);
+        for (EntityId i = 0; i < count; ++i) {
+            triple.object = first + i;
+            scores[i] = score(triple);
+        }
+    }
+
+    /**
+     * Calculate scores of <?, relation, object> triples with a chunk of consecutive subjects, so that the scores of all
+     * entities need not be held at once. Naively calls score computation for each triple separately, can be
+     * overwritten to be more efficient
+     * @param relationId
+     * @param objectId
+     * @param first first subject of the chunk
+     * @param count number of subjects of the chunk
+     * @param scores receives the score of each subject of the chunk
+     */
+    virtual void scoreRelationObjectChunk(int relationId, int objectId, EntityId first, EntityId count, VectorXd& scores) {
+        Triple triple(0, relationId, objectId);
+        scores.resize(count);
+        for (EntityId i = 0; i < count; ++i) {
+            triple.subject = first + i;
+            scores[i] = score(triple);
+        }
+    }
+
+    /**
+     * Calculate scores of <subject, relation, ?> triples with the given objects, e.g. the type-constrained candidates
+     * of the relation. Naively calls score computation for each triple separately, can be overwritten to be more efficient
+     * @param subjectId
+     * @param relationId
+     * @param candidates objects
+     * @param scores receives the score of each candidate
+     */
+    virtual void scoreSubjectRelationCandidates(int subjectId, int relationId, const std::vector<EntityId>& candidates, VectorXd& scores) {
+        Triple triple(subjectId, relationId, 0);
+        scores.resize(candidates.size());
+        for (int i = 0; i < candidates.size(); ++i) {
+            triple.object = candidates[i];
+            scores[i] = score(triple);
+        }
+    }
+
+    /**
+     * Calculate scores of <?, relation, object> triples with the given subjects, e.g. the type-constrained candidates
+     * of the relation. Naively calls score computation for each triple separately, can be overwritten to be more efficient
+     * @param relationId
+     * @param objectId
+     * @param candidates subjects
+     * @param scores receives the score of each candidate
+     */
+    virtual void scoreRelationObjectCandidates(int relationId, int objectId, const std::vector<EntityId>& candidates, VectorXd& scores) {
+        Triple triple(0, relationId, objectId);
+        scores.resize(candidates.size());
+        for (int i = 0; i < candidates.size(); ++i) {
+            triple.subject = candidates[i];
+            scores[i] = score(triple);
+        }
+    }
+
+    /**
+     * Calculate scores of a list of triples in one call, e.g. all negatives of a positive triple.
+     * Naively calls score computation for each triple separately, can be overwritten to be more efficient
+     * @param triples
+     * @param scores
+     */
+    virtual void scoreTriples(std::vector<Triple>& triples, VectorXd& scores) {
+        scores.resize(triples.size());
+        for (int i = 0; i < triples.size(); ++i) {
+            scores[i] = score(triples[i]);
+        }
+    }
+
+    /**
+     * Whether scoreTriples may be called by multiple threads at once, i.e. it does not write to buffers of the model.
+     * The naive scoreTriples calls score, which may use such buffers.
+     * @return
+     */
+    virtual bool canScoreTriplesConcurrently() const {
+        return false;
+    }
+
     /** ##### GRADIENTS ##### **/
 
     virtual void gradient(Triple& triple, double scale) = 0;
@@ -155,12 +256,7 @@ public:
     /** ##### MODEL UPDATES ##### **/
 
     virtual void update() {
-        updater->calculateUpdate(gradients);
-        for (auto& gradient: gradients) {
-            for (auto& ptr: gradient.second.getIdToCol()) {
-                parameters.at(gradient.first).col(ptr.first) -= gradient.second.get(ptr.first);
-            }
-        }
+        updater->update(getUpdateGradients(), parameters);
     };
 
     /** ##### REGULARIZATION ##### **/
@@ -181,23 +277,145 @@ public:
         // do nothing by default
     }
 
+    /**
+     * Applies pending lazy updates to the embeddings of a triple before it is scored. Called for the triples of a batch
+     * before their gradients are computed and by samplers before they score candidates.
+     * @param triple
+     */
+    virtual void prepareTriple(const Triple& triple) {
+        // do nothing by default
+    }
+
+    /**
+     * Applies pending lazy updates, so that all parameters are up to date. Called before evaluating and dumping.
+     */
+    virtual void synchronize() {
+        // do nothing by default
+    }
+
+    /** ##### PIPELINING ##### **/
+
+    /**
+     * Adds a second gradient buffer: gradients are computed into the first buffer, while update and postBatch apply
+     * the second buffer, which swapGradients fills with the gradients of the previous batch
+     */
+    virtual void enablePipelining() {
+        for (auto& parameter: parameters) {
+            pendingGradients.insert({parameter.first, Gradient(&parameter.second)});
+        }
+        pipelined = true;
+    }
+
+    /**
+     * Moves the gradients of the current batch to the buffer applied by update, the current buffer is reset
+     */
+    virtual void swapGradients() {
+        for (auto& gradient: gradients) {
+            // swap the contents, models keep pointers to the gradients
+            std::swap(gradient.second, pendingGradients.at(gradient.first));
+            gradient.second.reset();
+        }
+    }
+
+    /**
+     * Counts the columns of the current gradients that are also touched by the pending gradients, i.e. the gradient
+     * of these embeddings may be computed on parameters without the pending update
+     * @param stale number of columns touched by both
+     * @param touched number of columns of the current gradients
+     */
+    virtual void countStaleColumns(long& stale, long& touched) {
+        for (auto& gradient: gradients) {
+            Gradient& pending = pendingGradients.at(gradient.first);
+            for (auto& ptr: gradient.second.getIdToCol()) {
+                stale += pending.getIdToCol().count(ptr.first);
+            }
+            touched += gradient.second.getSize();
+        }
+    }
+
+    /** ##### SHARED MEMORY ##### **/
+
+    /**
+     * Moves all parameters and their updater state to shared memory, so that updates of forked worker processes are
+     * visible to all processes
+     */
+    virtual void moveToSharedMemory() {
+        for (auto& parameter: parameters) {
+            parameter.second.moveToSharedMemory();
+            for (EmbeddingParameterSet* state: updater->getState(parameter.first)) {
+                state->moveToSharedMemory();
+            }
+        }
+    }
+
+    /** ##### CHECKPOINTING ##### **/
+
+    /**
+     * Get all matrices with one column per embedding that change during training by a unique name: the parameters and
+     * the state of the updater
+     * @return
+     */
+    virtual std::map<std::string, EmbeddingParameterSet*> getTrainingState() {
+        std::map<std::string, EmbeddingParameterSet*> matrices;
+        for (auto& parameter: parameters) {
+            matrices[parameter.first] = &parameter.second;
+            std::vector<EmbeddingParameterSet*> state = updater->getState(parameter.first);
+            for (int i = 0; i < state.size(); ++i) {
+                matrices[parameter.first + ".state" + std::to_string(i)] = state[i];
+            }
+        }
+        return matrices;
+    }
+
+    /**
+     * Writes the scalar training state that is not part of getTrainingState, e.g. the step of the updater
+     * @param state
+     */
+    virtual void saveTrainingState(Message& state) {
+        state.write<int64_t>(updater->getStep());
+    }
+
+    /**
+     * Reads the scalar training state written by saveTrainingState
+     * @param state
+     */
+    virtual void loadTrainingState(Message& state) {
+        updater->setStep(state.read<int64_t>());
+    }
+
     /** ##### SERIALIZATION ##### **/
 
     /**
      * Dumps model to disk into the specified location
      * @param subPath path starting from model.dumpLocation
      */
-    virtual void dump(std::string location) {
-        fs::path dir(location);
-        fs::create_directories(dir);
-        BOOST_LOG_TRIVIAL(info) << "Dumping model to " << dir.string();
-        // dump parameters into separate files
+    void dump(std::string location) {
+        ModelSnapshot snapshot;
+        takeSnapshot(location, snapshot);
+        snapshot.write();
+    }
+
+    /**
+     * Copies the parameters into a snapshot, which can be written to disk later, e.g. by a SnapshotWriter
+     * @param location directory to dump the model to
+     * @param snapshot
+     */
+    virtual void takeSnapshot(std::string location, ModelSnapshot& snapshot) {
+        synchronize();
+        snapshot.addModel(location, data);
+        // copy parameters, each is dumped into a separate file
         for(auto& parameter: parameters) {
-            fs::path file(parameter.first);
-            fs::path parameterPath = dir / "parameters";
-            fs::create_directories(parameterPath);
-            fs::path fullPath = parameterPath / file;
-            FileUtil::dumpMatrix(fullPath.string(), parameter.second);
+            snapshot.addParameter(location, parameter.first, parameter.second);
+        }
+    }
+
+    /**
+     * Copies the parameters of a model of the same type and size, e.g. to evaluate them while training goes on
+     * @param source
+     */
+    virtual void copyParameters(AbstractModel* source) {
+        for (auto& parameter: parameters) {
+            parameter.second = source->getParameter(parameter.first);
         }
     }
 
@@ -244,10 +462,25 @@ protected:
     Initializer* initializer; /** the initializer to initialize parameters **/
     ParameterMap parameters; /** hash map: parameter set name -> parameter set **/
     GradientMap gradients; /** hash map: parameter set name -> gradient **/
+    GradientMap pendingGradients; /** gradients of the previous batch that are applied while pipelining **/
+    bool pipelined; /** whether update and postBatch apply the pending gradients **/
     ParameterUpdater* updater; /** pointer to a parameter updates **/
+    bool scoringOnly; /** whether the model only scores triples, e.g. a copy for evaluation, so it has no updater and no gradient buffers **/
     Data* data;
     std::string dumpLocation;
 
+    /**
+     * Get the gradients that are applied by update
+     * @return
+     */
+    GradientMap& getUpdateGradients() {
+        return pipelined ? pendingGradients : gradients;
+    }
+
+    Gradient& getUpdateGradient(const std::string& name) {
+        return getUpdateGradients().at(name);
+    }
+
     /**
      * Adds a embedding parameter set to the model
      * @param name name of the parameter
@@ -259,14 +492,48 @@ protected:
         parameters.insert({name, EmbeddingParameterSet(k, m)});
         // initialize parameter
         initializer->initialize(parameters.at(name), name);
-        // add parameter to gradient map
-        gradients.insert({name, Gradient(&parameters.at(name))});
+        // add parameter to gradient map, without gradient buffer if the model only scores triples
+        gradients.insert({name, scoringOnly ? Gradient(&parameters.at(name), 0) : Gradient(&parameters.at(name))});
+    }
+
+    /**
+     * Splits triples into their subjects, relations and objects, e.g. to gather their embeddings
+     * @param triples
+     * @param subjects
+     * @param relations
+     * @param objects
+     */
+    static void splitTriples(const std::vector<Triple>& triples, std::vector<EntityId>& subjects, std::vector<RelationId>& relations, std::vector<EntityId>& objects) {
+        subjects.resize(triples.size());
+        relations.resize(triples.size());
+        objects.resize(triples.size());
+        for (size_t i = 0; i < triples.size(); ++i) {
+            subjects[i] = triples[i].subject;
+            relations[i] = triples[i].relation;
+            objects[i] = triples[i].object;
+        }
+    }
+
+    /**
+     * Copies the given columns of a matrix into a local matrix, column by column
+     * @param matrix matrix to gather from
+     * @param ids column ids to gather
+     * @param gathered local matrix with one column per id
+     */
+    template <typename Id>
+    static void gatherColumns(const MatrixXd& matrix, const std::vector<Id>& ids, MatrixXd& gathered) {
+        gathered.resize(matrix.rows(), ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            gathered.col(i) = matrix.col(ids[i]);
+        }
     }
 
 private:
     void init() {
         // initialize initializer
         initializer = InitializerFactory::buildInitializer(config);
+        scoringOnly = config.get<bool>("scoringOnly", false);
+        updater = nullptr;
     }
 };
 
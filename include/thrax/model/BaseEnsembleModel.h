@@ -98,18 +98,109 @@ public:
         }
     }
 
+    /**
+     * Prepares the triple in each model
+     * @param triple
+     */
+    virtual void prepareTriple(const Triple& triple) override {
+        for (int i = 0; i < m; ++i) {
+            models[i]->prepareTriple(triple);
+        }
+    }
+
+    /**
+     * Synchronizes each model
+     */
+    virtual void synchronize() override {
+        for (int i = 0; i < m; ++i) {
+            models[i]->synchronize();
+        }
+    }
+
+    /** ##### PIPELINING ##### **/
+
+    virtual void enablePipelining() override {
+        AbstractModel::enablePipelining();
+        for (int i = 0; i < m; ++i) {
+            models[i]->enablePipelining();
+        }
+    }
+
+    virtual void swapGradients() override {
+        AbstractModel::swapGradients();
+        for (int i = 0; i < m; ++i) {
+            models[i]->swapGradients();
+        }
+    }
+
+    virtual void countStaleColumns(long& stale, long& touched) override {
+        AbstractModel::countStaleColumns(stale, touched);
+        for (int i = 0; i < m; ++i) {
+            models[i]->countStaleColumns(stale, touched);
+        }
+    }
+
+    /** ##### SHARED MEMORY ##### **/
+
+    /**
+     * Moves the ensemble parameters and the parameters of each model to shared memory
+     */
+    virtual void moveToSharedMemory() override {
+        AbstractModel::moveToSharedMemory();
+        for (int i = 0; i < m; ++i) {
+            models[i]->moveToSharedMemory();
+        }
+    }
+
+    /** ##### CHECKPOINTING ##### **/
+
+    /**
+     * Adds the training state of each model, prefixed by its index
+     * @return
+     */
+    virtual std::map<std::string, EmbeddingParameterSet*> getTrainingState() override {
+        std::map<std::string, EmbeddingParameterSet*> matrices = AbstractModel::getTrainingState();
+        for (int i = 0; i < m; ++i) {
+            for (auto& ptr: models[i]->getTrainingState()) {
+                matrices["model" + std::to_string(i) + "." + ptr.first] = ptr.second;
+            }
+        }
+        return matrices;
+    }
+
+    virtual void saveTrainingState(Message& state) override {
+        AbstractModel::saveTrainingState(state);
+        for (int i = 0; i < m; ++i) {
+            models[i]->saveTrainingState(state);
+        }
+    }
+
+    virtual void loadTrainingState(Message& state) override {
+        AbstractModel::loadTrainingState(state);
+        for (int i = 0; i < m; ++i) {
+            models[i]->loadTrainingState(state);
+        }
+    }
+
     /** ##### SERIALIZATION ##### **/
 
-    virtual void dump(std::string location) override {
-        // dump ensemble hyper parameters
-        AbstractModel::dump(location);
-        // dump all models
+    virtual void takeSnapshot(std::string location, ModelSnapshot& snapshot) override {
+        // copy ensemble hyper parameters
+        AbstractModel::takeSnapshot(location, snapshot);
+        // copy all models
         fs::path dir(location);
         dir /= "models";
-        fs::create_directories(dir);
         for (int i = 0; i < m; ++i) {
             fs::path modelPath = dir / models[i]->dumpName();
-            models[i]->dump(modelPath.string());
+            models[i]->takeSnapshot(modelPath.string(), snapshot);
+        }
+    }
+
+    virtual void copyParameters(AbstractModel* source) override {
+        AbstractModel::copyParameters(source);
+        BaseEnsembleModel* ensemble = dynamic_cast<BaseEnsembleModel*>(source);
+        for (int i = 0; i < m; ++i) {
+            models[i]->copyParameters(ensemble->models[i]);
         }
     }
 
@@ -129,6 +220,7 @@ private:
             // add the update config to each model
             modelConfig = ptr.second;
             modelConfig.put_child("update", config.get_child("update"));
+            modelConfig.put("scoringOnly", config.get<bool>("scoringOnly", false));
             BaseModel* model = ModelFactory::buildModel(data, modelConfig);
             models.push_back(model);
         }
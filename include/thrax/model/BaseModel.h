@@ -7,6 +7,8 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <cmath>
+#include <map>
 #include <thrax/util/Typedefs.h>
 #include "AbstractModel.h"
 
@@ -25,6 +27,15 @@ public:
         init();
     }
 
+    virtual void initParameterUpdater() override {
+        AbstractModel::initParameterUpdater();
+        if (lazyL2 && updater != nullptr && !updater->hasLearningRate()) {
+            // the decay factor 1 - 2*alpha*lambda*scale needs the step size of the updater
+            BOOST_LOG_TRIVIAL(error) << "Lazy L2 regularization needs an updater with a learning rate alpha, it can not be used with " << config.get<std::string>("update.type");
+            exit(1);
+        }
+    }
+
     /** ##### REGULARIZATION ##### **/
 
     /**
@@ -32,6 +43,11 @@ public:
      * @param scale is multiplied with lambda_* hyper parameters, e.g. when dividing by batch size
      */
     virtual void l2(double scale) override {
+        if (updater->isFused() || lazyL2 || numberOfServers > 0) {
+            // applied in the update, by the parameter servers if the parameters are sharded
+            l2Scale = scale;
+            return;
+        }
         if (scale * lambda_e > 0.0) {
             for (auto name: entityEmbeddings) {
                 getGradient(name).l2(lambda_e*scale);
@@ -44,21 +60,235 @@ public:
         }
     }
 
+    /** ##### MODEL UPDATES ##### **/
+
+    /**
+     * Updates the parameters, in a single pass together with L2 regularization and normalization if the updater is fused
+     */
+    virtual void update() override {
+        if (lazyL2) {
+            decayTouchedEmbeddings();
+        }
+        if (updater->isFused()) {
+            updater->update(getUpdateGradients(), parameters, getRegularization(lazyL2 ? 0.0 : getUpdateL2Scale()));
+            getUpdateL2Scale() = 0.0;
+        } else {
+            AbstractModel::update();
+        }
+    }
+
+    /**
+     * Get the regularization of each parameter set as used by the fused update pass
+     * @param scale is multiplied with lambda_* hyper parameters, e.g. when dividing by batch size
+     * @return
+     */
+    const RegularizationMap& getRegularization(double scale) {
+        for (auto name: entityEmbeddings) {
+            regularization[name] = {lambda_e * scale, normalizeEntities};
+        }
+        for (auto name: relationEmbeddings) {
+            regularization[name] = {lambda_r * scale, normalizeRelations};
+        }
+        return regularization;
+    }
+
+    /**
+     * Applies the pending lazy L2 decay to the embeddings of a triple, so they equal those of decaying every embedding
+     * in every step before the triple is scored
+     * @param triple
+     */
+    virtual void prepareTriple(const Triple& triple) override {
+        if (!lazyL2) {
+            return;
+        }
+        for (auto& ptr: cumulativeDecays) {
+            EmbeddingParameterSet& parameter = getParameter(ptr.first);
+            EmbeddingParameterSet& last = lastDecays.at(ptr.first);
+            if (relationEmbeddings.count(ptr.first) > 0) {
+                catchUpDecay(parameter, last, ptr.second, triple.relation);
+                continue;
+            }
+            if (subjectEmbeddings.count(ptr.first) > 0) {
+                catchUpDecay(parameter, last, ptr.second, triple.subject);
+            }
+            if (objectEmbeddings.count(ptr.first) > 0) {
+                catchUpDecay(parameter, last, ptr.second, triple.object);
+            }
+        }
+    }
+
+    /**
+     * Applies the pending lazy L2 decay to all embeddings, so that the parameters equal those of decaying every
+     * embedding in every step
+     */
+    virtual void synchronize() override {
+        for (auto& ptr: cumulativeDecays) {
+            EmbeddingParameterSet& parameter = getParameter(ptr.first);
+            EmbeddingParameterSet& last = lastDecays.at(ptr.first);
+            for (int id = 0; id < parameter.getNumberOfEmbeddings(); ++id) {
+                parameter.col(id) *= std::exp(ptr.second - last(0, id));
+                last(0, id) = ptr.second;
+            }
+        }
+    }
+
     /** ##### HOOKS ##### **/
     virtual void postBatch() override {
+        if (updater->isFused()) {
+            // already normalized in the fused update pass
+            return;
+        }
         // normalize embeddings
         if (normalizeEntities) {
             for (auto name: entityEmbeddings) {
-                getGradient(name).normalize();
+                getUpdateGradient(name).normalize();
             }
         }
         if (normalizeRelations) {
             for (auto name: relationEmbeddings) {
-                getGradient(name).normalize();
+                getUpdateGradient(name).normalize();
             }
         }
     }
 
+    /** ##### PIPELINING ##### **/
+
+    virtual void enablePipelining() override {
+        // the pending decay of a batch is applied while the update of the previous batch advances the decay
+        if (lazyL2) {
+            BOOST_LOG_TRIVIAL(error) << "Lazy L2 regularization is not supported with optimizer.pipelined";
+            exit(1);
+        }
+        AbstractModel::enablePipelining();
+    }
+
+    virtual void swapGradients() override {
+        AbstractModel::swapGradients();
+        pendingL2Scale = l2Scale;
+        l2Scale = 0.0;
+    }
+
+    /** ##### CHECKPOINTING ##### **/
+
+    /**
+     * Adds the lazy L2 timestamps to the training state
+     * @return
+     */
+    virtual std::map<std::string, EmbeddingParameterSet*> getTrainingState() override {
+        std::map<std::string, EmbeddingParameterSet*> matrices = AbstractModel::getTrainingState();
+        for (auto& ptr: lastDecays) {
+            matrices[ptr.first + ".decay"] = &ptr.second;
+        }
+        return matrices;
+    }
+
+    virtual void saveTrainingState(Message& state) override {
+        AbstractModel::saveTrainingState(state);
+        // in name order, the order of the unordered map may differ between runs
+        std::map<std::string, double> decays(cumulativeDecays.begin(), cumulativeDecays.end());
+        for (auto& ptr: decays) {
+            state.write<double>(ptr.second);
+        }
+    }
+
+    virtual void loadTrainingState(Message& state) override {
+        AbstractModel::loadTrainingState(state);
+        std::map<std::string, double> decays(cumulativeDecays.begin(), cumulativeDecays.end());
+        for (auto& ptr: decays) {
+            cumulativeDecays.at(ptr.first) = state.read<double>();
+        }
+    }
+
+    /** ##### PARTITIONING ##### **/
+
+    /**
+     * Number of entity partitions, only the entity embeddings of two partitions are resident if larger than one
+     * @return
+     */
+    int getNumberOfPartitions() const {
+        return numberOfPartitions;
+    }
+
+    /**
+     * Number of entities per partition, the last partition may hold fewer entities
+     * @return
+     */
+    int getPartitionSize() const {
+        return partitionSize;
+    }
+
+    /** ##### PARAMETER SERVER ##### **/
+
+    /**
+     * Number of parameter servers that hold the parameters sharded by id, zero if the model is trained locally
+     * @return
+     */
+    int getNumberOfServers() const {
+        return numberOfServers;
+    }
+
+    /**
+     * Number of columns of the entity parameter sets when training with parameter servers, i.e. the maximum number of
+     * distinct entities of a batch
+     * @return
+     */
+    int getResidentEntities() const {
+        return residentEntities;
+    }
+
+    /**
+     * Get the regularization of the current batch and reset it, used when the update is applied outside of the model
+     * @return
+     */
+    RegularizationMap takeRegularization() {
+        RegularizationMap batchRegularization = getRegularization(l2Scale);
+        l2Scale = 0.0;
+        return batchRegularization;
+    }
+
+    /**
+     * Get all matrices with one column per entity by a unique name: the entity embeddings, their lazy L2 timestamps
+     * and their updater state
+     * @return
+     */
+    std::map<std::string, EmbeddingParameterSet*> getEntityMatrices() {
+        std::map<std::string, EmbeddingParameterSet*> matrices;
+        for (auto& name: entityEmbeddings) {
+            matrices[name] = &getParameter(name);
+            if (lazyL2) {
+                matrices[name + ".decay"] = &lastDecays.at(name);
+            }
+            std::vector<EmbeddingParameterSet*> state = updater->getState(name);
+            for (int i = 0; i < state.size(); ++i) {
+                matrices[name + ".state" + std::to_string(i)] = state[i];
+            }
+        }
+        return matrices;
+    }
+
+    /**
+     * Initializes the embeddings of a slice of the ids of a parameter set with the initializer of the model, e.g. of one
+     * partition or one parameter server shard. Column i of the slice holds the embedding of id first + i * step.
+     * Pre-trained initializers load the embeddings of all ids, they are cut to the slice and ids beyond them are zero.
+     * @param name name of the parameter set
+     * @param parameterSet slice with one column per id
+     * @param first id of the first column
+     * @param step distance between the ids of consecutive columns
+     */
+    void initializeParameterSlice(const std::string& name, EmbeddingParameterSet& parameterSet, long first, long step) {
+        long n = parameterSet.getNumberOfEmbeddings();
+        initializer->initialize(parameterSet, name);
+        if (parameterSet.getNumberOfEmbeddings() == n) {
+            return;
+        }
+        MatrixXd all = parameterSet;
+        parameterSet = EmbeddingParameterSet(all.rows(), n);
+        parameterSet.setZero();
+        for (long i = 0; i < n && first + i * step < all.cols(); ++i) {
+            parameterSet.col(i) = all.col(first + i * step);
+        }
+    }
+
     /** ##### GRADIENT CHECKING ##### **/
 
     enum ParameterType {
@@ -81,6 +311,10 @@ public:
         return objectEmbeddings;
     }
 
+    const std::set<std::string>& getEntityEmbeddings() const {
+        return entityEmbeddings;
+    }
+
 protected:
     std::set<std::string> subjectEmbeddings; /** list of parameter set names used for subject embeddings (used by gradient checking) **/
     std::set<std::string> relationEmbeddings; /** list of parameter set names used for relation embeddings (used by gradient checking and L2 regularization) **/
@@ -90,6 +324,16 @@ protected:
     double lambda_r; /** L2 regularization hyper parameter for relation embeddings **/
     bool normalizeEntities; /** normalize entity embeddings to unit norm **/
     bool normalizeRelations; /** normalize relation embeddings to unit norm **/
+    double l2Scale; /** scale of the L2 regularization of the current batch, used by the fused update pass and lazy L2 **/
+    double pendingL2Scale; /** scale of the L2 regularization of the pending gradients when pipelining **/
+    bool lazyL2; /** apply L2 regularization as weight decay of all embeddings, lazily when an embedding is touched **/
+    std::unordered_map<std::string, double> cumulativeDecays; /** log of the product of all decay factors so far by parameter set name **/
+    ParameterMap lastDecays; /** 1xm cumulative log decay at which each embedding was last decayed **/
+    RegularizationMap regularization; /** regularization by parameter set name, used by the fused update pass **/
+    int numberOfPartitions; /** number of entity partitions for partitioned training **/
+    int partitionSize; /** number of entities per partition **/
+    int numberOfServers; /** number of parameter servers, zero if the model is trained locally **/
+    int residentEntities; /** number of entity columns of the local model when training with parameter servers **/
 
     /**
      * Adds a embedding parameter set to the model
@@ -98,6 +342,15 @@ protected:
      * @param m number of rows (entities/relations)
      */
     void addParameter(std::string name, int k, int m, ParameterType parameterType) {
+        // with partitioning, only the entity embeddings of two partitions are resident
+        if (numberOfPartitions > 1 && parameterType != RELATION && parameterType != META) {
+            m = 2 * partitionSize;
+        }
+        // with parameter servers, the entity embeddings of a batch are pulled into a window of columns
+        if (numberOfServers > 0 && parameterType != RELATION && parameterType != META) {
+            m = residentEntities;
+        }
+
         // call super-class to register parameter
         AbstractModel::addParameter(name, k, m);
 
@@ -113,6 +366,61 @@ protected:
             objectEmbeddings.insert(name);
             entityEmbeddings.insert(name);
         }
+
+        // timestamps of the lazy L2 decay
+        if (lazyL2 && parameterType != META) {
+            cumulativeDecays.insert({name, 0.0});
+            lastDecays.insert({name, EmbeddingParameterSet(1, m)});
+            lastDecays.at(name).setZero();
+        }
+    }
+
+    /**
+     * Scale of the L2 regularization of the gradients that are applied by update
+     * @return
+     */
+    double& getUpdateL2Scale() {
+        return pipelined ? pendingL2Scale : l2Scale;
+    }
+
+    /**
+     * Lazy L2 regularization: in every step all embeddings decay by the factor 1 - 2*alpha*lambda*scale, which is
+     * the SGD step of the L2 penalty. Instead of a dense pass, the log decay factors are summed up per parameter set
+     * and each embedding remembers the sum at its last decay, so the decay of the skipped steps is applied in closed
+     * form by prepareTriple before the embedding is scored again, or when the model is synchronized. The update then
+     * applies the factor of the current step to the embeddings of the batch, which are up to date.
+     */
+    void decayTouchedEmbeddings() {
+        double alpha = updater->getLearningRate();
+        for (auto& ptr: cumulativeDecays) {
+            double lambda = relationEmbeddings.count(ptr.first) > 0 ? lambda_r : lambda_e;
+            double factor = 1.0 - 2 * alpha * lambda * getUpdateL2Scale();
+            if (factor <= 0.0) {
+                BOOST_LOG_TRIVIAL(error) << "Lazy L2 decay factor " << factor << " of " << ptr.first << " is not positive, reduce lambda or alpha";
+                continue;
+            }
+            ptr.second += std::log(factor);
+            EmbeddingParameterSet& parameter = getParameter(ptr.first);
+            EmbeddingParameterSet& last = lastDecays.at(ptr.first);
+            for (auto& column: getUpdateGradient(ptr.first).getIdToCol()) {
+                parameter.col(column.first) *= factor;
+                last(0, column.first) = ptr.second;
+            }
+        }
+    }
+
+    /**
+     * Applies the decay of the steps since the last decay of an embedding
+     * @param parameter
+     * @param last cumulative log decay at the last decay of each embedding
+     * @param cumulativeDecay cumulative log decay of the parameter set
+     * @param id
+     */
+    static void catchUpDecay(EmbeddingParameterSet& parameter, EmbeddingParameterSet& last, double cumulativeDecay, EntityId id) {
+        if (last(0, id) != cumulativeDecay) {
+            parameter.col(id) *= std::exp(cumulativeDecay - last(0, id));
+            last(0, id) = cumulativeDecay;
+        }
     }
 
 private:
@@ -121,6 +429,16 @@ private:
         lambda_r = config.get<double>("hyperParameters.lambda_r", 0.0);
         normalizeEntities = config.get<bool>("hyperParameters.normalizeEntities", false);
         normalizeRelations = config.get<bool>("hyperParameters.normalizeRelations", false);
+        lazyL2 = config.get<bool>("hyperParameters.lazyL2", false);
+        l2Scale = 0.0;
+        pendingL2Scale = 0.0;
+        numberOfPartitions = std::max(1, config.get<int>("partitioning.numberOfPartitions", 1));
+        partitionSize = (numberOfEntities + numberOfPartitions - 1) / numberOfPartitions;
+        numberOfServers = std::max(0, config.get<int>("parameterServer.numberOfServers", 0));
+        residentEntities = config.get<int>("parameterServer.residentEntities", -1);
+        if (residentEntities <= 0 || residentEntities > numberOfEntities) {
+            residentEntities = numberOfEntities;
+        }
     }
 };
 
@@ -28,6 +28,8 @@ private:
     VectorXd s_i;
     VectorXd o_r;
     VectorXd o_i;
+    MatrixXd candidateEr; /** gathered real parts of the candidates of type-constrained scoring **/
+    MatrixXd candidateEi; /** gathered imaginary parts of the candidates of type-constrained scoring **/
 
     void initHyperParameters() {
         k = config.get<int>("hyperParameters.k");
@@ -70,6 +72,63 @@ public:
         return MathUtil::dot(r_r, s_r, o_r) + MathUtil::dot(r_r, s_i, o_i) + MathUtil::dot(r_i, s_r, o_i) - MathUtil::dot(r_i, s_i, o_r);
     }
 
+    virtual void scoreTriples(std::vector<Triple>& triples, VectorXd& scores) override {
+        std::vector<EntityId> subjects, objects;
+        std::vector<RelationId> relations;
+        splitTriples(triples, subjects, relations, objects);
+        MatrixXd subjectsR, subjectsI, relationsR, relationsI, objectsR, objectsI;
+        gatherColumns(*Er, subjects, subjectsR);
+        gatherColumns(*Ei, subjects, subjectsI);
+        gatherColumns(*Rr, relations, relationsR);
+        gatherColumns(*Ri, relations, relationsI);
+        gatherColumns(*Er, objects, objectsR);
+        gatherColumns(*Ei, objects, objectsI);
+        scores = (relationsR.array() * (subjectsR.array() * objectsR.array() + subjectsI.array() * objectsI.array())
+                  + relationsI.array() * (subjectsR.array() * objectsI.array() - subjectsI.array() * objectsR.array()))
+                .colwise().sum().transpose();
+    }
+
+    virtual bool canScoreTriplesConcurrently() const override {
+        // scoreTriples only writes to local matrices
+        return true;
+    }
+
+    virtual void scoreSubjectRelationChunk(int subjectId, int relationId, EntityId first, EntityId count, VectorXd& scores) override {
+        // coefficients of the real and imaginary part of the object
+        o_r = Rr->col(relationId).array()*Er->col(subjectId).array() - Ri->col(relationId).array()*Ei->col(subjectId).array();
+        o_i = Rr->col(relationId).array()*Ei->col(subjectId).array() + Ri->col(relationId).array()*Er->col(subjectId).array();
+        scores.noalias() = Er->middleCols(first, count).transpose() * o_r;
+        scores.noalias() += Ei->middleCols(first, count).transpose() * o_i;
+    }
+
+    virtual void scoreRelationObjectChunk(int relationId, int objectId, EntityId first, EntityId count, VectorXd& scores) override {
+        // coefficients of the real and imaginary part of the subject
+        s_r = Rr->col(relationId).array()*Er->col(objectId).array() + Ri->col(relationId).array()*Ei->col(objectId).array();
+        s_i = Rr->col(relationId).array()*Ei->col(objectId).array() - Ri->col(relationId).array()*Er->col(objectId).array();
+        scores.noalias() = Er->middleCols(first, count).transpose() * s_r;
+        scores.noalias() += Ei->middleCols(first, count).transpose() * s_i;
+    }
+
+    virtual void scoreSubjectRelationCandidates(int subjectId, int relationId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        gatherColumns(*Er, candidates, candidateEr);
+        gatherColumns(*Ei, candidates, candidateEi);
+        // coefficients of the real and imaginary part of the object
+        o_r = Rr->col(relationId).array()*Er->col(subjectId).array() - Ri->col(relationId).array()*Ei->col(subjectId).array();
+        o_i = Rr->col(relationId).array()*Ei->col(subjectId).array() + Ri->col(relationId).array()*Er->col(subjectId).array();
+        scores.noalias() = candidateEr.transpose() * o_r;
+        scores.noalias() += candidateEi.transpose() * o_i;
+    }
+
+    virtual void scoreRelationObjectCandidates(int relationId, int objectId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        gatherColumns(*Er, candidates, candidateEr);
+        gatherColumns(*Ei, candidates, candidateEi);
+        // coefficients of the real and imaginary part of the subject
+        s_r = Rr->col(relationId).array()*Er->col(objectId).array() + Ri->col(relationId).array()*Ei->col(objectId).array();
+        s_i = Rr->col(relationId).array()*Ei->col(objectId).array() - Ri->col(relationId).array()*Er->col(objectId).array();
+        scores.noalias() = candidateEr.transpose() * s_r;
+        scores.noalias() += candidateEi.transpose() * s_i;
+    }
+
     virtual void gradient(Triple& triple, double scale) override {
         s_r = Er->col(triple.subject);
         s_i = Ei->col(triple.subject);
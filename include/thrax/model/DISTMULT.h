@@ -28,6 +28,7 @@ private:
     VectorXd subjectEmbedding;
     VectorXd relationEmbedding;
     VectorXd objectEmbedding;
+    MatrixXd candidateEmbeddings; /** gathered embeddings of the candidates of type-constrained scoring **/
 
     void initHyperParameters() {
         k = config.get<int>("hyperParameters.k");
@@ -55,6 +56,44 @@ public:
         return (E->col(triple.subject).array() * R->col(triple.relation).array() * E->col(triple.object).array()).sum();
     }
 
+    virtual void scoreTriples(std::vector<Triple>& triples, VectorXd& scores) override {
+        std::vector<EntityId> subjects, objects;
+        std::vector<RelationId> relations;
+        splitTriples(triples, subjects, relations, objects);
+        MatrixXd subjectEmbeddings, relationEmbeddings, objectEmbeddings;
+        gatherColumns(*E, subjects, subjectEmbeddings);
+        gatherColumns(*R, relations, relationEmbeddings);
+        gatherColumns(*E, objects, objectEmbeddings);
+        scores = (subjectEmbeddings.array() * relationEmbeddings.array() * objectEmbeddings.array()).colwise().sum().transpose();
+    }
+
+    virtual bool canScoreTriplesConcurrently() const override {
+        // scoreTriples only writes to local matrices
+        return true;
+    }
+
+    virtual void scoreSubjectRelationChunk(int subjectId, int relationId, EntityId first, EntityId count, VectorXd& scores) override {
+        objectEmbedding = E->col(subjectId).array() * R->col(relationId).array();
+        scores.noalias() = E->middleCols(first, count).transpose() * objectEmbedding;
+    }
+
+    virtual void scoreRelationObjectChunk(int relationId, int objectId, EntityId first, EntityId count, VectorXd& scores) override {
+        subjectEmbedding = R->col(relationId).array() * E->col(objectId).array();
+        scores.noalias() = E->middleCols(first, count).transpose() * subjectEmbedding;
+    }
+
+    virtual void scoreSubjectRelationCandidates(int subjectId, int relationId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        gatherColumns(*E, candidates, candidateEmbeddings);
+        objectEmbedding = E->col(subjectId).array() * R->col(relationId).array();
+        scores.noalias() = candidateEmbeddings.transpose() * objectEmbedding;
+    }
+
+    virtual void scoreRelationObjectCandidates(int relationId, int objectId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        gatherColumns(*E, candidates, candidateEmbeddings);
+        subjectEmbedding = R->col(relationId).array() * E->col(objectId).array();
+        scores.noalias() = candidateEmbeddings.transpose() * subjectEmbedding;
+    }
+
     virtual void gradient(Triple& triple, double scale) override {
         subjectEmbedding = R->col(triple.relation).array() * E->col(triple.object).array();
         relationEmbedding = E->col(triple.subject).array() * E->col(triple.object).array();
@@ -5,30 +5,108 @@
 #ifndef THRAX_EMBEDDINGPARAMETERSET_H
 #define THRAX_EMBEDDINGPARAMETERSET_H
 
+#include <algorithm>
+#include <new>
 #include <vector>
+#include <boost/log/trivial.hpp>
 
 #include <thrax/initializer/Initializer.h>
+#include <thrax/util/SharedMemory.h>
 #include <Eigen/Dense>
 
 using namespace Eigen;
 
 /**
  * Class to hold a parameter set of an embedding model e.g. the relation embeddings.
+ * The values are stored in a buffer owned by the parameter set, or in shared memory to share them with worker processes.
  */
-class EmbeddingParameterSet: public MatrixXd {
+class EmbeddingParameterSet: public Map<MatrixXd> {
 public:
     /**
      * Copy constructor
      * @param M
      */
-    EmbeddingParameterSet(MatrixXd M): MatrixXd(M) { }
+    EmbeddingParameterSet(const MatrixXd& M): Map<MatrixXd>(nullptr, 0, 0), sharedBytes(0) {
+        allocate(M.rows(), M.cols());
+        Map<MatrixXd>::operator=(M);
+    }
 
     /**
      * Constructor of EmbeddingParameterSet
      * @param k dimension of one embedding
      * @param m number of embeddings
      */
-    EmbeddingParameterSet(int k, int m) : Matrix(k, m) {
+    EmbeddingParameterSet(int k, int m) : Map<MatrixXd>(nullptr, 0, 0), sharedBytes(0) {
+        allocate(k, m);
+    }
+
+    /**
+     * Copies the values, a copy of a shared parameter set is not shared
+     * @param other
+     */
+    EmbeddingParameterSet(const EmbeddingParameterSet& other): Map<MatrixXd>(nullptr, 0, 0), sharedBytes(0) {
+        allocate(other.rows(), other.cols());
+        Map<MatrixXd>::operator=(other);
+    }
+
+    EmbeddingParameterSet& operator=(const EmbeddingParameterSet& other) {
+        if (this != &other) {
+            resize(other.rows(), other.cols());
+            Map<MatrixXd>::operator=(other);
+        }
+        return *this;
+    }
+
+    /**
+     * Assigns an expression of the same size
+     * @param other
+     * @return
+     */
+    template <typename Derived>
+    EmbeddingParameterSet& operator=(const DenseBase<Derived>& other) {
+        Map<MatrixXd>::operator=(other);
+        return *this;
+    }
+
+    ~EmbeddingParameterSet() {
+        releaseShared();
+    }
+
+    /**
+     * Changes the size, the values are undefined afterwards unless the size does not change
+     * @param k dimension of one embedding
+     * @param m number of embeddings
+     */
+    void resize(long k, long m) {
+        if (rows() == k && cols() == m) {
+            return;
+        }
+        if (isShared()) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot resize a parameter set in shared memory";
+            exit(1);
+        }
+        allocate(k, m);
+    }
+
+    /**
+     * Moves the values to shared memory, so that processes forked afterwards update the same values
+     */
+    void moveToSharedMemory() {
+        if (isShared()) {
+            return;
+        }
+        size_t bytes = sizeof(double) * size();
+        double* shared = (double*)SharedMemory::allocate(bytes);
+        std::copy(data(), data() + size(), shared);
+        long k = rows();
+        long m = cols();
+        new (static_cast<Map<MatrixXd>*>(this)) Map<MatrixXd>(shared, k, m);
+        std::vector<double>().swap(buffer);
+        sharedBytes = bytes;
+    }
+
+    bool isShared() const {
+        return sharedBytes > 0;
     }
 
     /**
@@ -78,6 +156,23 @@ public:
 //private:
 //    int m; /** number of embeddings */
 //    int k; /** dimensionality of a single embedding */
+
+private:
+    std::vector<double> buffer; /** owned values, empty if the values are in shared memory **/
+    size_t sharedBytes; /** size of the shared memory segment, 0 if the values are owned **/
+
+    void allocate(long k, long m) {
+        releaseShared();
+        std::vector<double>(k * m).swap(buffer);
+        new (static_cast<Map<MatrixXd>*>(this)) Map<MatrixXd>(buffer.data(), k, m);
+    }
+
+    void releaseShared() {
+        if (isShared()) {
+            SharedMemory::release(data(), sharedBytes);
+            sharedBytes = 0;
+        }
+    }
 };
 
 
@@ -0,0 +1,76 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_MODELSNAPSHOT_H
+#define THRAX_MODELSNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <thrax/struct/Data.h>
+#include <thrax/util/FileUtil.h>
+
+namespace fs = boost::filesystem;
+using namespace Eigen;
+
+/**
+ * Copy of the parameters of a model taken at one point of training, which can be written to disk while training goes
+ * on. Holds one matrix per parameter file and the directories of the models, e.g. of an ensemble and its members.
+ */
+class ModelSnapshot {
+public:
+    /**
+     * Copies a parameter set
+     * @param location directory of the model
+     * @param name name of the parameter set, used as file name in <location>/parameters
+     * @param parameter
+     */
+    void addParameter(const std::string& location, const std::string& name, const Ref<const MatrixXd>& parameter) {
+        fs::path path = fs::path(location) / "parameters" / name;
+        files.push_back(path.string());
+        matrices.push_back(parameter);
+    }
+
+    /**
+     * Adds the directory of a model, which gets the mappings of data. The vocabularies do not change during training
+     * and are not copied.
+     * @param location
+     * @param data may be nullptr
+     */
+    void addModel(const std::string& location, const Data* data) {
+        locations.push_back(location);
+        mappingData.push_back(data);
+    }
+
+    /**
+     * Writes all copied parameters and mappings
+     */
+    void write() const {
+        for (size_t i = 0; i < locations.size(); ++i) {
+            fs::create_directories(fs::path(locations[i]) / "parameters");
+            BOOST_LOG_TRIVIAL(info) << "Dumping model to " << locations[i];
+        }
+        for (size_t i = 0; i < files.size(); ++i) {
+            FileUtil::dumpMatrix(files[i], matrices[i]);
+        }
+        // dump the shared vocabularies, so the parameters can be mapped back to names
+        for (size_t i = 0; i < locations.size(); ++i) {
+            if (mappingData[i] != nullptr) {
+                mappingData[i]->dumpMappings(locations[i]);
+            }
+        }
+    }
+
+private:
+    std::vector<std::string> files; /** path of each copied parameter set **/
+    std::vector<MatrixXd> matrices; /** copy of each parameter set **/
+    std::vector<std::string> locations; /** directory of each model **/
+    std::vector<const Data*> mappingData; /** data whose mappings are dumped to the directory of the model of the same index **/
+};
+
+
+#endif //THRAX_MODELSNAPSHOT_H
@@ -23,6 +23,8 @@ private:
     Gradient* dE;
     Gradient* dR;
     MatrixXd tmpR;
+    MatrixXd candidateEmbeddings; /** gathered embeddings of the candidates of type-constrained scoring **/
+    VectorXd query; /** subject or object embedding multiplied with the relation matrix **/
 
     void initHyperParameters() {
         k = config.get<int>("hyperParameters.k");
@@ -34,6 +36,7 @@ private:
         dE = &(getGradient("E"));
         dR = &(getGradient("R"));
         tmpR.resize(k, k);
+        query.resize(k);
     }
 
 public:
@@ -57,6 +60,33 @@ public:
         scores = E->transpose() * Map<MatrixXd>(R->col(relationId).data(), k, k) * E->col(objectId);
     }
 
+    virtual void scoreSubjectRelationChunk(int subjectId, int relationId, EntityId first, EntityId count, VectorXd& scores) override {
+        query.noalias() = Map<MatrixXd>(R->col(relationId).data(), k, k).transpose() * E->col(subjectId);
+        scores.noalias() = E->middleCols(first, count).transpose() * query;
+    }
+
+    virtual void scoreRelationObjectChunk(int relationId, int objectId, EntityId first, EntityId count, VectorXd& scores) override {
+        query.noalias() = Map<MatrixXd>(R->col(relationId).data(), k, k) * E->col(objectId);
+        scores.noalias() = E->middleCols(first, count).transpose() * query;
+    }
+
+    virtual void scoreSubjectRelationCandidates(int subjectId, int relationId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        gatherColumns(*E, candidates, candidateEmbeddings);
+        query.noalias() = Map<MatrixXd>(R->col(relationId).data(), k, k).transpose() * E->col(subjectId);
+        scores.noalias() = candidateEmbeddings.transpose() * query;
+    }
+
+    virtual void scoreRelationObjectCandidates(int relationId, int objectId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        gatherColumns(*E, candidates, candidateEmbeddings);
+        query.noalias() = Map<MatrixXd>(R->col(relationId).data(), k, k) * E->col(objectId);
+        scores.noalias() = candidateEmbeddings.transpose() * query;
+    }
+
+    virtual bool canScoreTriplesConcurrently() const override {
+        // score does not use the buffers of the model
+        return true;
+    }
+
     virtual void gradient(Triple& triple, double scale) override {
         // triple subject: -R_r*E_o
         dE->add(triple.subject, scale*(Map<MatrixXd>(R->col(triple.relation).data(), k, k) * E->col(triple.object)));
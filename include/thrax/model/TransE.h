@@ -36,6 +36,7 @@ private:
     VectorXd subjectEmbedding;
     VectorXd relationEmbedding;
     VectorXd objectEmbedding;
+    MatrixXd candidateEmbeddings; /** copied embeddings of the candidates or the chunk that is scored **/
 
     void initHyperParameters() {
         k = config.get<int>("hyperParameters.k");
@@ -53,6 +54,18 @@ private:
         objectEmbedding.resize(k);
     }
 
+    /**
+     * Scores candidates from the differences s + r - o, up to the sign, in the columns of candidateEmbeddings
+     * @param scores
+     */
+    void scoreDifferences(VectorXd& scores) {
+        if (useL1) {
+            scores = -candidateEmbeddings.cwiseAbs().colwise().sum().transpose();
+        } else {
+            scores = -candidateEmbeddings.colwise().squaredNorm().transpose();
+        }
+    }
+
 public:
     TransE(Data* data, pt::ptree& config): BaseModel(data, config) {
         initHyperParameters();
@@ -75,6 +88,64 @@ public:
         }
     }
 
+    /**
+     * Calculate TransE scores of a batch of triples at once
+     * @param triples
+     * @param scores TransE score of each triple
+     */
+    virtual void scoreTriples(std::vector<Triple>& triples, VectorXd& scores) override {
+        std::vector<EntityId> subjects, objects;
+        std::vector<RelationId> relations;
+        splitTriples(triples, subjects, relations, objects);
+        MatrixXd differences, relationEmbeddings, objectEmbeddings;
+        gatherColumns(*E, subjects, differences);
+        gatherColumns(*R, relations, relationEmbeddings);
+        gatherColumns(*E, objects, objectEmbeddings);
+        differences += relationEmbeddings - objectEmbeddings;
+        if (useL1) {
+            scores = -differences.cwiseAbs().colwise().sum().transpose();
+        } else {
+            scores = -differences.colwise().squaredNorm().transpose();
+        }
+    }
+
+    virtual bool canScoreTriplesConcurrently() const override {
+        // scoreTriples only writes to local matrices
+        return true;
+    }
+
+    virtual void scoreSubjectRelationChunk(int subjectId, int relationId, EntityId first, EntityId count, VectorXd& scores) override {
+        // s + r - o for the objects o of the chunk
+        tmp = E->col(subjectId) + R->col(relationId);
+        candidateEmbeddings = E->middleCols(first, count);
+        candidateEmbeddings.colwise() -= tmp;
+        scoreDifferences(scores);
+    }
+
+    virtual void scoreRelationObjectChunk(int relationId, int objectId, EntityId first, EntityId count, VectorXd& scores) override {
+        // s + r - o for the subjects s of the chunk
+        tmp = E->col(objectId) - R->col(relationId);
+        candidateEmbeddings = E->middleCols(first, count);
+        candidateEmbeddings.colwise() -= tmp;
+        scoreDifferences(scores);
+    }
+
+    virtual void scoreSubjectRelationCandidates(int subjectId, int relationId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        // s + r - o for all candidate objects o
+        tmp = E->col(subjectId) + R->col(relationId);
+        gatherColumns(*E, candidates, candidateEmbeddings);
+        candidateEmbeddings.colwise() -= tmp;
+        scoreDifferences(scores);
+    }
+
+    virtual void scoreRelationObjectCandidates(int relationId, int objectId, const std::vector<EntityId>& candidates, VectorXd& scores) override {
+        // s + r - o for all candidate subjects s
+        tmp = E->col(objectId) - R->col(relationId);
+        gatherColumns(*E, candidates, candidateEmbeddings);
+        candidateEmbeddings.colwise() -= tmp;
+        scoreDifferences(scores);
+    }
+
     virtual void gradient(Triple& triple, double scale) override {
         tmp = E->col(triple.subject);
         tmp += R->col(triple.relation);
@@ -0,0 +1,188 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_MULTIPROCESSOPTIMIZER_H
+#define THRAX_MULTIPROCESSOPTIMIZER_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <Eigen/Core>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/util/RandomUtil.h>
+#include "Optimizer.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Data parallel training with several processes on one machine. The parameters and the updater state of the model are
+ * moved to shared memory, then N worker processes are forked that each own a disjoint shard of the training triples.
+ * In each epoch every worker runs the mini batch loop of the Optimizer on its shuffled shard and updates the touched
+ * embeddings in place without locking (asynchronous sparse updates in the style of Hogwild!). The coordinator process
+ * starts the epochs, sums the loss statistics of the workers and handles early stopping and dumps while the workers
+ * wait for the next epoch.
+ * Gradients, samplers (including the cache of the cache sampler) and the step counter of the updater are private to
+ * each worker. Lazy L2 regularization keeps a per process decay and is not supported.
+ */
+class MultiProcessOptimizer: public Optimizer {
+public:
+    MultiProcessOptimizer(Data* trainData, Data* validData, Data* testData, AbstractModel* model, pt::ptree config):
+    Optimizer(trainData, validData, testData, model, config) {
+        initProcesses();
+    }
+
+protected:
+    int numberOfProcesses; /** number of worker processes **/
+    std::vector<pid_t> workers; /** process id of each worker, empty until the first epoch **/
+    std::vector<int> commandPipes; /** write end of the pipe to each worker: 1 starts an epoch, 0 terminates **/
+    std::vector<int> resultPipes; /** read end of the pipe from each worker, loss statistics after each epoch **/
+
+    void initProcesses() {
+        numberOfProcesses = config.get<int>("optimizer.numberOfProcesses", 1);
+        if (config.get<bool>("model.hyperParameters.lazyL2", false)) {
+            BOOST_LOG_TRIVIAL(error) << "Lazy L2 regularization is not supported with optimizer.numberOfProcesses > 1";
+            exit(1);
+        }
+        model->moveToSharedMemory();
+        BOOST_LOG_TRIVIAL(info) << "Training with " << numberOfProcesses << " processes on parameters in shared memory";
+    }
+
+    /**
+     * Forks the workers, each trains on a contiguous shard of the triple indices
+     * @param indices
+     */
+    void startWorkers(std::vector<TripleId> &indices) {
+        // draw the seeds before forking, so the workers sample different negatives
+        std::vector<unsigned> seeds(numberOfProcesses);
+        for (int i = 0; i < numberOfProcesses; ++i) {
+            seeds[i] = (unsigned)RandomUtil::uniformLong(0, 1L << 32);
+        }
+        for (int i = 0; i < numberOfProcesses; ++i) {
+            int command[2];
+            int result[2];
+            if (pipe(command) == -1 || pipe(result) == -1) {
+                BOOST_LOG_TRIVIAL(error) << "Could not create pipes for worker " << i;
+                exit(1);
+            }
+            pid_t pid = fork();
+            if (pid == -1) {
+                BOOST_LOG_TRIVIAL(error) << "Could not fork worker " << i;
+                exit(1);
+            }
+            if (pid == 0) {
+                close(command[1]);
+                close(result[0]);
+                for (int fd: commandPipes) {
+                    close(fd);
+                }
+                for (int fd: resultPipes) {
+                    close(fd);
+                }
+                TripleId first = indices.size() * i / numberOfProcesses;
+                TripleId end = indices.size() * (i + 1) / numberOfProcesses;
+                std::vector<TripleId> shard(indices.begin() + first, indices.begin() + end);
+                runWorker(seeds[i], shard, command[0], result[1]);
+            }
+            close(command[0]);
+            close(result[1]);
+            workers.push_back(pid);
+            commandPipes.push_back(command[1]);
+            resultPipes.push_back(result[0]);
+        }
+    }
+
+    /**
+     * Main loop of a worker process, never returns
+     * @param seed
+     * @param shard
+     * @param commandPipe
+     * @param resultPipe
+     */
+    void runWorker(unsigned seed, std::vector<TripleId> &shard, int commandPipe, int resultPipe) {
+        // the workers are the parallelism, matrix products must not spawn threads of their own
+        Eigen::setNbThreads(1);
+        RandomUtil::seed(seed);
+        char command;
+        while (readFully(commandPipe, &command, sizeof(command)) && command == 1) {
+            lossFunction->reset();
+            Optimizer::trainEpoch(shard);
+            double statistics[3] = {lossFunction->getLoss(), lossFunction->getNumberOfGradientComputations(), lossFunction->getNumberOfGradientCalls()};
+            if (write(resultPipe, statistics, sizeof(statistics)) != sizeof(statistics)) {
+                break;
+            }
+        }
+        // skip destructors and exit handlers that belong to the coordinator
+        _exit(0);
+    }
+
+    /**
+     * Reads a number of bytes from a pipe
+     * @return false if the pipe was closed before
+     */
+    static bool readFully(int fd, void* buffer, size_t bytes) {
+        char* position = (char*)buffer;
+        while (bytes > 0) {
+            ssize_t n = read(fd, position, bytes);
+            if (n <= 0) {
+                return false;
+            }
+            position += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
+    /**
+     * Runs one epoch in all workers and waits for them to finish
+     * @param indices indices of all training triples, split into the shards when the workers are started
+     */
+    virtual void trainEpoch(std::vector<TripleId> &indices) override {
+        if (workers.empty()) {
+            std::shuffle(indices.begin(), indices.end(), RandomUtil::gen);
+            startWorkers(indices);
+        }
+        char command = 1;
+        for (int i = 0; i < numberOfProcesses; ++i) {
+            if (write(commandPipes[i], &command, sizeof(command)) != sizeof(command)) {
+                BOOST_LOG_TRIVIAL(error) << "Could not start epoch in worker " << i;
+                exit(1);
+            }
+        }
+        for (int i = 0; i < numberOfProcesses; ++i) {
+            double statistics[3];
+            if (!readFully(resultPipes[i], statistics, sizeof(statistics))) {
+                BOOST_LOG_TRIVIAL(error) << "Worker " << i << " terminated unexpectedly";
+                exit(1);
+            }
+            lossFunction->accumulate(statistics[0], statistics[1], statistics[2]);
+        }
+    }
+
+    /**
+     * Terminates the workers
+     */
+    virtual void postTraining() override {
+        char command = 0;
+        for (int i = 0; i < workers.size(); ++i) {
+            if (write(commandPipes[i], &command, sizeof(command)) != sizeof(command)) {
+                BOOST_LOG_TRIVIAL(warning) << "Could not terminate worker " << i;
+            }
+            close(commandPipes[i]);
+            close(resultPipes[i]);
+        }
+        for (pid_t pid: workers) {
+            waitpid(pid, nullptr, 0);
+        }
+        workers.clear();
+        commandPipes.clear();
+        resultPipes.clear();
+    }
+};
+
+
+#endif //THRAX_MULTIPROCESSOPTIMIZER_H
@@ -8,21 +8,31 @@
 #include <numeric>
 #include <random>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <boost/timer/timer.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include <thrax/sampler/Sampler.h>
 #include <thrax/sampler/SamplerFactory.h>
+#include <thrax/struct/CandidateIndex.h>
 #include <thrax/struct/Data.h>
+#include <thrax/util/Checkpoint.h>
+#include <thrax/util/EpochChecker.h>
+#include <thrax/util/RandomUtil.h>
+#include <thrax/util/SnapshotWriter.h>
 #include <thrax/util/Typedefs.h>
 #include <thrax/initializer/Initializer.h>
 #include <thrax/initializer/ScalarInitializer.h>
 #include <thrax/struct/Gradient.h>
+#include <thrax/evaluation/BackgroundEvaluation.h>
 #include <thrax/evaluation/Evaluation.h>
 #include <thrax/lossFunction/LossFunction.h>
 #include <thrax/lossFunction/LossFunctionFactory.h>
 #include <thrax/model/AbstractModel.h>
+#include <thrax/model/ModelFactory.h>
+#include <thrax/model/TrivialEnsemble.h>
 
 namespace pt = boost::property_tree;
 
@@ -39,54 +49,73 @@ public:
 
     void fit() {
         // create vector of indices
-        std::vector<int> indices(trainData->getNumberOfTriples());
-        std::iota(indices.begin(), indices.end(), 0);
-        int numberOfBatches = (trainData->getNumberOfTriples() + batchSize - 1) / batchSize;
+        std::vector<TripleId> indices(trainData->getNumberOfTriples());
         boost::timer::cpu_timer totalTimer;
         boost::timer::cpu_timer epochTimer;
         std::vector<Data*> lookupDataSets {trainData, validData, testData};
-        Evaluation evaluation(lookupDataSets);
-        bool isModelDumped = false;
-        int epochsTrained = 0;
+        Evaluation evaluation(lookupDataSets, earlyStoppingTypeConstrained ? candidateIndex : nullptr, Evaluation::parseTiePolicy(config.get<std::string>("evaluation.ties", "optimistic")));
 
         // start training loop
-        for (int epoch = 0; epoch < maxEpochs; ++epoch) {
+        for (int epoch = startEpoch; epoch < maxEpochs; ++epoch) {
             BOOST_LOG_TRIVIAL(info) << "Start epoch " << epoch + 1 << "/" << maxEpochs;
             preEpoch();
             epochTimer.start();
-            // randomly shuffle examples
-            std::random_shuffle(indices.begin(), indices.end());
-            // loop over batches
-            for (int batch = 0; batch < numberOfBatches; ++batch) {
-                processBatch(indices, batch * batchSize, std::min(batch * batchSize + batchSize, trainData->getNumberOfTriples()));
-            }
+            // start from the same order in every epoch, so the shuffled order only depends on the state of the random
+            // number generator, which is part of checkpoints
+            std::iota(indices.begin(), indices.end(), 0);
+            trainEpoch(indices);
             model->postEpoch();
             epochTimer.stop();
+            if (epochChecker != nullptr) {
+                epochChecker->check(epoch);
+            }
             BOOST_LOG_TRIVIAL(info) << "Finished epoch in " << epochTimer.format(3, "%w sec");
             double time = epochTimer.elapsed().wall / 1000000000.0;
             times[epoch] = time;
             losses[epoch] = lossFunction->getLoss();
+            gradientCalls[epoch] = lossFunction->getNumberOfGradientCalls();
             epochsTrained++;
             postEpoch();
+            // apply the result of the evaluation in the background after the epoch that follows its snapshot
+            if (backgroundEvaluation != nullptr && backgroundEvaluation->isPending() && !applyBackgroundEvaluation()) {
+                break;
+            }
             // early stopping
             if (useEarlyStopping && (epoch + 1) % earlyStoppingEveryNEpochs == 0) {
-                BOOST_LOG_TRIVIAL(info) << "Early stopping: start evaluation on validation data.";
-                double rawMRR;
-                double filteredMRR;
-                evaluation.MRR(model, validData, earlyStoppingN, rawMRR, filteredMRR);
-                mrrs[epoch] = filteredMRR;
-                // check if score on validation data improves, if not break the loop
-                if (filteredMRR > earlyStoppingBestValue) {
-                    BOOST_LOG_TRIVIAL(info) << "Early stopping: performance on validation data did improve. Filtered MRR: " << earlyStoppingBestValue << " -> " << filteredMRR << ", raw MRR: " << rawMRR;
-                    earlyStoppingBestValue = filteredMRR;
-                    // dump so far best performing model
-                    model->dump(model->getDumpLocation());
-                    isModelDumped = true;
+                if (concurrentEarlyStopping) {
+                    startBackgroundEvaluation(evaluation, epoch);
                 } else {
-                    BOOST_LOG_TRIVIAL(info) << "Early stopping: performance on validation data did not improve. Filtered MRR: " << earlyStoppingBestValue << " -> " << filteredMRR << ", raw MRR: " << rawMRR << ". Stop training.";
-                    break;
+                    BOOST_LOG_TRIVIAL(info) << "Early stopping: start evaluation on validation data.";
+                    double rawMRR;
+                    double filteredMRR;
+                    if (earlyStoppingConfidence > 0.0) {
+                        TripleId n = evaluation.sequentialMRR(model, validData, earlyStoppingN, earlyStoppingBestValue, earlyStoppingConfidence, earlyStoppingBlockSize, rawMRR, filteredMRR);
+                        BOOST_LOG_TRIVIAL(info) << "Early stopping: estimated the MRR on " << n << " validation triples";
+                    } else {
+                        evaluation.MRR(model, validData, earlyStoppingN, rawMRR, filteredMRR);
+                    }
+                    if (!applyEarlyStopping(epoch, rawMRR, filteredMRR, false)) {
+                        break;
+                    }
                 }
             }
+            if (checkpointEveryNEpochs > 0 && (epoch + 1) % checkpointEveryNEpochs == 0) {
+                saveCheckpoint(epoch + 1);
+            }
+        }
+        if (backgroundEvaluation != nullptr) {
+            if (backgroundEvaluation->isPending()) {
+                applyBackgroundEvaluation();
+            }
+            delete backgroundEvaluation;
+            backgroundEvaluation = nullptr;
+        }
+        postTraining();
+        // finish writing the snapshots of the best model
+        if (snapshotWriter != nullptr) {
+            snapshotWriter->wait();
+            delete snapshotWriter;
+            snapshotWriter = nullptr;
         }
         // dump model if not already dumped
         if (!isModelDumped) {
@@ -95,7 +124,51 @@ public:
         totalTimer.stop();
         BOOST_LOG_TRIVIAL(info) << "Total time: " << totalTimer.format(3, "%w sec");
         // log training statistics
-        FileUtil::dumpTrainingStatistics(model->getDumpLocation(), losses, times, mrrs, epochsTrained);
+        FileUtil::dumpTrainingStatistics(model->getDumpLocation(), losses, times, mrrs, gradientCalls, epochsTrained);
+    }
+
+    /**
+     * Sets the type constraints of the relations, used by the sampler with optimizer.sampling.typeConstrained and by
+     * early stopping with optimizer.earlyStopping.typeConstrained
+     * @param candidateIndex
+     */
+    void setCandidateIndex(CandidateIndex* candidateIndex) {
+        this->candidateIndex = candidateIndex;
+        if (config.get<bool>("optimizer.sampling.typeConstrained", false)) {
+            sampler->setCandidateIndex(candidateIndex);
+        }
+    }
+
+    /**
+     * Whether the model holds all parameters after training, so it can be evaluated. Partitioned training may only dump
+     * the model.
+     * @return
+     */
+    virtual bool isModelComplete() const {
+        return true;
+    }
+
+    /**
+     * Continues training from the checkpoint in <dumpLocation>/checkpoint: loads the model, the updater state, the
+     * random number generator and the statistics, fit then starts with the epoch after the checkpoint
+     */
+    void resume() {
+        checkCheckpointSupport();
+        if (checkpoint == nullptr) {
+            checkpoint = new Checkpoint(getCheckpointLocation());
+        }
+        Message state;
+        checkpoint->load(model, state);
+        startEpoch = state.read<int32_t>();
+        epochsTrained = state.read<int32_t>();
+        earlyStoppingBestValue = state.read<double>();
+        isModelDumped = state.read<uint8_t>() != 0;
+        RandomUtil::setState(state.readString());
+        for (std::vector<double>* history: {&losses, &times, &mrrs, &gradientCalls}) {
+            history->resize(std::max((uint64_t)maxEpochs, state.read<uint64_t>()));
+            state.read(history->data(), startEpoch);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Resuming training after epoch " << startEpoch << ", best filtered MRR on validation data: " << earlyStoppingBestValue;
     }
 
 protected:
@@ -115,14 +188,43 @@ protected:
     int earlyStoppingEveryNEpochs; /** evaluate model on validation set every n epochs **/
     double earlyStoppingBestValue; /** historically best value of validation metric **/
     int earlyStoppingN;
+    double earlyStoppingConfidence; /** confidence of the sequential estimate of the MRR, 0 evaluates earlyStoppingN triples **/
+    int earlyStoppingBlockSize; /** number of validation triples of the first block of the sequential estimate **/
+    bool earlyStoppingTypeConstrained; /** whether early stopping ranks only the candidates of the relations **/
+    CandidateIndex* candidateIndex; /** type constraints of the relations, nullptr if not used **/
+    bool asyncDump; /** whether the best model is written on a background thread while training goes on **/
+    SnapshotWriter* snapshotWriter; /** writes the snapshots of the best model if asyncDump **/
+    bool isModelDumped; /** whether the best model of early stopping was dumped **/
+    int epochsTrained; /** number of epochs trained so far **/
+
+    // checkpointing
+    int checkpointEveryNEpochs; /** write a checkpoint of the training state every n epochs, 0 disables checkpoints **/
+    Checkpoint* checkpoint; /** checkpoint in <dumpLocation>/checkpoint **/
+    int startEpoch; /** first epoch to train, larger than zero when resuming **/
+
+    bool concurrentEarlyStopping; /** evaluate a copy of the parameters in the background while training goes on **/
+    BackgroundEvaluation* backgroundEvaluation; /** evaluation in the background, created with the first evaluation **/
+    EpochChecker* epochChecker; /** counts the visits of the training triples if checkEpochs is set, else nullptr **/
 
     std::vector<std::vector<Triple> > negatives; /** re-usable data structure for sampled negative triples of a batch **/
     std::vector<Triple*> positives; /** re-usable data structure for positive triples of a batch **/
+    std::vector<Triple*> partialPositives; /** positive triples of a partial batch at the end of an epoch **/
+    std::vector<Triple> batchTriples; /** unpacked positive triples of a batch, positives point into it **/
+
+    // pipelining
+    bool pipelined; /** whether the update of a batch runs concurrently with the gradient computation of the next batch **/
+    std::thread updateThread; /** applies the pending gradients when pipelining **/
+    std::atomic<bool> updating; /** whether the update thread is applying gradients **/
+    long numberOfBatches; /** number of batches of the current epoch **/
+    long staleBatches; /** number of batches of the current epoch whose gradients were computed during an update **/
+    long staleColumns; /** gradient columns of stale batches that are also touched by the update in progress **/
+    long touchedColumns; /** gradient columns of all batches of the current epoch **/
 
     // logging
     std::vector<double> losses;
     std::vector<double> times;
     std::vector<double> mrrs;
+    std::vector<double> gradientCalls; /** number of calls to the model's gradient function per epoch **/
 
     void init() {
         // initialize hyper parameters
@@ -132,7 +234,30 @@ protected:
         useEarlyStopping = config.get<bool>("optimizer.earlyStopping.useEarlyStopping", true);
         earlyStoppingEveryNEpochs = config.get<int>("optimizer.earlyStopping.everyNEpochs", 50);
         earlyStoppingN = config.get<int>("optimizer.earlyStopping.n", 1000);
+        earlyStoppingConfidence = config.get<double>("optimizer.earlyStopping.confidence", 0.0);
+        earlyStoppingBlockSize = config.get<int>("optimizer.earlyStopping.blockSize", 100);
+        if (earlyStoppingConfidence < 0.0 || earlyStoppingConfidence >= 1.0 || earlyStoppingBlockSize < 1) {
+            BOOST_LOG_TRIVIAL(error) << "optimizer.earlyStopping.confidence has to be in [0, 1) and optimizer.earlyStopping.blockSize positive";
+            exit(1);
+        }
+        earlyStoppingTypeConstrained = config.get<bool>("optimizer.earlyStopping.typeConstrained", false);
+        candidateIndex = nullptr;
         earlyStoppingBestValue = 0.0;
+        asyncDump = config.get<bool>("model.serialization.asyncDump", true);
+        snapshotWriter = nullptr;
+        isModelDumped = false;
+        epochsTrained = 0;
+        checkpointEveryNEpochs = config.get<int>("optimizer.checkpoint.everyNEpochs", 0);
+        checkpoint = nullptr;
+        startEpoch = 0;
+        concurrentEarlyStopping = config.get<bool>("optimizer.earlyStopping.concurrent", false);
+        backgroundEvaluation = nullptr;
+        epochChecker = config.get<bool>("checkEpochs", false) ? new EpochChecker(trainData->getNumberOfTriples()) : nullptr;
+        pipelined = config.get<bool>("optimizer.pipelined", false);
+        updating = false;
+        if (pipelined) {
+            model->enablePipelining();
+        }
 
         //  initialize loss function
         lossFunction = LossFunctionFactory::buildLossFunction(model, config);
@@ -144,10 +269,14 @@ protected:
         }
 
         // initialize sampler
-        sampler = SamplerFactory::buildSampler(trainData, config.get_child("optimizer.sampling"));
+        sampler = SamplerFactory::buildSampler(trainData, config.get_child("optimizer.sampling"), model);
+        if (checkpointEveryNEpochs > 0) {
+            checkCheckpointSupport();
+        }
 
         // initialize cache variables
         positives.resize(batchSize);
+        batchTriples.resize(batchSize);
         negatives.resize(batchSize);
         for (int i = 0; i < batchSize; ++i) {
             if (!includePositiveInNegatives) {
@@ -161,39 +290,278 @@ protected:
         losses.resize(maxEpochs);
         times.resize(maxEpochs);
         mrrs.resize(maxEpochs);
+        gradientCalls.resize(maxEpochs);
     }
 
-    virtual void processBatch(std::vector<int> &indices, int start, int end) {
+    /**
+     * Trains one epoch on shuffled mini batches of the given training triples
+     * @param indices indices of the training triples, e.g. all triples, a bucket or the shard of a worker. They are
+     * shuffled in place.
+     */
+    virtual void trainEpoch(std::vector<TripleId> &indices) {
+        // randomly shuffle examples
+        std::shuffle(indices.begin(), indices.end(), RandomUtil::gen);
+        // loop over batches
+        TripleId numberOfBatches = (indices.size() + batchSize - 1) / batchSize;
+        for (TripleId batch = 0; batch < numberOfBatches; ++batch) {
+            processBatch(indices, batch * batchSize, std::min(batch * batchSize + batchSize, (TripleId)indices.size()));
+        }
+        waitForUpdate();
+    }
+
+    /**
+     * Maps a triple of the batch to the columns of the model, after its negatives are sampled with the ids of the data.
+     * Optimizers that hold only a part of the embeddings in the model, e.g. a window of resident entities, override it.
+     * @param triple
+     */
+    virtual void mapTriple(Triple& triple) {}
+
+    /**
+     * Samples the negatives of the positive triples of a batch and maps all triples with mapTriple
+     * @param indices indices of the training triples
+     * @param start index of the first triple of the batch
+     * @param end index after the last triple of the batch
+     * @return the positive triples of the batch
+     */
+    std::vector<Triple*>& buildBatch(std::vector<TripleId> &indices, TripleId start, TripleId end) {
         // reset gradients
         model->resetGradients();
-        // build batch
+        sampler->preBatch();
         for (int pi = 0; pi < end-start; ++pi) {
             // select positive triple
-            Triple& positive = trainData->getTriple(indices[start+pi]);
+            if (epochChecker != nullptr) {
+                epochChecker->visit(indices[start+pi]);
+            }
+            batchTriples[pi] = trainData->getTriple(indices[start+pi]);
+            Triple& positive = batchTriples[pi];
 
             positives[pi] = &positive;
 
-            // sample negative triples
+            // sample negative triples, then map them and the positive one and bring their embeddings up to date
             sampler->sample(positive, negatives[pi].begin());
+            for (int ni = 0; ni < numberOfNegatives; ++ni) {
+                mapTriple(negatives[pi][ni]);
+                model->prepareTriple(negatives[pi][ni]);
+            }
+            mapTriple(positive);
+            model->prepareTriple(positive);
             if (includePositiveInNegatives) {
                 // add the positive one at the last index
                 negatives[pi][numberOfNegatives] = positive;
             }
         }
-        // calculate gradients
-        lossFunction->gradient(positives, negatives);
-        // update parameters
-        model->update();
-        // call post batch hook
-        model->postBatch();
+        if (end - start == batchSize) {
+            return positives;
+        }
+        // the last batch of an epoch can be partial
+        partialPositives.assign(positives.begin(), positives.begin() + (end - start));
+        return partialPositives;
+    }
+
+    virtual void processBatch(std::vector<TripleId> &indices, TripleId start, TripleId end) {
+        std::vector<Triple*>& batchPositives = buildBatch(indices, start, end);
+        // calculate gradients, possibly while the update of the previous batch is running
+        bool stale = updating;
+        lossFunction->gradient(batchPositives, negatives);
+        ++numberOfBatches;
+        if (!pipelined) {
+            long columns = 0;
+            for (auto& gradient: model->getGradients()) {
+                columns += gradient.second.getSize();
+            }
+            touchedColumns += columns;
+            // update parameters
+            model->update();
+            // call post batch hook
+            model->postBatch();
+            return;
+        }
+        if (stale) {
+            ++staleBatches;
+            model->countStaleColumns(staleColumns, touchedColumns);
+        } else {
+            long ignored = 0;
+            model->countStaleColumns(ignored, touchedColumns);
+        }
+        // update parameters and call the post batch hook in the background, at most one batch behind
+        waitForUpdate();
+        model->swapGradients();
+        updating = true;
+        updateThread = std::thread([this]() {
+            model->update();
+            model->postBatch();
+            updating = false;
+        });
+    }
+
+    /**
+     * Records the performance on the validation data after an epoch and dumps the model if it improved
+     * @param epoch index of the evaluated epoch
+     * @param rawMRR
+     * @param filteredMRR
+     * @param isDumped whether the evaluated model is already dumped, i.e. by the background evaluation
+     * @return false if training should stop
+     */
+    bool applyEarlyStopping(int epoch, double rawMRR, double filteredMRR, bool isDumped) {
+        mrrs[epoch] = filteredMRR;
+        // check if score on validation data improves, if not stop training
+        if (filteredMRR > earlyStoppingBestValue) {
+            BOOST_LOG_TRIVIAL(info) << "Early stopping: performance on validation data did improve. Filtered MRR: " << earlyStoppingBestValue << " -> " << filteredMRR << ", raw MRR: " << rawMRR;
+            earlyStoppingBestValue = filteredMRR;
+            // dump so far best performing model
+            if (!isDumped) {
+                dumpBestModel();
+            }
+            isModelDumped = true;
+            return true;
+        }
+        BOOST_LOG_TRIVIAL(info) << "Early stopping: performance on validation data did not improve. Filtered MRR: " << earlyStoppingBestValue << " -> " << filteredMRR << ", raw MRR: " << rawMRR << ". Stop training.";
+        return false;
+    }
+
+    /**
+     * Copies the parameters after an epoch and evaluates them in the background, the result of the previous
+     * evaluation has to be applied
+     * @param evaluation
+     * @param epoch
+     */
+    void startBackgroundEvaluation(Evaluation& evaluation, int epoch) {
+        if (backgroundEvaluation == nullptr) {
+            backgroundEvaluation = new BackgroundEvaluation(buildSnapshotModel(), validData, earlyStoppingN, earlyStoppingConfidence, earlyStoppingBlockSize);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Early stopping: start evaluation on validation data in the background.";
+        model->synchronize();
+        // the seed is drawn here, so the selected validation triples do not depend on the timing of the threads
+        unsigned seed = RandomUtil::gen();
+        backgroundEvaluation->start(model, &evaluation, epoch, earlyStoppingBestValue, model->getDumpLocation(), seed);
+    }
+
+    /**
+     * Builds a second model of the configured type for the copies of the parameters. It only scores triples, so it holds
+     * the parameters without updater state and gradient buffers.
+     * @return
+     */
+    AbstractModel* buildSnapshotModel() {
+        // the initialization of the parameters, which are overwritten anyway, must not change the random numbers of training
+        std::string state = RandomUtil::getState();
+        pt::ptree modelConfig = config.get_child("model");
+        modelConfig.put("scoringOnly", true);
+        std::string modelType = modelConfig.get<std::string>("type");
+        boost::algorithm::to_lower(modelType);
+        AbstractModel* snapshotModel;
+        if (modelType == "ensemble") {
+            snapshotModel = new TrivialEnsemble(trainData, modelConfig);
+            snapshotModel->initParameterUpdater();
+        } else {
+            snapshotModel = ModelFactory::buildModel(trainData, modelConfig);
+        }
+        RandomUtil::setState(state);
+        return snapshotModel;
+    }
+
+    /**
+     * Waits for the evaluation in the background and applies its result
+     * @return false if training should stop
+     */
+    bool applyBackgroundEvaluation() {
+        double rawMRR;
+        double filteredMRR;
+        bool isDumped;
+        int epoch = backgroundEvaluation->wait(rawMRR, filteredMRR, isDumped);
+        return applyEarlyStopping(epoch, rawMRR, filteredMRR, isDumped);
+    }
+
+    /**
+     * Dumps the model that performs best on the validation data so far. With model.serialization.asyncDump the parameters are
+     * copied and written by the snapshot writer, so training only waits for the copy.
+     */
+    void dumpBestModel() {
+        if (!asyncDump) {
+            model->dump(model->getDumpLocation());
+            return;
+        }
+        if (snapshotWriter == nullptr) {
+            snapshotWriter = new SnapshotWriter();
+        }
+        ModelSnapshot* snapshot = new ModelSnapshot();
+        model->takeSnapshot(model->getDumpLocation(), *snapshot);
+        snapshotWriter->write(snapshot);
+    }
+
+    /**
+     * Exits if the training state cannot be checkpointed completely
+     */
+    void checkCheckpointSupport() {
+        // the caches of the cache sampler are not part of the training state
+        std::string samplingStrategy = config.get<std::string>("optimizer.sampling.type", "lcwa");
+        boost::algorithm::to_lower(samplingStrategy);
+        if (samplingStrategy == "cache") {
+            BOOST_LOG_TRIVIAL(error) << "Checkpoints are not supported with the cache sampler";
+            exit(1);
+        }
+    }
+
+    std::string getCheckpointLocation() const {
+        return (fs::path(model->getDumpLocation()) / "checkpoint").string();
+    }
+
+    /**
+     * Writes a checkpoint of the training state after an epoch
+     * @param epochs number of epochs trained
+     */
+    void saveCheckpoint(int epochs) {
+        if (checkpoint == nullptr) {
+            checkpoint = new Checkpoint(getCheckpointLocation());
+        }
+        // a resumed run must not depend on a dump that is still being written
+        if (snapshotWriter != nullptr) {
+            snapshotWriter->wait();
+        }
+        // pending lazy updates are part of the training state, synchronizing would change all columns
+        Message state;
+        state.write<int32_t>(epochs);
+        state.write<int32_t>(epochsTrained);
+        state.write<double>(earlyStoppingBestValue);
+        state.write<uint8_t>(isModelDumped);
+        state.writeString(RandomUtil::getState());
+        for (std::vector<double>* history: {&losses, &times, &mrrs, &gradientCalls}) {
+            state.write<uint64_t>(history->size());
+            state.write(history->data(), epochs);
+        }
+        checkpoint->save(model, state);
+    }
+
+    /**
+     * Waits until the pending gradients are applied
+     */
+    void waitForUpdate() {
+        if (updateThread.joinable()) {
+            updateThread.join();
+        }
     }
 
     virtual void preEpoch() {
         lossFunction->reset();
+        numberOfBatches = 0;
+        staleBatches = 0;
+        staleColumns = 0;
+        touchedColumns = 0;
     }
 
     virtual void postEpoch() {
         lossFunction->printLoss();
+        BOOST_LOG_TRIVIAL(info) << "Gradient calls: " << lossFunction->getNumberOfGradientCalls();
+        if (numberOfBatches > 0) {
+            BOOST_LOG_TRIVIAL(info) << "Staleness: " << staleBatches << " of " << numberOfBatches << " batches computed during the update of the previous batch, "
+                                    << staleColumns << " of " << touchedColumns << " gradient columns (" << 100.0 * staleColumns / std::max(1L, touchedColumns) << "%) touched by that update";
+        }
+    }
+
+    /**
+     * Hook that is called after the last epoch, before the model is dumped
+     */
+    virtual void postTraining() {
+        // do nothing by default
     }
 };
 
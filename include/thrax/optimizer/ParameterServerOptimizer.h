@@ -0,0 +1,270 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_PARAMETERSERVEROPTIMIZER_H
+#define THRAX_PARAMETERSERVEROPTIMIZER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/model/BaseModel.h>
+#include <thrax/parameterServer/GradientCompressor.h>
+#include <thrax/parameterServer/Message.h>
+#include <thrax/parameterServer/ParameterServer.h>
+#include <thrax/parameterServer/SparseGradient.h>
+#include <thrax/parameterServer/TransportFactory.h>
+#include "Optimizer.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Trains a model whose parameters and updater state are sharded by id across parameter servers. For each batch the
+ * trainer pulls the embeddings of the entities and relations of the positive and negative triples, computes the
+ * gradients locally and pushes the touched gradient columns (Gradient::getIdToCol) to the servers, which apply the
+ * update. The local model only holds a window of model.parameterServer.residentEntities entity columns: the entities
+ * of a batch are mapped to the columns of the window in order of their first occurrence.
+ * Gradients are sent as SparseGradient, optionally compressed by a GradientCompressor.
+ */
+class ParameterServerOptimizer: public Optimizer {
+public:
+    ParameterServerOptimizer(Data* trainData, Data* validData, Data* testData, BaseModel* model, pt::ptree config):
+    Optimizer(trainData, validData, testData, model, config),
+    baseModel(model) {
+        initServers();
+    }
+
+protected:
+    static const EntityId GATHER_CHUNK = 1 << 16; /** number of entities pulled per request when gathering the model **/
+
+    BaseModel* baseModel; /** local model with a window of entity columns **/
+    Transport* transport; /** connection to the parameter servers **/
+    int numberOfServers; /** number of parameter servers **/
+    std::vector<std::string> entitySets; /** names of the entity parameter sets, in message order **/
+    std::vector<std::string> relationSets; /** names of the relation parameter sets, in message order **/
+    std::unordered_map<EntityId, EntityId> globalToLocal; /** window column of each entity of the batch **/
+    std::vector<EntityId> localToGlobal; /** entity of each window column in use **/
+    std::vector<RelationId> touchedRelations; /** relations of the batch **/
+    std::vector<bool> isTouched; /** whether a relation is in touchedRelations **/
+    std::vector<Message> requests; /** re-usable request to each server **/
+    Message response; /** re-usable response **/
+    GradientCompressor* compressor; /** compression of the pushed gradients **/
+    size_t pushedBytes; /** size of the push requests of the current epoch **/
+    size_t uncompressedBytes; /** size of the pushed gradients of the current epoch without compression **/
+
+    void initServers() {
+        numberOfServers = baseModel->getNumberOfServers();
+        if (config.get<bool>("model.hyperParameters.lazyL2", false)) {
+            BOOST_LOG_TRIVIAL(error) << "Lazy L2 regularization is not supported with parameter servers";
+            exit(1);
+        }
+        // the servers apply the updates
+        if (pipelined) {
+            BOOST_LOG_TRIVIAL(error) << "Parameter servers do not support optimizer.pipelined";
+            exit(1);
+        }
+        // evaluating on validation data needs all embeddings
+        if (useEarlyStopping) {
+            BOOST_LOG_TRIVIAL(warning) << "Early stopping is not supported with parameter servers and disabled";
+            useEarlyStopping = false;
+        }
+        // each positive and negative triple can add two entities to the window
+        EntityId maxEntities = std::min((EntityId)(2L * batchSize * (numberOfNegatives + 1)), trainData->getNumberOfEntities());
+        if (baseModel->getResidentEntities() < maxEntities) {
+            BOOST_LOG_TRIVIAL(error) << "model.parameterServer.residentEntities has to be at least " << maxEntities << " (2 * batch size * (number of negatives + 1))";
+            exit(1);
+        }
+
+        for (auto& parameter: baseModel->getParameters()) {
+            if (baseModel->getEntityEmbeddings().count(parameter.first) > 0) {
+                entitySets.push_back(parameter.first);
+            } else {
+                relationSets.push_back(parameter.first);
+            }
+        }
+        std::sort(entitySets.begin(), entitySets.end());
+        std::sort(relationSets.begin(), relationSets.end());
+        isTouched.resize(trainData->getNumberOfRelations(), false);
+        requests.resize(numberOfServers);
+        compressor = new GradientCompressor(config.get_child("model.parameterServer.compression", pt::ptree()));
+
+        std::vector<std::string> hosts;
+        pt::ptree noHosts;
+        for (auto& host: config.get_child("model.parameterServer.hosts", noHosts)) {
+            hosts.push_back(host.second.get_value<std::string>());
+        }
+        transport = TransportFactory::buildTransport(config.get<std::string>("model.parameterServer.transport", "tcp"), numberOfServers,
+                ParameterServer::builder(baseModel, trainData->getNumberOfEntities(), config.get_child("model.update")), hosts);
+        BOOST_LOG_TRIVIAL(info) << "Training with " << numberOfServers << " parameter servers, " << baseModel->getResidentEntities() << " resident entities";
+    }
+
+    EntityId toLocal(EntityId entity) {
+        std::unordered_map<EntityId, EntityId>::iterator it = globalToLocal.find(entity);
+        if (it != globalToLocal.end()) {
+            return it->second;
+        }
+        EntityId local = localToGlobal.size();
+        globalToLocal[entity] = local;
+        localToGlobal.push_back(entity);
+        return local;
+    }
+
+    /**
+     * Maps the entities of a triple to the window and records its relation
+     * @param triple
+     */
+    virtual void mapTriple(Triple& triple) override {
+        if (!isTouched[triple.relation]) {
+            isTouched[triple.relation] = true;
+            touchedRelations.push_back(triple.relation);
+        }
+        triple.subject = toLocal(triple.subject);
+        triple.object = toLocal(triple.object);
+    }
+
+    /**
+     * Pulls the embeddings of the entities in localToGlobal into the window and the embeddings of touchedRelations
+     * @param columnOffset column of the first entity of localToGlobal
+     */
+    void pull(EntityId columnOffset) {
+        // group the ids by server
+        std::vector<std::vector<EntityId> > entityColumns(numberOfServers);
+        std::vector<std::vector<int64_t> > entityIds(numberOfServers);
+        std::vector<std::vector<int64_t> > relationIds(numberOfServers);
+        for (EntityId local = 0; local < localToGlobal.size(); ++local) {
+            entityColumns[localToGlobal[local] % numberOfServers].push_back(columnOffset + local);
+            entityIds[localToGlobal[local] % numberOfServers].push_back(localToGlobal[local]);
+        }
+        for (RelationId relation: touchedRelations) {
+            relationIds[relation % numberOfServers].push_back(relation);
+        }
+        for (int s = 0; s < numberOfServers; ++s) {
+            Message& request = requests[s];
+            request.clear();
+            request.write<uint8_t>(ParameterServer::PULL);
+            request.write<uint32_t>(entitySets.size() + relationSets.size());
+            for (auto& name: entitySets) {
+                request.writeString(name);
+                request.write<uint64_t>(entityIds[s].size());
+                request.write(entityIds[s].data(), entityIds[s].size());
+            }
+            for (auto& name: relationSets) {
+                request.writeString(name);
+                request.write<uint64_t>(relationIds[s].size());
+                request.write(relationIds[s].data(), relationIds[s].size());
+            }
+            transport->send(s, request);
+        }
+        for (int s = 0; s < numberOfServers; ++s) {
+            transport->receive(s, response);
+            for (auto& name: entitySets) {
+                EmbeddingParameterSet& embeddings = baseModel->getParameter(name);
+                for (EntityId column: entityColumns[s]) {
+                    response.read(embeddings.col(column).data(), embeddings.rows());
+                }
+            }
+            for (auto& name: relationSets) {
+                EmbeddingParameterSet& embeddings = baseModel->getParameter(name);
+                for (int64_t relation: relationIds[s]) {
+                    response.read(embeddings.col(relation).data(), embeddings.rows());
+                }
+            }
+        }
+    }
+
+    /**
+     * Pushes the touched gradient columns of the batch with their regularization to the servers
+     */
+    void push() {
+        RegularizationMap regularization = baseModel->takeRegularization();
+        for (int s = 0; s < numberOfServers; ++s) {
+            requests[s].clear();
+            requests[s].write<uint8_t>(ParameterServer::PUSH);
+            requests[s].write<uint32_t>(entitySets.size() + relationSets.size());
+        }
+        for (int set = 0; set < entitySets.size() + relationSets.size(); ++set) {
+            bool isEntitySet = set < entitySets.size();
+            const std::string& name = isEntitySet ? entitySets[set] : relationSets[set - entitySets.size()];
+            SparseGradient gradient = isEntitySet ? SparseGradient::fromGradient(baseModel->getGradient(name), localToGlobal)
+                                                  : SparseGradient::fromGradient(baseModel->getGradient(name));
+            uncompressedBytes += gradient.getEncodedSize(false);
+            compressor->compress(name, gradient);
+            const Regularization& setRegularization = regularization.at(name);
+            for (int s = 0; s < numberOfServers; ++s) {
+                Message& request = requests[s];
+                request.writeString(name);
+                request.write<double>(setRegularization.lambda);
+                request.write<uint8_t>(setRegularization.normalize);
+                gradient.selectShard(s, numberOfServers).encode(request, compressor->isHalf());
+            }
+        }
+        for (int s = 0; s < numberOfServers; ++s) {
+            pushedBytes += requests[s].size();
+            transport->send(s, requests[s]);
+        }
+        for (int s = 0; s < numberOfServers; ++s) {
+            transport->receive(s, response);
+        }
+    }
+
+    virtual void preEpoch() override {
+        Optimizer::preEpoch();
+        pushedBytes = 0;
+        uncompressedBytes = 0;
+    }
+
+    virtual void postEpoch() override {
+        Optimizer::postEpoch();
+        BOOST_LOG_TRIVIAL(info) << "Pushed " << pushedBytes / 1024 << " KiB of gradients, " << uncompressedBytes / 1024 << " KiB uncompressed";
+    }
+
+    virtual void processBatch(std::vector<TripleId> &indices, TripleId start, TripleId end) override {
+        globalToLocal.clear();
+        localToGlobal.clear();
+        for (RelationId relation: touchedRelations) {
+            isTouched[relation] = false;
+        }
+        touchedRelations.clear();
+        std::vector<Triple*>& batchPositives = buildBatch(indices, start, end);
+        pull(0);
+        // calculate gradients
+        lossFunction->gradient(batchPositives, negatives);
+        // the servers update the parameters
+        push();
+    }
+
+    /**
+     * Gathers all embeddings from the servers into the model for evaluation and dumping, then stops the servers
+     */
+    virtual void postTraining() override {
+        EntityId numberOfEntities = trainData->getNumberOfEntities();
+        for (auto& name: entitySets) {
+            EmbeddingParameterSet& embeddings = baseModel->getParameter(name);
+            embeddings.resize(embeddings.rows(), numberOfEntities);
+        }
+        touchedRelations.clear();
+        for (RelationId relation = 0; relation < trainData->getNumberOfRelations(); ++relation) {
+            touchedRelations.push_back(relation);
+        }
+        for (EntityId first = 0; first < numberOfEntities || first == 0; first += GATHER_CHUNK) {
+            localToGlobal.clear();
+            for (EntityId entity = first; entity < std::min(first + GATHER_CHUNK, numberOfEntities); ++entity) {
+                localToGlobal.push_back(entity);
+            }
+            pull(first);
+            // relations are pulled with the first chunk
+            touchedRelations.clear();
+        }
+        transport->shutdown();
+        delete transport;
+        delete compressor;
+        BOOST_LOG_TRIVIAL(info) << "Gathered the parameters of " << numberOfServers << " parameter servers";
+    }
+};
+
+
+#endif //THRAX_PARAMETERSERVEROPTIMIZER_H
@@ -0,0 +1,309 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_PARTITIONEDOPTIMIZER_H
+#define THRAX_PARTITIONEDOPTIMIZER_H
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/model/BaseModel.h>
+#include <thrax/model/ModelSnapshot.h>
+#include <thrax/sampler/PartitionSampler.h>
+#include <thrax/util/FileUtil.h>
+#include "Optimizer.h"
+
+namespace pt = boost::property_tree;
+namespace fs = boost::filesystem;
+
+/**
+ * Out-of-core training for models whose entity embeddings do not fit into memory. Entities are split into P partitions
+ * of consecutive ids and triples into P x P buckets by the partitions of their subject and object. Each epoch iterates
+ * over the buckets, while only the entity embeddings (and their updater state) of the subject and the object partition
+ * of the active bucket are resident in two slots of the model. The other partitions are kept in binary files and
+ * swapped in and out when a slot changes its partition. Buckets are visited row by row in alternating column order, so
+ * consecutive buckets share a resident partition.
+ * Triples are mapped to local ids before they are passed to the model: the column of an entity in the resident window
+ * is its offset in its partition, plus the partition size if its partition is resident in the second slot.
+ * After training, the model is dumped partition by partition from the partition files. Only with
+ * model.partitioning.evaluate the entity embeddings of all partitions are gathered into memory for evaluation.
+ */
+class PartitionedOptimizer: public Optimizer {
+public:
+    PartitionedOptimizer(Data* trainData, Data* validData, Data* testData, BaseModel* model, pt::ptree config):
+    Optimizer(trainData, validData, testData, model, config),
+    baseModel(model) {
+        initPartitions();
+    }
+
+protected:
+    BaseModel* baseModel; /** the model, with the entity embeddings of two partitions resident **/
+    PartitionSampler* partitionSampler; /** sampler of negatives within the resident partitions **/
+    int numberOfPartitions; /** number of entity partitions **/
+    EntityId partitionSize; /** number of entities per partition **/
+    fs::path directory; /** directory of the partition files **/
+    std::vector<std::vector<TripleId> > buckets; /** indices of the triples of each bucket (subject partition * P + object partition) **/
+    int residentPartitions[2]; /** partition resident in each slot of the model, -1 if the slot is empty **/
+    bool evaluate; /** whether the entity embeddings are gathered after training for evaluation **/
+
+    void initPartitions() {
+        numberOfPartitions = baseModel->getNumberOfPartitions();
+        partitionSize = baseModel->getPartitionSize();
+        std::string location = config.get<std::string>("model.partitioning.directory", "auto");
+        directory = location == "auto" ? fs::path(model->getDumpLocation()) / "partitions" : fs::path(location);
+        fs::create_directories(directory);
+        BOOST_LOG_TRIVIAL(info) << "Partitioned training with " << numberOfPartitions << " partitions of " << partitionSize << " entities in " << directory.string();
+
+        // partitions are swapped between batches, no update may be in progress
+        if (pipelined) {
+            BOOST_LOG_TRIVIAL(error) << "Partitioned training does not support optimizer.pipelined";
+            exit(1);
+        }
+        // evaluating on validation data needs all partitions
+        if (useEarlyStopping) {
+            BOOST_LOG_TRIVIAL(warning) << "Early stopping is not supported by partitioned training and disabled";
+            useEarlyStopping = false;
+        }
+
+        // negatives are sampled from the resident partitions
+        if (config.get<std::string>("optimizer.sampling.type", "lcwa") != "lcwa") {
+            BOOST_LOG_TRIVIAL(warning) << "Partitioned training samples negatives of the resident partitions, optimizer.sampling.type is ignored";
+        }
+        delete sampler;
+        partitionSampler = new PartitionSampler(trainData, config.get_child("optimizer.sampling"), partitionSize);
+        sampler = partitionSampler;
+
+        // bucket the triples
+        buckets.resize(numberOfPartitions * numberOfPartitions);
+        for (TripleId i = 0; i < trainData->getNumberOfTriples(); ++i) {
+            Triple triple = trainData->getTriple(i);
+            buckets[partitionOf(triple.subject) * numberOfPartitions + partitionOf(triple.object)].push_back(i);
+        }
+
+        // write the initial state of every partition: initialized embeddings, the state as initialized in the first slot
+        std::map<std::string, EmbeddingParameterSet*> matrices = baseModel->getEntityMatrices();
+        const ParameterMap& parameters = baseModel->getParameters();
+        for (int partition = 0; partition < numberOfPartitions; ++partition) {
+            for (auto& matrix: matrices) {
+                if (parameters.count(matrix.first) > 0) {
+                    EmbeddingParameterSet embeddings(matrix.second->getEmbeddingDimension(), partitionSize);
+                    baseModel->initializeParameterSlice(matrix.first, embeddings, (long)partition * partitionSize, 1);
+                    FileUtil::dumpBinaryColumns(partitionPath(matrix.first, partition), embeddings, 0, partitionSize);
+                } else {
+                    FileUtil::dumpBinaryColumns(partitionPath(matrix.first, partition), *matrix.second, 0, partitionSize);
+                }
+            }
+        }
+        residentPartitions[0] = -1;
+        residentPartitions[1] = -1;
+
+        long residentBytes = 0;
+        for (auto& matrix: matrices) {
+            residentBytes += matrix.second->size() * sizeof(double);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Resident entity embeddings and state: " << residentBytes / 1024 << " KiB";
+
+        // fail before training if the embeddings of all entities can not be gathered for evaluation
+        evaluate = config.get<bool>("model.partitioning.evaluate", true);
+        long gatheredBytes = 0;
+        for (auto& name: gatheredMatrices()) {
+            gatheredBytes += matrices.at(name)->rows() * (long)trainData->getNumberOfEntities() * sizeof(double);
+        }
+        long memoryBytes = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+        if (evaluate && memoryBytes > 0 && gatheredBytes > memoryBytes) {
+            BOOST_LOG_TRIVIAL(error) << "Evaluation needs the entity embeddings of all partitions, " << gatheredBytes / (1024 * 1024) << " MiB, but the machine has "
+                                     << memoryBytes / (1024 * 1024) << " MiB of memory. Set model.partitioning.evaluate to false to only dump the model";
+            exit(1);
+        }
+    }
+
+    /**
+     * Names of the entity matrices that are gathered after training: the embeddings and the lazy L2 timestamps, which
+     * are needed to apply the pending decay, but not the updater state
+     * @return
+     */
+    std::vector<std::string> gatheredMatrices() {
+        std::vector<std::string> names;
+        for (auto& matrix: baseModel->getEntityMatrices()) {
+            if (baseModel->getEntityEmbeddings().count(matrix.first) > 0 || boost::algorithm::ends_with(matrix.first, ".decay")) {
+                names.push_back(matrix.first);
+            }
+        }
+        return names;
+    }
+
+    int partitionOf(EntityId entity) const {
+        return entity / partitionSize;
+    }
+
+    std::string partitionPath(const std::string& name, int partition) const {
+        return (directory / (name + "-" + std::to_string(partition) + ".bin")).string();
+    }
+
+    /**
+     * Writes the partition of a slot to its files and empties the slot
+     * @param slot
+     */
+    void evict(int slot) {
+        if (residentPartitions[slot] == -1) {
+            return;
+        }
+        for (auto& matrix: baseModel->getEntityMatrices()) {
+            FileUtil::dumpBinaryColumns(partitionPath(matrix.first, residentPartitions[slot]), *matrix.second, slot * partitionSize, partitionSize);
+        }
+        residentPartitions[slot] = -1;
+    }
+
+    /**
+     * Makes a partition resident in a slot, swapping out the partition that was resident before
+     * @param slot
+     * @param partition
+     */
+    void load(int slot, int partition) {
+        if (residentPartitions[slot] == partition) {
+            return;
+        }
+        // a partition is resident in one slot only
+        if (residentPartitions[1 - slot] == partition) {
+            evict(1 - slot);
+        }
+        evict(slot);
+        for (auto& matrix: baseModel->getEntityMatrices()) {
+            FileUtil::loadBinaryColumns(partitionPath(matrix.first, partition), *matrix.second, slot * partitionSize, partitionSize);
+        }
+        residentPartitions[slot] = partition;
+    }
+
+    /**
+     * Maps a triple to the columns of the resident window
+     * @param triple
+     */
+    virtual void mapTriple(Triple& triple) override {
+        triple.subject = toLocal(triple.subject);
+        triple.object = toLocal(triple.object);
+    }
+
+    EntityId toLocal(EntityId entity) const {
+        return entity % partitionSize + (residentPartitions[0] == partitionOf(entity) ? 0 : partitionSize);
+    }
+
+    /**
+     * Trains on all buckets, on shuffled mini batches within each bucket. The indices of all triples are not used, the
+     * triples are taken from the buckets.
+     */
+    virtual void trainEpoch(std::vector<TripleId> &) override {
+        for (int subjectPartition = 0; subjectPartition < numberOfPartitions; ++subjectPartition) {
+            for (int column = 0; column < numberOfPartitions; ++column) {
+                int objectPartition = subjectPartition % 2 == 0 ? column : numberOfPartitions - 1 - column;
+                std::vector<TripleId>& bucket = buckets[subjectPartition * numberOfPartitions + objectPartition];
+                if (bucket.empty()) {
+                    continue;
+                }
+                load(0, subjectPartition);
+                if (objectPartition != subjectPartition) {
+                    load(1, objectPartition);
+                }
+                partitionSampler->setBucket(subjectPartition, objectPartition);
+                Optimizer::trainEpoch(bucket);
+            }
+        }
+    }
+
+    /**
+     * Dumps the model partition by partition, so at most two partitions are in memory
+     */
+    void dumpPartitions() {
+        std::string location = model->getDumpLocation();
+        // the relations and other parameters that are not partitioned, with the mappings
+        baseModel->synchronize();
+        ModelSnapshot snapshot;
+        snapshot.addModel(location, trainData);
+        for (auto& parameter: baseModel->getParameters()) {
+            if (baseModel->getEntityEmbeddings().count(parameter.first) == 0) {
+                snapshot.addParameter(location, parameter.first, parameter.second);
+            }
+        }
+        snapshot.write();
+
+        // the entity embeddings, with the pending lazy L2 decay applied in the resident window
+        std::map<std::string, std::ofstream> files;
+        for (auto& name: baseModel->getEntityEmbeddings()) {
+            std::string path = (fs::path(location) / "parameters" / name).string();
+            files[name].open(path);
+            if (!files[name].is_open()) {
+                BOOST_LOG_TRIVIAL(error) << "Could not open file " << path << " to dump matrix";
+                exit(1);
+            }
+        }
+        EntityId numberOfEntities = trainData->getNumberOfEntities();
+        for (int partition = 0; partition < numberOfPartitions; ++partition) {
+            EntityId first = partition * partitionSize;
+            EntityId n = std::min(partitionSize, numberOfEntities - first);
+            if (n <= 0) {
+                continue;
+            }
+            load(0, partition);
+            baseModel->synchronize();
+            for (auto& file: files) {
+                if (partition > 0) {
+                    file.second << "\n";
+                }
+                FileUtil::dumpMatrix(file.second, baseModel->getParameter(file.first).leftCols(n));
+            }
+        }
+        evict(0);
+        isModelDumped = true;
+    }
+
+    /**
+     * Dumps the model from the partition files. With model.partitioning.evaluate, the entity embeddings of all
+     * partitions are then gathered into the model for evaluation. The updater state is not needed after training, so
+     * it is released instead of gathered.
+     */
+    virtual void postTraining() override {
+        evict(0);
+        evict(1);
+        dumpPartitions();
+        if (!evaluate) {
+            fs::remove_all(directory);
+            BOOST_LOG_TRIVIAL(info) << "Dumped the entity embeddings of " << numberOfPartitions << " partitions";
+            return;
+        }
+        std::map<std::string, EmbeddingParameterSet*> matrices = baseModel->getEntityMatrices();
+        std::vector<std::string> gathered = gatheredMatrices();
+        for (auto& matrix: matrices) {
+            if (std::find(gathered.begin(), gathered.end(), matrix.first) == gathered.end()) {
+                matrix.second->resize(matrix.second->rows(), 0);
+            }
+        }
+        EntityId numberOfEntities = trainData->getNumberOfEntities();
+        for (auto& name: gathered) {
+            EmbeddingParameterSet* matrix = matrices.at(name);
+            matrix->resize(matrix->rows(), numberOfEntities);
+            for (int partition = 0; partition < numberOfPartitions; ++partition) {
+                EntityId first = partition * partitionSize;
+                EntityId n = std::min(partitionSize, numberOfEntities - first);
+                if (n > 0) {
+                    FileUtil::loadBinaryColumns(partitionPath(name, partition), *matrix, first, n);
+                }
+            }
+        }
+        fs::remove_all(directory);
+        BOOST_LOG_TRIVIAL(info) << "Gathered the entity embeddings of " << numberOfPartitions << " partitions";
+    }
+
+    virtual bool isModelComplete() const override {
+        return evaluate;
+    }
+};
+
+
+#endif //THRAX_PARTITIONEDOPTIMIZER_H
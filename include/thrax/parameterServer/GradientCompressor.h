@@ -0,0 +1,81 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_GRADIENTCOMPRESSOR_H
+#define THRAX_GRADIENTCOMPRESSOR_H
+
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <boost/log/trivial.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "SparseGradient.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Lossy compression of the sparse gradients a trainer sends: top-k sparsification keeps the columns with the largest
+ * norm, float16 halves the size of the values again. With error feedback, the part of the gradient that was not sent
+ * (dropped columns and rounding errors) is kept per parameter set and added to the next gradient of that set, so no
+ * gradient is lost, only delayed. Dropped columns keep their counts, so L2 regularization is applied when they are sent.
+ */
+class GradientCompressor {
+public:
+    GradientCompressor(pt::ptree config) {
+        std::string precision = config.get<std::string>("precision", "double");
+        if (precision != "double" && precision != "float16") {
+            BOOST_LOG_TRIVIAL(error) << "Gradient precision " << precision << " not implemented, use double or float16";
+            exit(1);
+        }
+        half = precision == "float16";
+        topK = config.get<double>("topK", 1.0);
+        errorFeedback = config.get<bool>("errorFeedback", true);
+        if (topK <= 0.0 || topK > 1.0) {
+            BOOST_LOG_TRIVIAL(error) << "Gradient compression topK has to be in (0, 1], found " << topK;
+            exit(1);
+        }
+    }
+
+    /**
+     * Compresses the gradient of a parameter set in place
+     * @param name name of the parameter set, residuals are kept per set
+     * @param gradient
+     */
+    void compress(const std::string& name, SparseGradient& gradient) {
+        if (!half && topK >= 1.0) {
+            return;
+        }
+        long n = std::ceil(topK * gradient.size());
+        SparseGradient& residual = residuals.emplace(name, SparseGradient(gradient.getDimension())).first->second;
+        if (errorFeedback && residual.size() > 0) {
+            gradient = SparseGradient::aggregate({&gradient, &residual});
+        }
+        SparseGradient dropped;
+        gradient.selectTopK(n, dropped);
+        if (half) {
+            SparseGradient error = gradient;
+            gradient.roundToHalf();
+            error.getValues() -= gradient.getValues();
+            error.clearCounts();
+            dropped = SparseGradient::aggregate({&dropped, &error});
+        }
+        if (errorFeedback) {
+            residual = dropped;
+        }
+    }
+
+    bool isHalf() const {
+        return half;
+    }
+
+private:
+    bool half; /** send the values as float16 **/
+    double topK; /** fraction of the columns of a gradient to send **/
+    bool errorFeedback; /** add the part that was not sent to the next gradient **/
+    std::unordered_map<std::string, SparseGradient> residuals; /** part of the gradient not sent yet, by parameter set name **/
+};
+
+
+#endif //THRAX_GRADIENTCOMPRESSOR_H
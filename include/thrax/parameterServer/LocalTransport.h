@@ -0,0 +1,51 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_LOCALTRANSPORT_H
+#define THRAX_LOCALTRANSPORT_H
+
+#include <vector>
+
+#include "Transport.h"
+
+/**
+ * Runs the servers in the trainer process, a request is handled as soon as it is sent. Messages are serialized as
+ * with any other transport, which makes it useful to debug the protocol.
+ */
+class LocalTransport: public Transport {
+public:
+    LocalTransport(int numberOfServers, ServerBuilder build): Transport(numberOfServers), responses(numberOfServers) {
+        for (int i = 0; i < numberOfServers; ++i) {
+            servers.push_back(build(i));
+        }
+    }
+
+    virtual ~LocalTransport() {
+        shutdown();
+    }
+
+    virtual void send(int server, Message& request) override {
+        responses[server].clear();
+        servers[server]->handle(request, responses[server]);
+    }
+
+    virtual void receive(int server, Message& response) override {
+        response = responses[server];
+        response.rewind();
+    }
+
+    virtual void shutdown() override {
+        for (ParameterServer* server: servers) {
+            delete server;
+        }
+        servers.clear();
+    }
+
+private:
+    std::vector<ParameterServer*> servers;
+    std::vector<Message> responses; /** response to the last request of each server **/
+};
+
+
+#endif //THRAX_LOCALTRANSPORT_H
@@ -0,0 +1,110 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_MESSAGE_H
+#define THRAX_MESSAGE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/log/trivial.hpp>
+
+/**
+ * Byte buffer of a request or response between trainers and parameter servers. Values are appended by write and
+ * consumed in the same order by read. Values are stored in the byte order of the machine.
+ */
+class Message {
+public:
+    Message(): position(0) {}
+
+    /**
+     * Appends a value
+     * @param value
+     */
+    template <typename T>
+    void write(const T& value) {
+        write(&value, 1);
+    }
+
+    /**
+     * Appends an array of values
+     * @param values
+     * @param n number of values
+     */
+    template <typename T>
+    void write(const T* values, size_t n) {
+        const char* bytes = reinterpret_cast<const char*>(values);
+        buffer.insert(buffer.end(), bytes, bytes + n * sizeof(T));
+    }
+
+    void writeString(const std::string& value) {
+        write<uint64_t>(value.size());
+        write(value.data(), value.size());
+    }
+
+    /**
+     * Consumes the next value
+     * @return
+     */
+    template <typename T>
+    T read() {
+        T value;
+        read(&value, 1);
+        return value;
+    }
+
+    /**
+     * Consumes the next n values
+     * @param values
+     * @param n
+     */
+    template <typename T>
+    void read(T* values, size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (position + bytes > buffer.size()) {
+            BOOST_LOG_TRIVIAL(error) << "Malformed message: read of " << bytes << " bytes at " << position << " exceeds size " << buffer.size();
+            exit(1);
+        }
+        std::memcpy(values, buffer.data() + position, bytes);
+        position += bytes;
+    }
+
+    std::string readString() {
+        std::string value(read<uint64_t>(), '\0');
+        read(&value[0], value.size());
+        return value;
+    }
+
+    /**
+     * Removes all values
+     */
+    void clear() {
+        buffer.clear();
+        position = 0;
+    }
+
+    /**
+     * Reads from the start again
+     */
+    void rewind() {
+        position = 0;
+    }
+
+    std::vector<char>& getBuffer() {
+        return buffer;
+    }
+
+    size_t size() const {
+        return buffer.size();
+    }
+
+private:
+    std::vector<char> buffer; /** serialized values **/
+    size_t position; /** read position **/
+};
+
+
+#endif //THRAX_MESSAGE_H
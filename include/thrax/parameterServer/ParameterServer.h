@@ -0,0 +1,173 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_PARAMETERSERVER_H
+#define THRAX_PARAMETERSERVER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <boost/log/trivial.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/model/BaseModel.h>
+#include <thrax/parameterUpdater/ParameterUpdater.h>
+#include <thrax/parameterUpdater/ParameterUpdaterFactory.h>
+#include <thrax/struct/Gradient.h>
+#include <thrax/util/Typedefs.h>
+#include "Message.h"
+#include "SparseGradient.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Holds one shard of the parameters of a model: of every parameter set the embeddings with id % numberOfShards == shard,
+ * stored in column id / numberOfShards, together with their updater state.
+ * Trainers pull the embeddings touched by a batch and push their sparse gradients, which the server applies with its
+ * own parameter updater in the fused pass (L2 regularization, update and normalization).
+ *
+ * Requests start with the request type:
+ *  PULL: number of sets, then for each set its name, the number of ids n and the ids.
+ *        The response holds k x n values per set in request order.
+ *  PUSH: number of sets, then for each set its name, the scaled L2 lambda, whether to normalize and the gradient of
+ *        the set as encoded by SparseGradient. The response is empty.
+ *  SHUTDOWN: no response.
+ */
+class ParameterServer {
+public:
+    enum RequestType: uint8_t {
+        PULL = 1,
+        PUSH = 2,
+        SHUTDOWN = 3
+    };
+
+    /**
+     * Builds the shard of the parameters of a model, initialized by the initializer of the model
+     * @param shard
+     * @param numberOfShards
+     * @param model local model of the trainer, used for the names, sizes and the initialization of the parameter sets
+     * @param numberOfEntities
+     * @param updaterConfig hyper parameters of the parameter updater
+     */
+    ParameterServer(int shard, int numberOfShards, BaseModel* model, EntityId numberOfEntities, pt::ptree updaterConfig):
+    shard(shard),
+    numberOfShards(numberOfShards) {
+        for (auto& parameter: model->getParameters()) {
+            const std::string& name = parameter.first;
+            long k = parameter.second.getEmbeddingDimension();
+            long m = model->getEntityEmbeddings().count(name) > 0 ? numberOfEntities : parameter.second.getNumberOfEmbeddings();
+            long n = m > shard ? (m - shard + numberOfShards - 1) / numberOfShards : 0;
+            parameters.insert({name, EmbeddingParameterSet(k, n)});
+            EmbeddingParameterSet& embeddings = parameters.at(name);
+            model->initializeParameterSlice(name, embeddings, shard, numberOfShards);
+            gradients.insert({name, Gradient(&embeddings)});
+        }
+        updater = ParameterUpdaterFactory::buildParameterUpdater(parameters, updaterConfig);
+    }
+
+    /**
+     * Builds the servers of the shards of a model, both in the trainer and in a process started with --parameter-server
+     * @param model local model, see the constructor
+     * @param numberOfEntities
+     * @param updaterConfig
+     * @return function that builds the server of a shard
+     */
+    static std::function<ParameterServer*(int)> builder(BaseModel* model, EntityId numberOfEntities, pt::ptree updaterConfig) {
+        int numberOfShards = model->getNumberOfServers();
+        return [=](int shard) { return new ParameterServer(shard, numberOfShards, model, numberOfEntities, updaterConfig); };
+    }
+
+    ~ParameterServer() {
+        delete updater;
+    }
+
+    /**
+     * Handles a request
+     * @param request
+     * @param response
+     * @return false if the server should stop
+     */
+    bool handle(Message& request, Message& response) {
+        request.rewind();
+        uint8_t type = request.read<uint8_t>();
+        if (type == PULL) {
+            pull(request, response);
+        } else if (type == PUSH) {
+            push(request);
+        } else if (type == SHUTDOWN) {
+            return false;
+        } else {
+            BOOST_LOG_TRIVIAL(error) << "Parameter server " << shard << " received unknown request type " << (int)type;
+            exit(1);
+        }
+        return true;
+    }
+
+private:
+    int shard; /** index of this server **/
+    int numberOfShards; /** number of servers **/
+    ParameterMap parameters; /** shard of each parameter set **/
+    GradientMap gradients; /** re-usable gradients of pushed batches **/
+    ParameterUpdater* updater; /** updater of the shard, holds its state **/
+    std::vector<int64_t> ids; /** re-usable buffer of the ids of a set in a request **/
+
+    /**
+     * Reads the ids of a set and checks that they belong to this shard
+     * @param request
+     * @param embeddings
+     */
+    void readIds(Message& request, const EmbeddingParameterSet& embeddings) {
+        ids.resize(request.read<uint64_t>());
+        request.read(ids.data(), ids.size());
+        checkIds(ids, embeddings);
+    }
+
+    void checkIds(const std::vector<int64_t>& ids, const EmbeddingParameterSet& embeddings) const {
+        for (int64_t id: ids) {
+            if (id % numberOfShards != shard || id / numberOfShards >= embeddings.getNumberOfEmbeddings()) {
+                BOOST_LOG_TRIVIAL(error) << "Parameter server " << shard << " does not hold embedding " << id;
+                exit(1);
+            }
+        }
+    }
+
+    void pull(Message& request, Message& response) {
+        uint32_t numberOfSets = request.read<uint32_t>();
+        for (uint32_t s = 0; s < numberOfSets; ++s) {
+            EmbeddingParameterSet& embeddings = parameters.at(request.readString());
+            readIds(request, embeddings);
+            for (int64_t id: ids) {
+                response.write(embeddings.col(id / numberOfShards).data(), embeddings.rows());
+            }
+        }
+    }
+
+    void push(Message& request) {
+        for (auto& gradient: gradients) {
+            gradient.second.reset();
+        }
+        RegularizationMap regularization;
+        uint32_t numberOfSets = request.read<uint32_t>();
+        for (uint32_t s = 0; s < numberOfSets; ++s) {
+            std::string name = request.readString();
+            EmbeddingParameterSet& embeddings = parameters.at(name);
+            Gradient& gradient = gradients.at(name);
+            regularization[name].lambda = request.read<double>();
+            regularization[name].normalize = request.read<uint8_t>() != 0;
+            SparseGradient sparse(embeddings.rows());
+            sparse.decode(request);
+            checkIds(sparse.getIds(), embeddings);
+            for (long i = 0; i < sparse.size(); ++i) {
+                gradient.add(sparse.getIds()[i] / numberOfShards, sparse.getValues().col(i), sparse.getCounts()[i]);
+            }
+        }
+        updater->update(gradients, parameters, regularization);
+    }
+};
+
+
+#endif //THRAX_PARAMETERSERVER_H
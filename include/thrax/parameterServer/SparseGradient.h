@@ -0,0 +1,268 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_SPARSEGRADIENT_H
+#define THRAX_SPARSEGRADIENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include <Eigen/Dense>
+
+#include <thrax/struct/Gradient.h>
+#include "Message.h"
+
+using namespace Eigen;
+
+/**
+ * Exchange format of the gradient of one parameter set: the touched ids in ascending order, how often each id was used
+ * in the batch and one gradient column per id. Columns of several workers are merged by aggregate, the encoding can
+ * store the values as float16.
+ */
+class SparseGradient {
+public:
+    SparseGradient(long k = 0): values(k, 0) {}
+
+    /**
+     * Collects the touched columns of a gradient
+     * @param gradient
+     * @return
+     */
+    static SparseGradient fromGradient(Gradient& gradient) {
+        return fromGradient(gradient, std::vector<int64_t>());
+    }
+
+    /**
+     * Collects the touched columns of a gradient
+     * @param gradient
+     * @param localToGlobal maps the ids of the gradient to global ids, if not empty
+     * @return
+     */
+    template <typename Id>
+    static SparseGradient fromGradient(Gradient& gradient, const std::vector<Id>& localToGlobal) {
+        std::vector<std::pair<int64_t, int> > columns;
+        for (auto& ptr: gradient.getIdToCol()) {
+            columns.push_back(std::make_pair(localToGlobal.empty() ? (int64_t)ptr.first : (int64_t)localToGlobal[ptr.first], ptr.second));
+        }
+        std::sort(columns.begin(), columns.end());
+        SparseGradient sparse(gradient.getEmbeddingDimension());
+        sparse.resize(columns.size());
+        for (size_t i = 0; i < columns.size(); ++i) {
+            sparse.ids[i] = columns[i].first;
+            sparse.counts[i] = gradient.getCount(columns[i].second);
+            sparse.values.col(i) = gradient.col(columns[i].second);
+        }
+        return sparse;
+    }
+
+    /**
+     * Get the columns of the ids that belong to a shard, i.e. id % numberOfShards == shard
+     * @param shard
+     * @param numberOfShards
+     * @return
+     */
+    SparseGradient selectShard(int shard, int numberOfShards) const {
+        SparseGradient selected(getDimension());
+        selected.resize(size());
+        long n = 0;
+        for (long i = 0; i < size(); ++i) {
+            if (ids[i] % numberOfShards == shard) {
+                selected.ids[n] = ids[i];
+                selected.counts[n] = counts[i];
+                selected.values.col(n) = values.col(i);
+                ++n;
+            }
+        }
+        selected.resize(n);
+        return selected;
+    }
+
+    /**
+     * Merges the gradients of several workers, the values and counts of the same id are summed up
+     * @param gradients
+     * @return
+     */
+    static SparseGradient aggregate(const std::vector<const SparseGradient*>& gradients) {
+        SparseGradient merged(gradients.empty() ? 0 : gradients[0]->getDimension());
+        // k-way merge of the sorted id lists
+        std::vector<size_t> positions(gradients.size(), 0);
+        size_t total = 0;
+        for (auto gradient: gradients) {
+            total += gradient->size();
+        }
+        merged.ids.reserve(total);
+        merged.counts.reserve(total);
+        merged.values.resize(merged.getDimension(), total);
+        long n = 0;
+        while (true) {
+            int64_t next = INT64_MAX;
+            for (size_t w = 0; w < gradients.size(); ++w) {
+                if (positions[w] < gradients[w]->size()) {
+                    next = std::min(next, gradients[w]->ids[positions[w]]);
+                }
+            }
+            if (next == INT64_MAX) {
+                break;
+            }
+            merged.ids.push_back(next);
+            merged.counts.push_back(0);
+            merged.values.col(n).setZero();
+            for (size_t w = 0; w < gradients.size(); ++w) {
+                if (positions[w] < gradients[w]->size() && gradients[w]->ids[positions[w]] == next) {
+                    merged.counts[n] += gradients[w]->counts[positions[w]];
+                    merged.values.col(n) += gradients[w]->values.col(positions[w]);
+                    ++positions[w];
+                }
+            }
+            ++n;
+        }
+        merged.values.conservativeResize(merged.getDimension(), n);
+        return merged;
+    }
+
+    /**
+     * Keeps the columns with the largest L2 norm
+     * @param n number of columns to keep
+     * @param dropped receives the other columns, e.g. as residual for error feedback
+     */
+    void selectTopK(long n, SparseGradient& dropped) {
+        dropped = SparseGradient(getDimension());
+        if (n >= size()) {
+            return;
+        }
+        std::vector<long> order(size());
+        std::iota(order.begin(), order.end(), 0);
+        VectorXd norms = values.colwise().squaredNorm().transpose();
+        std::nth_element(order.begin(), order.begin() + n, order.end(), [&norms](long a, long b) {
+            return norms(a) > norms(b);
+        });
+        std::vector<bool> keep(size(), false);
+        for (long i = 0; i < n; ++i) {
+            keep[order[i]] = true;
+        }
+        SparseGradient kept(getDimension());
+        kept.resize(n);
+        dropped.resize(size() - n);
+        long k = 0;
+        long d = 0;
+        for (long i = 0; i < size(); ++i) {
+            SparseGradient& target = keep[i] ? kept : dropped;
+            long& j = keep[i] ? k : d;
+            target.ids[j] = ids[i];
+            target.counts[j] = counts[i];
+            target.values.col(j) = values.col(i);
+            ++j;
+        }
+        *this = kept;
+    }
+
+    /**
+     * Rounds the values to float16, as they are after encoding them in half precision
+     */
+    void roundToHalf() {
+        for (long i = 0; i < values.size(); ++i) {
+            values(i) = (float)Eigen::half((float)values(i));
+        }
+    }
+
+    /**
+     * Writes the gradient to a message
+     * @param message
+     * @param half whether to store the values as float16
+     */
+    void encode(Message& message, bool half) const {
+        message.write<uint8_t>(half);
+        message.write<uint64_t>(ids.size());
+        message.write(ids.data(), ids.size());
+        message.write(counts.data(), counts.size());
+        if (half) {
+            std::vector<Eigen::half> halfValues(values.size());
+            for (long i = 0; i < values.size(); ++i) {
+                halfValues[i] = Eigen::half((float)values(i));
+            }
+            message.write(halfValues.data(), halfValues.size());
+        } else {
+            message.write(values.data(), values.size());
+        }
+    }
+
+    /**
+     * Reads a gradient written by encode
+     * @param message
+     */
+    void decode(Message& message) {
+        bool half = message.read<uint8_t>() != 0;
+        resize(message.read<uint64_t>());
+        message.read(ids.data(), ids.size());
+        message.read(counts.data(), counts.size());
+        if (half) {
+            std::vector<Eigen::half> halfValues(values.size());
+            message.read(halfValues.data(), halfValues.size());
+            for (long i = 0; i < values.size(); ++i) {
+                values(i) = (float)halfValues[i];
+            }
+        } else {
+            message.read(values.data(), values.size());
+        }
+    }
+
+    /**
+     * Size of the encoding in bytes
+     * @param half
+     * @return
+     */
+    size_t getEncodedSize(bool half) const {
+        return 1 + sizeof(uint64_t) + size() * (sizeof(int64_t) + sizeof(int32_t) + getDimension() * (half ? 2 : sizeof(double)));
+    }
+
+    /**
+     * Resizes to n columns, keeps the first columns
+     * @param n
+     */
+    void resize(long n) {
+        ids.resize(n);
+        counts.resize(n);
+        values.conservativeResize(values.rows(), n);
+    }
+
+    /**
+     * Sets the number of uses of all ids to zero, e.g. for a residual that must not be regularized again
+     */
+    void clearCounts() {
+        std::fill(counts.begin(), counts.end(), 0);
+    }
+
+    long size() const {
+        return ids.size();
+    }
+
+    long getDimension() const {
+        return values.rows();
+    }
+
+    const std::vector<int64_t>& getIds() const {
+        return ids;
+    }
+
+    const std::vector<int32_t>& getCounts() const {
+        return counts;
+    }
+
+    const MatrixXd& getValues() const {
+        return values;
+    }
+
+    MatrixXd& getValues() {
+        return values;
+    }
+
+private:
+    std::vector<int64_t> ids; /** touched ids in ascending order **/
+    std::vector<int32_t> counts; /** number of uses of each id in the batch **/
+    MatrixXd values; /** k x n gradient columns **/
+};
+
+
+#endif //THRAX_SPARSEGRADIENT_H
@@ -0,0 +1,303 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_TCPTRANSPORT_H
+#define THRAX_TCPTRANSPORT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <Eigen/Core>
+#include <boost/log/trivial.hpp>
+
+#include <thrax/util/RandomUtil.h>
+#include "Transport.h"
+
+/**
+ * Connects to one server per shard over TCP. The servers are either started with --parameter-server on the hosts given
+ * in model.parameterServer.hosts, or, if no hosts are given, forked by the trainer and listening on the loopback
+ * interface, e.g. for tests. After connecting, the trainer sends the index of the shard and a seed drawn for the shard,
+ * so a server builds its shard when a trainer connects and the shards are initialized with different random numbers. Messages are framed by their length as a 64 bit integer.
+ */
+class TcpTransport: public Transport {
+public:
+    /**
+     * @param numberOfServers
+     * @param build builds the server of a shard in a forked process, used if hosts is empty
+     * @param hosts host:port of the server of each shard, empty to fork the servers
+     */
+    TcpTransport(int numberOfServers, ServerBuilder build, const std::vector<std::string>& hosts): Transport(numberOfServers) {
+        if (!hosts.empty() && hosts.size() != numberOfServers) {
+            BOOST_LOG_TRIVIAL(error) << "model.parameterServer.hosts has to list one host per server, " << hosts.size() << " given for " << numberOfServers << " servers";
+            exit(1);
+        }
+        // draw the seeds before forking, so the shards are not initialized with the same random numbers
+        std::vector<unsigned> seeds(numberOfServers);
+        for (int i = 0; i < numberOfServers; ++i) {
+            seeds[i] = (unsigned)RandomUtil::uniformLong(0, 1L << 32);
+        }
+        for (int i = 0; i < numberOfServers; ++i) {
+            if (hosts.empty()) {
+                startServer(i, seeds[i], build);
+            } else {
+                connectServer(i, seeds[i], hosts[i]);
+            }
+        }
+    }
+
+    /**
+     * Runs a server that was started with --parameter-server: listens on a port of all interfaces and serves the shard
+     * that the trainer requests, until the trainer shuts it down
+     * @param port
+     * @param numberOfServers number of shards, as configured for the trainer
+     * @param build builds the server of a shard
+     */
+    static void runServer(int port, int numberOfServers, ServerBuilder build) {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listener == -1 || ::bind(listener, (sockaddr*)&address, sizeof(address)) == -1 || ::listen(listener, 1) == -1) {
+            BOOST_LOG_TRIVIAL(error) << "Could not listen on port " << port;
+            exit(1);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Parameter server listening on port " << port;
+        serve(listener, numberOfServers, build);
+    }
+
+    virtual ~TcpTransport() {
+        shutdown();
+    }
+
+    virtual void send(int server, Message& request) override {
+        if (!writeMessage(sockets[server], request)) {
+            BOOST_LOG_TRIVIAL(error) << "Could not send request to parameter server " << server;
+            exit(1);
+        }
+    }
+
+    virtual void receive(int server, Message& response) override {
+        if (!readMessage(sockets[server], response)) {
+            BOOST_LOG_TRIVIAL(error) << "Parameter server " << server << " closed the connection";
+            exit(1);
+        }
+    }
+
+    virtual void shutdown() override {
+        Message request;
+        request.write<uint8_t>(ParameterServer::SHUTDOWN);
+        for (int i = 0; i < sockets.size(); ++i) {
+            writeMessage(sockets[i], request);
+            close(sockets[i]);
+        }
+        for (pid_t pid: servers) {
+            waitpid(pid, nullptr, 0);
+        }
+        sockets.clear();
+        servers.clear();
+    }
+
+private:
+    static const int CONNECT_ATTEMPTS = 30; /** attempts to connect to a server started with --parameter-server, one per second **/
+
+    std::vector<pid_t> servers; /** process id of each forked server **/
+    std::vector<int> sockets; /** connection to each server **/
+
+    /**
+     * Builds the server of a shard in a child process, which listens on a free port of the loopback interface, and
+     * connects to it. Stands in for servers on other hosts, e.g. in tests.
+     * @param shard
+     * @param seed seed of the initialization of the shard
+     * @param build
+     */
+    void startServer(int shard, unsigned seed, ServerBuilder& build) {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t length = sizeof(address);
+        if (listener == -1 || ::bind(listener, (sockaddr*)&address, length) == -1 || ::listen(listener, 1) == -1
+                || getsockname(listener, (sockaddr*)&address, &length) == -1) {
+            BOOST_LOG_TRIVIAL(error) << "Could not listen on the loopback interface for parameter server " << shard;
+            exit(1);
+        }
+        pid_t pid = fork();
+        if (pid == -1) {
+            BOOST_LOG_TRIVIAL(error) << "Could not fork parameter server " << shard;
+            exit(1);
+        }
+        if (pid == 0) {
+            for (int fd: sockets) {
+                close(fd);
+            }
+            serve(listener, numberOfServers, build);
+            // skip destructors and exit handlers that belong to the trainer
+            _exit(0);
+        }
+        close(listener);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1 || ::connect(fd, (sockaddr*)&address, sizeof(address)) == -1) {
+            BOOST_LOG_TRIVIAL(error) << "Could not connect to parameter server " << shard << " on port " << ntohs(address.sin_port);
+            exit(1);
+        }
+        servers.push_back(pid);
+        addConnection(shard, seed, fd);
+        BOOST_LOG_TRIVIAL(info) << "Started parameter server " << shard << " on port " << ntohs(address.sin_port);
+    }
+
+    /**
+     * Connects to the server of a shard that was started with --parameter-server, waiting for it to listen
+     * @param shard
+     * @param seed seed of the initialization of the shard
+     * @param host host:port of the server
+     */
+    void connectServer(int shard, unsigned seed, const std::string& host) {
+        size_t colon = host.rfind(':');
+        if (colon == std::string::npos) {
+            BOOST_LOG_TRIVIAL(error) << "Parameter server host " << host << " has to be given as host:port";
+            exit(1);
+        }
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses;
+        if (getaddrinfo(host.substr(0, colon).c_str(), host.substr(colon + 1).c_str(), &hints, &addresses) != 0) {
+            BOOST_LOG_TRIVIAL(error) << "Could not resolve parameter server host " << host;
+            exit(1);
+        }
+        int fd = -1;
+        for (int attempt = 0; attempt < CONNECT_ATTEMPTS && fd == -1; ++attempt) {
+            if (attempt > 0) {
+                sleep(1);
+            }
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd != -1 && ::connect(fd, addresses->ai_addr, addresses->ai_addrlen) == -1) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        if (fd == -1) {
+            BOOST_LOG_TRIVIAL(error) << "Could not connect to parameter server " << shard << " on " << host;
+            exit(1);
+        }
+        addConnection(shard, seed, fd);
+        BOOST_LOG_TRIVIAL(info) << "Connected to parameter server " << shard << " on " << host;
+    }
+
+    /**
+     * Adds the connection to the server of a shard and tells the server its shard and seed
+     * @param shard
+     * @param seed
+     * @param fd
+     */
+    void addConnection(int shard, unsigned seed, int fd) {
+        // requests are small and answered immediately, do not wait to fill packets
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        Message handshake;
+        handshake.write<uint32_t>(shard);
+        handshake.write<uint32_t>(seed);
+        if (!writeMessage(fd, handshake)) {
+            BOOST_LOG_TRIVIAL(error) << "Could not send the shard to parameter server " << shard;
+            exit(1);
+        }
+        sockets.push_back(fd);
+    }
+
+    /**
+     * Main loop of a server, accepts one trainer and handles its requests until the trainer shuts the server down
+     * @param listener
+     * @param numberOfServers
+     * @param build
+     */
+    static void serve(int listener, int numberOfServers, ServerBuilder& build) {
+        Eigen::setNbThreads(1);
+        int fd = ::accept(listener, nullptr, nullptr);
+        close(listener);
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        Message request;
+        Message response;
+        // the first message of the trainer is the shard of this server and the seed of its initialization
+        if (!readMessage(fd, request)) {
+            BOOST_LOG_TRIVIAL(error) << "Trainer closed the connection before sending the shard";
+            exit(1);
+        }
+        request.rewind();
+        uint32_t shard = request.read<uint32_t>();
+        uint32_t seed = request.read<uint32_t>();
+        if (shard >= numberOfServers) {
+            BOOST_LOG_TRIVIAL(error) << "Trainer requested shard " << shard << ", but model.parameterServer.numberOfServers is " << numberOfServers;
+            exit(1);
+        }
+        RandomUtil::seed(seed);
+        ParameterServer* server = build(shard);
+        while (readMessage(fd, request)) {
+            response.clear();
+            if (!server->handle(request, response) || !writeMessage(fd, response)) {
+                break;
+            }
+        }
+        close(fd);
+        delete server;
+    }
+
+    static bool writeMessage(int fd, Message& message) {
+        uint64_t size = message.size();
+        return writeFully(fd, &size, sizeof(size)) && writeFully(fd, message.getBuffer().data(), size);
+    }
+
+    static bool readMessage(int fd, Message& message) {
+        uint64_t size;
+        if (!readFully(fd, &size, sizeof(size))) {
+            return false;
+        }
+        message.clear();
+        message.getBuffer().resize(size);
+        return readFully(fd, message.getBuffer().data(), size);
+    }
+
+    static bool writeFully(int fd, const void* buffer, size_t bytes) {
+        const char* position = (const char*)buffer;
+        while (bytes > 0) {
+            ssize_t n = ::send(fd, position, bytes, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            position += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
+    static bool readFully(int fd, void* buffer, size_t bytes) {
+        char* position = (char*)buffer;
+        while (bytes > 0) {
+            ssize_t n = recv(fd, position, bytes, 0);
+            if (n <= 0) {
+                return false;
+            }
+            position += n;
+            bytes -= n;
+        }
+        return true;
+    }
+};
+
+
+#endif //THRAX_TCPTRANSPORT_H
@@ -0,0 +1,53 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_TRANSPORT_H
+#define THRAX_TRANSPORT_H
+
+#include <functional>
+
+#include "Message.h"
+#include "ParameterServer.h"
+
+/**
+ * Connection of a trainer to the parameter servers. Every request is answered by exactly one response, in order.
+ * Requests to several servers can be sent before the responses are received, so the servers work in parallel.
+ */
+class Transport {
+public:
+    typedef std::function<ParameterServer*(int)> ServerBuilder; /** builds the server of a shard **/
+
+    Transport(int numberOfServers): numberOfServers(numberOfServers) {}
+
+    virtual ~Transport() {}
+
+    /**
+     * Sends a request to a server
+     * @param server
+     * @param request
+     */
+    virtual void send(int server, Message& request) = 0;
+
+    /**
+     * Waits for the response of a server to the oldest request without response
+     * @param server
+     * @param response
+     */
+    virtual void receive(int server, Message& response) = 0;
+
+    /**
+     * Stops all servers
+     */
+    virtual void shutdown() = 0;
+
+    int getNumberOfServers() const {
+        return numberOfServers;
+    }
+
+protected:
+    int numberOfServers; /** number of servers, i.e. shards **/
+};
+
+
+#endif //THRAX_TRANSPORT_H
@@ -0,0 +1,46 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_TRANSPORTFACTORY_H
+#define THRAX_TRANSPORTFACTORY_H
+
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "Transport.h"
+#include "LocalTransport.h"
+#include "TcpTransport.h"
+
+class TransportFactory {
+public:
+    /**
+     * @param type tcp or local
+     * @param numberOfServers
+     * @param build builds the server of a shard, if the servers are started by the trainer
+     * @param hosts host:port of each server started with --parameter-server, only for tcp; empty to start the servers
+     * @return
+     */
+    static Transport* buildTransport(std::string type, int numberOfServers, Transport::ServerBuilder build, const std::vector<std::string>& hosts) {
+        boost::algorithm::to_lower(type);
+        Transport* transport;
+        if (type == "tcp") {
+            transport = new TcpTransport(numberOfServers, build, hosts);
+        } else if (type == "local" && !hosts.empty()) {
+            BOOST_LOG_TRIVIAL(error) << "model.parameterServer.hosts needs the tcp transport";
+            exit(1);
+        } else if (type == "local") {
+            transport = new LocalTransport(numberOfServers, build);
+        } else {
+            BOOST_LOG_TRIVIAL(error) << "Transport " << type << " not implemented";
+            exit(1);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Using " << type << " transport to " << numberOfServers << " parameter servers";
+        return transport;
+    }
+};
+
+
+#endif //THRAX_TRANSPORTFACTORY_H
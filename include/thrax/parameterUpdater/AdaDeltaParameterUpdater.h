@@ -22,28 +22,57 @@ public:
     AdaDeltaParameterUpdater(pt::ptree& hyperParameters, const ParameterMap& parameters): ParameterUpdater(hyperParameters, parameters) {
         delta = hyperParameters.get<double>("delta", 1e-7);
         rho = hyperParameters.get<double>("rho");
-        ScalarInitializer initializer(0.0);
-        int m;
-        int k;
         // initialize gradient accumulation data structures
         for (auto const& parameter: parameters) {
-            m = parameter.second.getNumberOfEmbeddings();
-            k = parameter.second.getEmbeddingDimension();
-            accumulatedGradients.insert({parameter.first, EmbeddingParameterSet(k, m)});
-            initializer.initialize(accumulatedGradients.at(parameter.first), parameter.first);
-            accumulatedParameterUpdates.insert({parameter.first, EmbeddingParameterSet(k, m)});
-            initializer.initialize(accumulatedParameterUpdates.at(parameter.first), parameter.first);
+            accumulatedGradients.insert({parameter.first, createAccumulator(parameter.second)});
+            accumulatedParameterUpdates.insert({parameter.first, createAccumulator(parameter.second)});
+            if (lazyDecay) {
+                lastUpdates.insert({parameter.first, EmbeddingParameterSet(1, parameter.second.getNumberOfEmbeddings())});
+                ScalarInitializer(0.0).initialize(lastUpdates.at(parameter.first), parameter.first);
+            }
         }
     }
 
-    virtual void calculateUpdate(GradientMap& gradients) {
-        for (auto& gradient: gradients) {
-            for (auto& ptr: gradient.second.getIdToCol()) {
-                accumulatedGradients.at(gradient.first).col(ptr.first) = rho * accumulatedGradients.at(gradient.first).col(ptr.first) + (1 - rho) * gradient.second.get(ptr.first).array().square().matrix();
-                VectorXd d = (gradient.second.get(ptr.first).array() * (accumulatedParameterUpdates.at(gradient.first).col(ptr.first).array() + delta).sqrt() / (accumulatedGradients.at(gradient.first).col(ptr.first).array() + delta).sqrt()).matrix();
-                accumulatedParameterUpdates.at(gradient.first).col(ptr.first) = rho * accumulatedParameterUpdates.at(gradient.first).col(ptr.first) + (1 - rho) * d.array().square().matrix();
-                gradient.second.setGradient(ptr.first, d);
-            }
+    virtual std::vector<EmbeddingParameterSet*> getState(const std::string& name) override {
+        std::vector<EmbeddingParameterSet*> state {&accumulatedGradients.at(name), &accumulatedParameterUpdates.at(name)};
+        if (lazyDecay) {
+            state.push_back(&lastUpdates.at(name));
+        }
+        return state;
+    }
+
+    virtual bool hasLearningRate() const override {
+        // the step size of AdaDelta is the ratio of the accumulated updates and gradients
+        return false;
+    }
+
+protected:
+    virtual void selectParameterSet(const std::string& name) override {
+        G = &accumulatedGradients.at(name);
+        D = &accumulatedParameterUpdates.at(name);
+        if (lazyDecay) {
+            last = &lastUpdates.at(name);
+        }
+    }
+
+    virtual void calculateColumnUpdate(int id, Ref<VectorXd> g) override {
+        // decay of the steps in which the row was not touched
+        double skippedDecay = 1.0;
+        if (lazyDecay) {
+            skippedDecay = std::pow(rho, skippedSteps(*last, id));
+        }
+        if (rowWise) {
+            double& accumulatedGradient = (*G)(0, id);
+            double& accumulatedUpdate = (*D)(0, id);
+            accumulatedUpdate *= skippedDecay;
+            accumulatedGradient = rho * skippedDecay * accumulatedGradient + (1 - rho) * g.squaredNorm() / g.size();
+            g *= std::sqrt(accumulatedUpdate + delta) / std::sqrt(accumulatedGradient + delta);
+            accumulatedUpdate = rho * accumulatedUpdate + (1 - rho) * g.squaredNorm() / g.size();
+        } else {
+            D->col(id) *= skippedDecay;
+            G->col(id).array() = rho * skippedDecay * G->col(id).array() + (1 - rho) * g.array().square();
+            g.array() *= (D->col(id).array() + delta).sqrt() / (G->col(id).array() + delta).sqrt();
+            D->col(id).array() = rho * D->col(id).array() + (1 - rho) * g.array().square();
         }
     }
 
@@ -52,6 +81,10 @@ private:
     double delta; /** minimum value not zero, used to avoid zero division **/
     ParameterMap accumulatedGradients;
     ParameterMap accumulatedParameterUpdates;
+    ParameterMap lastUpdates; /** step of the last update of each embedding, used for lazy decay **/
+    EmbeddingParameterSet* G; /** accumulated gradients of the selected parameter set **/
+    EmbeddingParameterSet* D; /** accumulated parameter updates of the selected parameter set **/
+    EmbeddingParameterSet* last; /** last updates of the selected parameter set **/
 };
 
 
@@ -23,24 +23,29 @@ public:
     AdaGradParameterUpdater(pt::ptree& hyperParameters, const ParameterMap& parameters): ParameterUpdater(hyperParameters, parameters) {
         delta = hyperParameters.get<double>("delta", 1e-7);
         alpha = hyperParameters.get<double>("alpha");
-        ScalarInitializer initializer(0.0);
-        int m;
-        int k;
         // initialize gradient accumulation data structures
         for (auto const& parameter: parameters) {
-            m = parameter.second.getNumberOfEmbeddings();
-            k = parameter.second.getEmbeddingDimension();
-            accumulatedGradients.insert({parameter.first, EmbeddingParameterSet(k, m)});
-            initializer.initialize(accumulatedGradients.at(parameter.first), parameter.first);
+            accumulatedGradients.insert({parameter.first, createAccumulator(parameter.second)});
         }
     }
 
-    virtual void calculateUpdate(GradientMap& gradients) {
-        for (auto& gradient: gradients) {
-            for (auto& ptr: gradient.second.getIdToCol()) {
-                accumulatedGradients.at(gradient.first).col(ptr.first) += gradient.second.get(ptr.first).array().square().matrix();
-                gradient.second.setGradient(ptr.first, (alpha * gradient.second.get(ptr.first).array() / (delta + accumulatedGradients.at(gradient.first).col(ptr.first).array().sqrt())).matrix());
-            }
+    virtual std::vector<EmbeddingParameterSet*> getState(const std::string& name) override {
+        return {&accumulatedGradients.at(name)};
+    }
+
+protected:
+    virtual void selectParameterSet(const std::string& name) override {
+        G = &accumulatedGradients.at(name);
+    }
+
+    virtual void calculateColumnUpdate(int id, Ref<VectorXd> g) override {
+        if (rowWise) {
+            double& accumulated = (*G)(0, id);
+            accumulated += g.squaredNorm() / g.size();
+            g *= alpha / (delta + std::sqrt(accumulated));
+        } else {
+            G->col(id).array() += g.array().square();
+            g.array() = alpha * g.array() / (delta + G->col(id).array().sqrt());
         }
     }
 
@@ -48,6 +53,7 @@ private:
     double alpha; /** step size **/
     double delta; /** minimum value not zero, used to avoid zero division **/
     ParameterMap accumulatedGradients;
+    EmbeddingParameterSet* G; /** accumulated gradients of the selected parameter set **/
 };
 
 
@@ -0,0 +1,102 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_ADAMPARAMETERUPDATER_H
+#define THRAX_ADAMPARAMETERUPDATER_H
+
+#include <cmath>
+#include <boost/property_tree/ptree.hpp>
+#include <Eigen/Dense>
+
+#include <thrax/struct/Gradient.h>
+#include <unordered_map>
+
+#include <thrax/initializer/ScalarInitializer.h>
+#include "ParameterUpdater.h"
+
+namespace pt = boost::property_tree;
+using namespace Eigen;
+
+/**
+ * Sparse Adam: only the moments of touched embeddings are updated, bias correction uses the global number of steps.
+ * The second moment can be kept row-wise, the first moment is always kept per parameter.
+ */
+class AdamParameterUpdater: public ParameterUpdater {
+public:
+    AdamParameterUpdater(pt::ptree& hyperParameters, const ParameterMap& parameters): ParameterUpdater(hyperParameters, parameters) {
+        delta = hyperParameters.get<double>("delta", 1e-7);
+        alpha = hyperParameters.get<double>("alpha");
+        beta1 = hyperParameters.get<double>("beta1", 0.9);
+        beta2 = hyperParameters.get<double>("beta2", 0.999);
+        // initialize moment data structures
+        for (auto const& parameter: parameters) {
+            int m = parameter.second.getNumberOfEmbeddings();
+            int k = parameter.second.getEmbeddingDimension();
+            firstMoments.insert({parameter.first, EmbeddingParameterSet(k, m)});
+            ScalarInitializer(0.0).initialize(firstMoments.at(parameter.first), parameter.first);
+            secondMoments.insert({parameter.first, createAccumulator(parameter.second)});
+            if (lazyDecay) {
+                lastUpdates.insert({parameter.first, EmbeddingParameterSet(1, m)});
+                ScalarInitializer(0.0).initialize(lastUpdates.at(parameter.first), parameter.first);
+            }
+        }
+    }
+
+    virtual std::vector<EmbeddingParameterSet*> getState(const std::string& name) override {
+        std::vector<EmbeddingParameterSet*> state {&firstMoments.at(name), &secondMoments.at(name)};
+        if (lazyDecay) {
+            state.push_back(&lastUpdates.at(name));
+        }
+        return state;
+    }
+
+protected:
+    virtual void selectParameterSet(const std::string& name) override {
+        M = &firstMoments.at(name);
+        V = &secondMoments.at(name);
+        if (lazyDecay) {
+            last = &lastUpdates.at(name);
+        }
+        biasCorrection1 = 1 - std::pow(beta1, step);
+        biasCorrection2 = 1 - std::pow(beta2, step);
+    }
+
+    virtual void calculateColumnUpdate(int id, Ref<VectorXd> g) override {
+        // decay of the steps in which the row was not touched
+        double decay1 = beta1;
+        double decay2 = beta2;
+        if (lazyDecay) {
+            long skipped = skippedSteps(*last, id);
+            decay1 *= std::pow(beta1, skipped);
+            decay2 *= std::pow(beta2, skipped);
+        }
+        M->col(id) = decay1 * M->col(id) + (1 - beta1) * g;
+        double stepSize = alpha / biasCorrection1;
+        if (rowWise) {
+            double& secondMoment = (*V)(0, id);
+            secondMoment = decay2 * secondMoment + (1 - beta2) * g.squaredNorm() / g.size();
+            g = (stepSize / (std::sqrt(secondMoment / biasCorrection2) + delta)) * M->col(id);
+        } else {
+            V->col(id).array() = decay2 * V->col(id).array() + (1 - beta2) * g.array().square();
+            g.array() = stepSize * M->col(id).array() / ((V->col(id).array() / biasCorrection2).sqrt() + delta);
+        }
+    }
+
+private:
+    double alpha; /** step size **/
+    double beta1; /** decay constant of the first moment **/
+    double beta2; /** decay constant of the second moment **/
+    double delta; /** minimum value not zero, used to avoid zero division **/
+    double biasCorrection1; /** bias correction of the first moment in the current step **/
+    double biasCorrection2; /** bias correction of the second moment in the current step **/
+    ParameterMap firstMoments;
+    ParameterMap secondMoments;
+    ParameterMap lastUpdates; /** step of the last update of each embedding, used for lazy decay **/
+    EmbeddingParameterSet* M; /** first moments of the selected parameter set **/
+    EmbeddingParameterSet* V; /** second moments of the selected parameter set **/
+    EmbeddingParameterSet* last; /** last updates of the selected parameter set **/
+};
+
+
+#endif //THRAX_ADAMPARAMETERUPDATER_H
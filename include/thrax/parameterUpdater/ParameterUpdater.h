@@ -6,22 +6,199 @@
 #define THRAX_PARAMETERUPDATER_H
 
 #include <string>
+#include <vector>
 #include <thrax/struct/Gradient.h>
 #include <map>
 #include <boost/property_tree/ptree.hpp>
 #include <thrax/util/Typedefs.h>
+#include <thrax/initializer/ScalarInitializer.h>
 
 namespace pt = boost::property_tree;
 
+/**
+ * Regularization of a parameter set that is applied in the fused update pass
+ */
+struct Regularization {
+    double lambda; /** L2 regularization hyper parameter, already scaled **/
+    bool normalize; /** whether to normalize the embeddings to unit norm after the update **/
+};
+
+typedef std::unordered_map<std::string, Regularization> RegularizationMap;
+
+/**
+ * Superclass of all parameter updaters. Subclasses implement the update of a single gradient column, the base class
+ * walks the touched columns of each parameter set.
+ * Adaptive updaters can keep their accumulators row-wise (one scalar per embedding instead of one per parameter) and
+ * can catch up on the decay that a dense implementation would have applied to rows that were not touched.
+ */
 class ParameterUpdater {
 public:
     ParameterUpdater(pt::ptree& hyperParameters, const ParameterMap& parameters): hyperParameters(hyperParameters) {
+        rowWise = hyperParameters.get<bool>("rowWise", false);
+        lazyDecay = hyperParameters.get<bool>("lazyDecay", false);
+        fused = hyperParameters.get<bool>("fused", false);
+        step = 0;
+    }
+
+    virtual ~ParameterUpdater() {}
+
+    /**
+     * Replaces the gradients by the updates that have to be subtracted from the parameters
+     * @param gradients
+     */
+    virtual void calculateUpdate(GradientMap& gradients) {
+        ++step;
+        for (auto& gradient: gradients) {
+            selectParameterSet(gradient.first);
+            for (auto& ptr: gradient.second.getIdToCol()) {
+                calculateColumnUpdate(ptr.first, gradient.second.col(ptr.second));
+            }
+        }
+    }
+
+    /**
+     * Calculates the updates and subtracts them from the parameters in one pass, so each touched column is read and
+     * written once
+     * @param gradients
+     * @param parameters
+     */
+    virtual void update(GradientMap& gradients, ParameterMap& parameters) {
+        ++step;
+        for (auto& gradient: gradients) {
+            selectParameterSet(gradient.first);
+            EmbeddingParameterSet& parameter = parameters.at(gradient.first);
+            for (auto& ptr: gradient.second.getIdToCol()) {
+                Gradient::Column g = gradient.second.col(ptr.second);
+                calculateColumnUpdate(ptr.first, g);
+                parameter.col(ptr.first) -= g;
+            }
+        }
+    }
+
+    /**
+     * Fused update: loads each touched gradient and parameter column once, adds the L2 regularization gradient,
+     * calculates the update, subtracts it and optionally normalizes the embedding.
+     * Equivalent to Gradient::l2, calculateUpdate, subtracting the updates and Gradient::normalize in separate passes.
+     * @param gradients
+     * @param parameters
+     * @param regularization regularization by parameter set name, missing parameter sets are not regularized
+     */
+    virtual void update(GradientMap& gradients, ParameterMap& parameters, const RegularizationMap& regularization) {
+        ++step;
+        for (auto& gradient: gradients) {
+            selectParameterSet(gradient.first);
+            EmbeddingParameterSet& parameter = parameters.at(gradient.first);
+            double lambda = 0.0;
+            bool normalize = false;
+            RegularizationMap::const_iterator it = regularization.find(gradient.first);
+            if (it != regularization.end()) {
+                lambda = it->second.lambda;
+                normalize = it->second.normalize;
+            }
+            for (auto& ptr: gradient.second.getIdToCol()) {
+                Gradient::Column g = gradient.second.col(ptr.second);
+                EmbeddingParameterSet::ColXpr p = parameter.col(ptr.first);
+                if (lambda > 0.0) {
+                    g += (2 * lambda * gradient.second.getCount(ptr.second)) * p;
+                }
+                calculateColumnUpdate(ptr.first, g);
+                p -= g;
+                if (normalize) {
+                    p.normalize();
+                }
+            }
+        }
     }
 
-    virtual void calculateUpdate(GradientMap& gradients) { }
+    /**
+     * Whether the updater has a base learning rate alpha, i.e. whether getLearningRate is meaningful
+     * @return
+     */
+    virtual bool hasLearningRate() const {
+        return true;
+    }
+
+    /**
+     * Base learning rate, used e.g. by the lazy L2 decay of the model
+     * @return
+     */
+    virtual double getLearningRate() const {
+        return hyperParameters.get<double>("alpha");
+    }
+
+    /**
+     * Get the state of a parameter set, i.e. all matrices with one column per embedding (e.g. accumulators), used to
+     * swap the state of entity partitions
+     * @param name name of the parameter set
+     * @return
+     */
+    virtual std::vector<EmbeddingParameterSet*> getState(const std::string& name) {
+        return std::vector<EmbeddingParameterSet*>();
+    }
+
+    /**
+     * Number of updates so far, e.g. for bias correction and lazy decay; part of the state saved in checkpoints
+     * @return
+     */
+    long getStep() const {
+        return step;
+    }
+
+    void setStep(long step) {
+        this->step = step;
+    }
+
+    /**
+     * Whether the model should use the fused update pass
+     * @return
+     */
+    bool isFused() const {
+        return fused;
+    }
 
 protected:
     pt::ptree hyperParameters;
+    bool rowWise; /** keep one accumulator value per embedding instead of one per parameter **/
+    bool lazyDecay; /** apply the decay of skipped steps to accumulators of rows when they are touched again **/
+    bool fused; /** apply regularization, update and normalization in a single pass **/
+    long step; /** number of updates so far **/
+
+    /**
+     * Called before the columns of a parameter set are updated, used to look up the state of the parameter set once
+     * @param name
+     */
+    virtual void selectParameterSet(const std::string& name) { }
+
+    /**
+     * Replaces gradient g of embedding id of the selected parameter set by its update
+     * @param id embedding id
+     * @param g gradient column
+     */
+    virtual void calculateColumnUpdate(int id, Ref<VectorXd> g) { }
+
+    /**
+     * Creates an accumulator for a parameter set, of size 1xm if row-wise and kxm otherwise
+     * @param parameter
+     * @param value initial value
+     * @return
+     */
+    EmbeddingParameterSet createAccumulator(const EmbeddingParameterSet& parameter, double value=0.0) {
+        EmbeddingParameterSet accumulator(rowWise ? 1 : parameter.getEmbeddingDimension(), parameter.getNumberOfEmbeddings());
+        ScalarInitializer(value).initialize(accumulator, "");
+        return accumulator;
+    }
+
+    /**
+     * Number of steps in which embedding id was not updated since its last update. Marks the embedding as updated.
+     * @param lastUpdates 1xm steps of the last update of each embedding
+     * @param id
+     * @return
+     */
+    long skippedSteps(EmbeddingParameterSet& lastUpdates, int id) {
+        long skipped = step - (long)lastUpdates(0, id) - 1;
+        lastUpdates(0, id) = step;
+        return skipped;
+    }
 };
 
 
@@ -15,6 +15,7 @@
 #include "AdaDeltaParameterUpdater.h"
 #include "AdaGradParameterUpdater.h"
 #include "RMSPropParameterUpdater.h"
+#include "AdamParameterUpdater.h"
 
 namespace pt = boost::property_tree;
 
@@ -32,6 +33,8 @@ public:
             updater = new AdaDeltaParameterUpdater(hyperParameters, parameterMap);
         } else if (updateStrategy == "rmsprop") {
             updater = new RMSPropParameterUpdater(hyperParameters, parameterMap);
+        } else if (updateStrategy == "adam") {
+            updater = new AdamParameterUpdater(hyperParameters, parameterMap);
         } else {
             BOOST_LOG_TRIVIAL(error) << "Could not find update strategy " << updateStrategy;
         }
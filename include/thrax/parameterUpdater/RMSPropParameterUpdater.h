@@ -24,25 +24,45 @@ public:
         delta = hyperParameters.get<double>("delta", 1e-7);
         alpha = hyperParameters.get<double>("alpha");
         rho = hyperParameters.get<double>("rho");
-        ScalarInitializer initializer(0.0);
-        int m;
-        int k;
         // initialize gradient accumulation data structures
         for (auto const& parameter: parameters) {
-            m = parameter.second.getNumberOfEmbeddings();
-            k = parameter.second.getEmbeddingDimension();
-            accumulatedGradients.insert({parameter.first, EmbeddingParameterSet(k, m)});
-            initializer.initialize(accumulatedGradients.at(parameter.first), parameter.first);
+            accumulatedGradients.insert({parameter.first, createAccumulator(parameter.second)});
+            if (lazyDecay) {
+                lastUpdates.insert({parameter.first, EmbeddingParameterSet(1, parameter.second.getNumberOfEmbeddings())});
+                ScalarInitializer(0.0).initialize(lastUpdates.at(parameter.first), parameter.first);
+            }
         }
     }
 
-    virtual void calculateUpdate(GradientMap& gradients) {
-        for (auto& gradient: gradients) {
-            for (auto& ptr: gradient.second.getIdToCol()) {
-                accumulatedGradients.at(gradient.first).col(ptr.first) = rho * accumulatedGradients.at(gradient.first).col(ptr.first) + (1 - rho) * gradient.second.get(ptr.first).array().square().matrix();
-                VectorXd d = (alpha * gradient.second.get(ptr.first).array() / (accumulatedGradients.at(gradient.first).col(ptr.first).array() + delta).sqrt()).matrix();
-                gradient.second.setGradient(ptr.first, d);
-            }
+    virtual std::vector<EmbeddingParameterSet*> getState(const std::string& name) override {
+        std::vector<EmbeddingParameterSet*> state {&accumulatedGradients.at(name)};
+        if (lazyDecay) {
+            state.push_back(&lastUpdates.at(name));
+        }
+        return state;
+    }
+
+protected:
+    virtual void selectParameterSet(const std::string& name) override {
+        G = &accumulatedGradients.at(name);
+        if (lazyDecay) {
+            last = &lastUpdates.at(name);
+        }
+    }
+
+    virtual void calculateColumnUpdate(int id, Ref<VectorXd> g) override {
+        // decay of the steps in which the row was not touched
+        double decay = rho;
+        if (lazyDecay) {
+            decay *= std::pow(rho, skippedSteps(*last, id));
+        }
+        if (rowWise) {
+            double& accumulated = (*G)(0, id);
+            accumulated = decay * accumulated + (1 - rho) * g.squaredNorm() / g.size();
+            g *= alpha / std::sqrt(accumulated + delta);
+        } else {
+            G->col(id).array() = decay * G->col(id).array() + (1 - rho) * g.array().square();
+            g.array() = alpha * g.array() / (G->col(id).array() + delta).sqrt();
         }
     }
 
@@ -51,6 +71,9 @@ private:
     double rho; /** decay constant **/
     double delta; /** minimum value not zero, used to avoid zero division **/
     ParameterMap accumulatedGradients;
+    ParameterMap lastUpdates; /** step of the last update of each embedding, used for lazy decay **/
+    EmbeddingParameterSet* G; /** accumulated gradients of the selected parameter set **/
+    EmbeddingParameterSet* last; /** last updates of the selected parameter set **/
 };
 
 
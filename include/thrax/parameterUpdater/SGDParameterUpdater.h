@@ -23,10 +23,9 @@ public:
         alpha = hyperParameters.get<double>("alpha");
     }
 
-    virtual void calculateUpdate(GradientMap& gradients) {
-        for (auto& gradient: gradients) {
-            gradient.second.setGradients(alpha * gradient.second.getGradients());
-        }
+protected:
+    virtual void calculateColumnUpdate(int id, Ref<VectorXd> g) override {
+        g *= alpha;
     }
 };
 
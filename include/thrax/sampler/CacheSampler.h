@@ -0,0 +1,179 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_CACHESAMPLER_H
+#define THRAX_CACHESAMPLER_H
+
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/struct/Data.h>
+#include <thrax/model/AbstractModel.h>
+#include "Sampler.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Samples hard negative triples from a cache of high-scoring candidates (NSCaching). For each (subject, relation) pair
+ * the sampler keeps up to cache.size candidate objects, for each (relation, object) pair candidate subjects.
+ * A cache entry is refreshed lazily when it is used and older than cache.refreshEvery batches: the current candidates
+ * and cache.numberOfCandidates random entities are scored by the model and the best ones are kept. At most
+ * cache.refreshBudget entries are refreshed per batch, so the cache maintenance stays cheap.
+ * Both caches together hold at most cache.capacity entries of cache.size entity ids each; when a new entry would exceed
+ * the capacity, the entry refreshed least recently is evicted.
+ */
+class CacheSampler: public Sampler {
+public:
+    CacheSampler(Data* data, pt::ptree &hyperParameters, AbstractModel* model): Sampler(data, hyperParameters), model(model) {
+        cacheSize = hyperParameters.get<int>("cache.size", 50);
+        numberOfCandidates = hyperParameters.get<int>("cache.numberOfCandidates", 50);
+        refreshBudget = hyperParameters.get<int>("cache.refreshBudget", 100);
+        refreshEvery = hyperParameters.get<int>("cache.refreshEvery", 10);
+        capacity = std::max<long>(1, hyperParameters.get<long>("cache.capacity", 1000000));
+        batch = 0;
+        refreshesLeft = refreshBudget;
+    }
+
+    virtual void preBatch() override {
+        ++batch;
+        refreshesLeft = refreshBudget;
+    }
+
+    virtual void sampleSingle(Triple &positive, Triple &negative, std::string mode) {
+        for (int j = 0; j < numberOfRetries; ++j) {
+            negative = Triple(positive.subject, positive.relation, positive.object);
+            if (mode == "subject" || mode == "both") {
+                // corrupt subject
+                negative.subject = sampleFromCache(subjectCache, positive, true);
+            } if (mode == "object" || mode == "both") {
+                // corrupt object
+                negative.object = sampleFromCache(objectCache, positive, false);
+            }
+            if (!data->hasTriple(negative)) {
+                return;
+            }
+        }
+        // corruption didn't work
+        BOOST_LOG_TRIVIAL(info) << "Could not sample negative triple for " << positive << " in " << numberOfRetries << " tries.";
+    }
+
+private:
+    typedef std::pair<EntityId, EntityId> CacheKey;
+    typedef std::list<std::pair<bool, CacheKey> > RefreshOrder; /** (subject cache?, key) of all entries, least recently refreshed first **/
+    struct CacheEntry {
+        std::vector<EntityId> candidates; /** entity ids with high scores **/
+        long lastRefresh; /** batch of the last refresh **/
+        RefreshOrder::iterator position; /** position of the entry in the refresh order **/
+    };
+    typedef std::unordered_map<CacheKey, CacheEntry, boost::hash<CacheKey> > CacheMap;
+
+    AbstractModel* model; /** model used to score the candidates **/
+    int cacheSize; /** maximum number of candidates per cache entry **/
+    int numberOfCandidates; /** number of random entities scored in addition to the cached ones on a refresh **/
+    int refreshBudget; /** maximum number of refreshes per batch **/
+    int refreshEvery; /** refresh an entry if it was not refreshed in the last refreshEvery batches **/
+    long capacity; /** maximum number of entries of both caches together **/
+    long batch; /** current batch **/
+    int refreshesLeft; /** number of refreshes left in the current batch **/
+    CacheMap subjectCache; /** map of (relation, object) -> candidate subjects **/
+    CacheMap objectCache; /** map of (subject, relation) -> candidate objects **/
+    RefreshOrder refreshOrder; /** entries of both caches in the order of their last refresh **/
+    std::vector<std::pair<double, EntityId> > scoredCandidates; /** re-usable data structure for refreshes **/
+
+    /**
+     * Samples a corrupted subject (or object) for the positive triple from the cache, refreshes the cache entry if
+     * it is stale and refresh budget is left. Falls back to uniform sampling if the entry is empty.
+     * @param cache
+     * @param positive
+     * @param alterSubject
+     * @return entity id
+     */
+    EntityId sampleFromCache(CacheMap& cache, Triple& positive, bool alterSubject) {
+        CacheKey key = alterSubject ? CacheKey(positive.relation, positive.object) : CacheKey(positive.subject, positive.relation);
+        CacheMap::iterator it = cache.find(key);
+        bool isStale = it == cache.end() || batch - it->second.lastRefresh >= refreshEvery;
+        if (isStale && refreshesLeft > 0) {
+            if (it == cache.end()) {
+                if (subjectCache.size() + objectCache.size() >= (size_t) capacity) {
+                    evictLeastRecentlyRefreshed();
+                }
+                it = cache.insert({key, CacheEntry()}).first;
+                it->second.position = refreshOrder.insert(refreshOrder.end(), std::make_pair(alterSubject, key));
+            } else {
+                refreshOrder.splice(refreshOrder.end(), refreshOrder, it->second.position);
+            }
+            refresh(it->second, positive, alterSubject);
+            --refreshesLeft;
+        }
+        if (it == cache.end() || it->second.candidates.empty()) {
+            return RandomUtil::uniformLong(0, data->getNumberOfEntities());
+        }
+        std::vector<EntityId>& candidates = it->second.candidates;
+        return candidates[RandomUtil::uniformLong(0, candidates.size())];
+    }
+
+    /**
+     * Removes the entry of both caches that was refreshed least recently
+     */
+    void evictLeastRecentlyRefreshed() {
+        std::pair<bool, CacheKey>& oldest = refreshOrder.front();
+        (oldest.first ? subjectCache : objectCache).erase(oldest.second);
+        refreshOrder.pop_front();
+    }
+
+    /**
+     * Scores the cached and numberOfCandidates random entities and keeps the cacheSize best ones that do not form
+     * a known triple
+     * @param entry
+     * @param positive
+     * @param alterSubject
+     */
+    void refresh(CacheEntry& entry, Triple& positive, bool alterSubject) {
+        scoredCandidates.clear();
+        for (EntityId candidate: entry.candidates) {
+            scoredCandidates.push_back(std::make_pair(0.0, candidate));
+        }
+        for (int i = 0; i < numberOfCandidates; ++i) {
+            scoredCandidates.push_back(std::make_pair(0.0, RandomUtil::uniformLong(0, data->getNumberOfEntities())));
+        }
+        // remove duplicates
+        std::sort(scoredCandidates.begin(), scoredCandidates.end(), [](const std::pair<double, EntityId>& a, const std::pair<double, EntityId>& b) { return a.second < b.second; });
+        scoredCandidates.erase(std::unique(scoredCandidates.begin(), scoredCandidates.end(), [](const std::pair<double, EntityId>& a, const std::pair<double, EntityId>& b) { return a.second == b.second; }), scoredCandidates.end());
+
+        // score candidates, drop known triples
+        Triple candidate(positive.subject, positive.relation, positive.object);
+        int n = 0;
+        for (int i = 0; i < scoredCandidates.size(); ++i) {
+            if (alterSubject) {
+                candidate.subject = scoredCandidates[i].second;
+            } else {
+                candidate.object = scoredCandidates[i].second;
+            }
+            if (data->hasTriple(candidate)) {
+                continue;
+            }
+            model->prepareTriple(candidate);
+            scoredCandidates[n++] = std::make_pair(model->score(candidate), scoredCandidates[i].second);
+        }
+        scoredCandidates.resize(n);
+
+        // keep the best candidates
+        int m = std::min(n, cacheSize);
+        std::partial_sort(scoredCandidates.begin(), scoredCandidates.begin() + m, scoredCandidates.end(), [](const std::pair<double, EntityId>& a, const std::pair<double, EntityId>& b) { return a.first > b.first; });
+        entry.candidates.resize(m);
+        for (int i = 0; i < m; ++i) {
+            entry.candidates[i] = scoredCandidates[i].second;
+        }
+        entry.lastRefresh = batch;
+    }
+};
+
+
+#endif //THRAX_CACHESAMPLER_H
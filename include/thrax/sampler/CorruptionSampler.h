@@ -16,7 +16,7 @@ namespace pt = boost::property_tree;
 /**
  * Samples negative triples by corrupting either subject or object of a positive one. If object is to be corrupted
  * it will randomly choose an entity that acts as an object for a given relation. Subject corruption analogously.
- * If none is found, fall back to LCWA sampling method.
+ * If none is found or the relation has no triples, fall back to LCWA sampling method.
  */
 class CorruptionSampler: public Sampler {
 public:
@@ -30,12 +30,14 @@ public:
             // flip coin to decide if subject or object is corrupted
             if (mode == "subject" || mode == "both") {
                 // corrupt subject
-                std::vector<int> &list = data->getSubjectsForRelation(positive.relation);
-                negative.subject = list[RandomUtil::uniformInt(0, list.size())];
+                SpanList<EntityId> list = data->getSubjectsForRelation(positive.relation);
+                if (list.empty()) break;
+                negative.subject = list[RandomUtil::uniformLong(0, list.size())];
             } if (mode == "object" || mode == "both") {
                 // corrupt object
-                std::vector<int> &list = data->getObjectsForRelation(positive.relation);
-                negative.object = list[RandomUtil::uniformInt(0, list.size())];
+                SpanList<EntityId> list = data->getObjectsForRelation(positive.relation);
+                if (list.empty()) break;
+                negative.object = list[RandomUtil::uniformLong(0, list.size())];
             }
             if (!data->hasTriple(negative)) {
                 return;
@@ -47,10 +49,10 @@ public:
             // flip coin to decide if subject or object is corrupted
             if (mode == "subject" || mode == "both") {
                 // corrupt subject
-                negative.subject = RandomUtil::uniformInt(0, data->getNumberOfEntities());
+                negative.subject = RandomUtil::uniformLong(0, data->getNumberOfEntities());
             } if (mode == "object" || mode == "both") {
                 // corrupt object
-                negative.object = RandomUtil::uniformInt(0, data->getNumberOfEntities());
+                negative.object = RandomUtil::uniformLong(0, data->getNumberOfEntities());
             }
             if (!data->hasTriple(negative)) {
                 return;
@@ -14,36 +14,58 @@ namespace pt = boost::property_tree;
 /**
  * Samples negatives triples according to the closed world assumption i.e. we assume that if we observe a triple for a
  * subject/object-relation pair, we're locally complete and all other triples are incorrect.
+ * With type constraints, the corrupted entities are drawn from the candidates of the relation first.
  */
 class LCWASampler: public Sampler {
 public:
     LCWASampler(Data* data, pt::ptree &hyperParameters): Sampler(data, hyperParameters) { }
 
+    virtual bool supportsCandidateIndex() const override {
+        return true;
+    }
+
     /**
      * Randomly chooses either subject or object to corrupt
      * @param positive positive input triple
      * @param negative negative candidate output triple
      */
     virtual void sampleSingle(Triple &positive, Triple &negative, std::string mode) {
-        int k;
-        int k2;
-        for (int j = 0; j < numberOfRetries; ++j) {
-            negative = Triple(positive.subject, positive.relation, positive.object);
-            // flip coin to decide if subject or object is corrupted
-            if (mode == "subject" || mode == "both") {
-                // corrupt subject
-                negative.subject = RandomUtil::uniformInt(0, data->getNumberOfEntities());
-            } if (mode == "object" || mode == "both") {
-                // corrupt object
-                negative.object = RandomUtil::uniformInt(0, data->getNumberOfEntities());
+        // with type constraints, fall back to all entities if no negative candidate is found
+        for (bool constrained: {true, false}) {
+            if (constrained && candidateIndex == nullptr) {
+                continue;
             }
-            if (!data->hasTriple(negative)) {
-                return;
+            for (int j = 0; j < numberOfRetries; ++j) {
+                negative = Triple(positive.subject, positive.relation, positive.object);
+                // flip coin to decide if subject or object is corrupted
+                if (mode == "subject" || mode == "both") {
+                    // corrupt subject
+                    negative.subject = drawEntity(constrained ? &candidateIndex->getSubjects(positive.relation) : nullptr);
+                } if (mode == "object" || mode == "both") {
+                    // corrupt object
+                    negative.object = drawEntity(constrained ? &candidateIndex->getObjects(positive.relation) : nullptr);
+                }
+                if (!data->hasTriple(negative)) {
+                    return;
+                }
             }
         }
         // corruption didn't work
         BOOST_LOG_TRIVIAL(info) << "Could not sample negative triple for " << positive << " in " << numberOfRetries << " tries.";
     }
+
+private:
+    /**
+     * Draws a random entity
+     * @param candidates candidates of the relation, nullptr or empty to draw from all entities
+     * @return
+     */
+    EntityId drawEntity(const std::vector<EntityId>* candidates) {
+        if (candidates == nullptr || candidates->empty()) {
+            return RandomUtil::uniformLong(0, data->getNumberOfEntities());
+        }
+        return (*candidates)[RandomUtil::uniformLong(0, candidates->size())];
+    }
 };
 
 
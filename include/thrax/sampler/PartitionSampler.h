@@ -0,0 +1,66 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_PARTITIONSAMPLER_H
+#define THRAX_PARTITIONSAMPLER_H
+
+#include <algorithm>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/struct/Data.h>
+#include "Sampler.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Samples negative triples for partitioned training under the closed world assumption. Subjects are corrupted by
+ * entities of the subject partition and objects by entities of the object partition of the active bucket, so the
+ * negatives only use resident embeddings.
+ */
+class PartitionSampler: public Sampler {
+public:
+    PartitionSampler(Data* data, pt::ptree &hyperParameters, EntityId partitionSize): Sampler(data, hyperParameters), partitionSize(partitionSize) {
+        setBucket(0, 0);
+    }
+
+    /**
+     * Sets the partitions of the active bucket
+     * @param subjectPartition
+     * @param objectPartition
+     */
+    void setBucket(int subjectPartition, int objectPartition) {
+        subjectFirst = subjectPartition * partitionSize;
+        subjectEnd = std::min(subjectFirst + partitionSize, data->getNumberOfEntities());
+        objectFirst = objectPartition * partitionSize;
+        objectEnd = std::min(objectFirst + partitionSize, data->getNumberOfEntities());
+    }
+
+    virtual void sampleSingle(Triple &positive, Triple &negative, std::string mode) {
+        for (int j = 0; j < numberOfRetries; ++j) {
+            negative = Triple(positive.subject, positive.relation, positive.object);
+            if (mode == "subject" || mode == "both") {
+                // corrupt subject
+                negative.subject = RandomUtil::uniformLong(subjectFirst, subjectEnd);
+            } if (mode == "object" || mode == "both") {
+                // corrupt object
+                negative.object = RandomUtil::uniformLong(objectFirst, objectEnd);
+            }
+            if (!data->hasTriple(negative)) {
+                return;
+            }
+        }
+        // corruption didn't work
+        BOOST_LOG_TRIVIAL(info) << "Could not sample negative triple for " << positive << " in " << numberOfRetries << " tries.";
+    }
+
+private:
+    EntityId partitionSize; /** number of entities per partition **/
+    EntityId subjectFirst; /** first entity of the subject partition **/
+    EntityId subjectEnd; /** end of the entities of the subject partition **/
+    EntityId objectFirst; /** first entity of the object partition **/
+    EntityId objectEnd; /** end of the entities of the object partition **/
+};
+
+
+#endif //THRAX_PARTITIONSAMPLER_H
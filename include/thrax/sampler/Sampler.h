@@ -10,6 +10,7 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <thrax/struct/CandidateIndex.h>
 #include <thrax/struct/Triple.h>
 #include <thrax/util/RandomUtil.h>
 
@@ -17,12 +18,14 @@ namespace pt = boost::property_tree;
 
 class Sampler {
 public:
-    Sampler(Data* data, pt::ptree &hyperParameters): data(data), hyperParameters(hyperParameters) {
+    Sampler(Data* data, pt::ptree &hyperParameters): data(data), hyperParameters(hyperParameters), candidateIndex(nullptr) {
         numberOfNegatives = hyperParameters.get<int>("numberOfNegatives", 1);
         numberOfRetries = hyperParameters.get<int>("numberOfRetries", 10);
         mode = hyperParameters.get<std::string>("mode", "random");
     }
 
+    virtual ~Sampler() {}
+
     void sample(Triple &positive, std::vector<Triple>::iterator negativeIterator) {
         sample(positive, negativeIterator, mode);
     }
@@ -49,12 +52,39 @@ public:
         }
     }
 
+    /**
+     * Restricts the corrupted entities to the candidates of the relation, if the sampler supports it
+     * @param candidateIndex type constraints of the relations
+     */
+    void setCandidateIndex(CandidateIndex* candidateIndex) {
+        if (!supportsCandidateIndex()) {
+            BOOST_LOG_TRIVIAL(warning) << "The sampler does not support type constraints, optimizer.sampling.typeConstrained is ignored";
+        }
+        this->candidateIndex = candidateIndex;
+    }
+
+    /**
+     * Whether sampleSingle draws the corrupted entities from the candidate index
+     * @return
+     */
+    virtual bool supportsCandidateIndex() const {
+        return false;
+    }
+
+    /**
+     * Hook that is called before the negatives of a batch are sampled
+     */
+    virtual void preBatch() {
+        // do nothing by default
+    }
+
 protected:
     pt::ptree hyperParameters;
     int numberOfNegatives; /** number of negative triples that should be sampled for each positive triple */
     int numberOfRetries; /** number of retries for perturbation */
     std::string mode; /** mode to perturb: random (randomly choose between corrupting subject or object), subject (corrupt only subjects), object (corrupt only objects) */ // TODO  add both (corrupt once subject, once object)
     Data* data;
+    CandidateIndex* candidateIndex; /** type constraints of the relations, nullptr if not used **/
     Triple negative;
 
     /**
@@ -11,12 +11,13 @@
 #include "Sampler.h"
 #include "LCWASampler.h"
 #include "CorruptionSampler.h"
+#include "CacheSampler.h"
 
 namespace pt = boost::property_tree;
 
 class SamplerFactory {
 public:
-    static Sampler* buildSampler(Data* data, pt::ptree& hyperParameters) {
+    static Sampler* buildSampler(Data* data, pt::ptree& hyperParameters, AbstractModel* model) {
         std::string samplingStrategy = hyperParameters.get<std::string>("type", "lcwa");
         boost::algorithm::to_lower(samplingStrategy);
         Sampler* sampler;
@@ -24,6 +25,8 @@ public:
             sampler = new LCWASampler(data, hyperParameters);
         } else if (samplingStrategy == "corruption") {
             sampler = new CorruptionSampler(data, hyperParameters);
+        } else if (samplingStrategy == "cache") {
+            sampler = new CacheSampler(data, hyperParameters, model);
         } else {
             BOOST_LOG_TRIVIAL(error) << "Could not find sampling strategy " << samplingStrategy;
         }
@@ -0,0 +1,380 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_ADJACENCYINDEX_H
+#define THRAX_ADJACENCYINDEX_H
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <thrax/struct/Span.h>
+#include <thrax/struct/Triple.h>
+
+/**
+ * Compressed sparse row index of (relation, key) -> sorted list of values, e.g. (relation, subject) -> objects.
+ * Keys are sorted in one block per relation, so a lookup is a binary search within the block of the relation
+ * followed by a contiguous read of the values.
+ */
+class PairIndex {
+public:
+    /**
+     * Builds the index from triples, duplicate triples are stored once
+     * @param triples triples or packed triples
+     * @param key member of the triple used as key next to the relation
+     * @param value member of the triple used as value
+     * @param numberOfRelations
+     */
+    template <typename T>
+    void build(const std::vector<T>& triples, EntityId Triple::*key, EntityId Triple::*value, RelationId numberOfRelations) {
+        std::vector<Triple> sorted(triples.begin(), triples.end());
+        sortUnique(sorted, key, value);
+        buildSorted(sorted, key, value, numberOfRelations);
+    }
+
+    /**
+     * Merges the entries of another index built with the same key and value into this index.
+     * Both indices are already sorted, so this is a linear merge without sorting.
+     * @param other
+     * @param key
+     * @param value
+     * @param numberOfRelations
+     */
+    void merge(const PairIndex& other, EntityId Triple::*key, EntityId Triple::*value, RelationId numberOfRelations) {
+        std::vector<Triple> existing, added;
+        extract(existing, key, value);
+        other.extract(added, key, value);
+        std::vector<Triple> merged;
+        merged.reserve(existing.size() + added.size());
+        std::merge(existing.begin(), existing.end(), added.begin(), added.end(), std::back_inserter(merged), comparator(key, value));
+        merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+        buildSorted(merged, key, value, numberOfRelations);
+    }
+
+    /**
+     * Get the values of (relation, key), empty if the pair does not exist
+     * @param relation
+     * @param key
+     * @return
+     */
+    Span<EntityId> get(RelationId relation, EntityId key) const {
+        if (relation < 0 || relation + 1 >= relationOffsets.size()) {
+            return Span<EntityId>();
+        }
+        std::vector<EntityId>::const_iterator first = keys.begin() + relationOffsets[relation];
+        std::vector<EntityId>::const_iterator last = keys.begin() + relationOffsets[relation + 1];
+        std::vector<EntityId>::const_iterator it = std::lower_bound(first, last, key);
+        if (it == last || *it != key) {
+            return Span<EntityId>();
+        }
+        size_t i = it - keys.begin();
+        return Span<EntityId>(values.data() + valueOffsets[i], valueOffsets[i + 1] - valueOffsets[i]);
+    }
+
+private:
+    std::vector<TripleId> relationOffsets; /** offsets of the key block of each relation, size numberOfRelations + 1 **/
+    std::vector<EntityId> keys; /** sorted keys of each relation **/
+    std::vector<TripleId> valueOffsets; /** offsets of the values of each key, size keys + 1 **/
+    std::vector<EntityId> values; /** sorted values of each key **/
+
+    /**
+     * Order by (relation, key, value)
+     */
+    static std::function<bool(const Triple&, const Triple&)> comparator(EntityId Triple::*key, EntityId Triple::*value) {
+        return [key, value](const Triple& a, const Triple& b) {
+            if (a.relation != b.relation) return a.relation < b.relation;
+            if (a.*key != b.*key) return a.*key < b.*key;
+            return a.*value < b.*value;
+        };
+    }
+
+    static void sortUnique(std::vector<Triple>& triples, EntityId Triple::*key, EntityId Triple::*value) {
+        std::sort(triples.begin(), triples.end(), comparator(key, value));
+        triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+    }
+
+    /**
+     * Builds the index from triples sorted by (relation, key, value) without duplicates
+     */
+    void buildSorted(const std::vector<Triple>& sorted, EntityId Triple::*key, EntityId Triple::*value, RelationId numberOfRelations) {
+        relationOffsets.assign(numberOfRelations + 1, 0);
+        keys.clear();
+        valueOffsets.clear();
+        values.clear();
+        values.reserve(sorted.size());
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            const Triple& triple = sorted[i];
+            // start a new key block
+            if (i == 0 || triple.relation != sorted[i-1].relation || triple.*key != sorted[i-1].*key) {
+                keys.push_back(triple.*key);
+                valueOffsets.push_back(values.size());
+                ++relationOffsets[triple.relation + 1];
+            }
+            values.push_back(triple.*value);
+        }
+        valueOffsets.push_back(values.size());
+        // prefix sum of the number of keys per relation
+        for (RelationId r = 0; r < numberOfRelations; ++r) {
+            relationOffsets[r + 1] += relationOffsets[r];
+        }
+        keys.shrink_to_fit();
+        valueOffsets.shrink_to_fit();
+    }
+
+    /**
+     * Writes the entries as triples in (relation, key, value) order
+     */
+    void extract(std::vector<Triple>& triples, EntityId Triple::*key, EntityId Triple::*value) const {
+        triples.reserve(triples.size() + values.size());
+        Triple triple(0, 0, 0);
+        for (RelationId r = 0; r + 1 < relationOffsets.size(); ++r) {
+            triple.relation = r;
+            for (TripleId i = relationOffsets[r]; i < relationOffsets[r + 1]; ++i) {
+                triple.*key = keys[i];
+                for (TripleId j = valueOffsets[i]; j < valueOffsets[i + 1]; ++j) {
+                    triple.*value = values[j];
+                    triples.push_back(triple);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * Adjacency of a set of triples in compressed sparse row format, built by a sort pass over the triples.
+ * Replaces hash maps of vectors (one heap allocation per key) by a few contiguous arrays.
+ */
+class AdjacencySegment {
+public:
+    /**
+     * Builds the segment from triples
+     * @param triples triples or packed triples
+     * @param numberOfRelations
+     */
+    template <typename T>
+    void build(const std::vector<T>& triples, RelationId numberOfRelations) {
+        // relation -> subjects/objects, one entry per triple in order of the triples (counting sort)
+        relationOffsets.assign(numberOfRelations + 1, 0);
+        for (Triple triple: triples) {
+            ++relationOffsets[triple.relation + 1];
+        }
+        for (RelationId r = 0; r < numberOfRelations; ++r) {
+            relationOffsets[r + 1] += relationOffsets[r];
+        }
+        std::vector<TripleId> position(relationOffsets.begin(), relationOffsets.end() - 1);
+        relationSubjects.resize(triples.size());
+        relationObjects.resize(triples.size());
+        for (Triple triple: triples) {
+            TripleId i = position[triple.relation]++;
+            relationSubjects[i] = triple.subject;
+            relationObjects[i] = triple.object;
+        }
+
+        subjectRelation2Object.build(triples, &Triple::subject, &Triple::object, numberOfRelations);
+        relationObject2Subject.build(triples, &Triple::object, &Triple::subject, numberOfRelations);
+    }
+
+    /**
+     * Merges another segment into this segment in time linear in the size of both segments
+     * @param other
+     * @param numberOfRelations
+     */
+    void merge(const AdjacencySegment& other, RelationId numberOfRelations) {
+        // relation lists: the entries of this segment followed by the entries of the other segment
+        std::vector<TripleId> offsets(numberOfRelations + 1, 0);
+        for (RelationId r = 0; r < numberOfRelations; ++r) {
+            offsets[r + 1] = offsets[r] + countForRelation(r) + other.countForRelation(r);
+        }
+        std::vector<EntityId> subjects(offsets[numberOfRelations]);
+        std::vector<EntityId> objects(offsets[numberOfRelations]);
+        for (RelationId r = 0; r < numberOfRelations; ++r) {
+            TripleId i = offsets[r];
+            const AdjacencySegment* segments[] = {this, &other};
+            for (const AdjacencySegment* segment: segments) {
+                Span<EntityId> s = segment->relationSpan(segment->relationSubjects, r);
+                Span<EntityId> o = segment->relationSpan(segment->relationObjects, r);
+                std::copy(s.begin(), s.end(), subjects.begin() + i);
+                std::copy(o.begin(), o.end(), objects.begin() + i);
+                i += s.size();
+            }
+        }
+        relationOffsets.swap(offsets);
+        relationSubjects.swap(subjects);
+        relationObjects.swap(objects);
+
+        subjectRelation2Object.merge(other.subjectRelation2Object, &Triple::subject, &Triple::object, numberOfRelations);
+        relationObject2Subject.merge(other.relationObject2Subject, &Triple::object, &Triple::subject, numberOfRelations);
+    }
+
+    /**
+     * Number of triples in the segment
+     * @return
+     */
+    TripleId size() const {
+        return relationSubjects.size();
+    }
+
+    Span<EntityId> getSubjectsForRelation(RelationId relation) const {
+        return relationSpan(relationSubjects, relation);
+    }
+
+    Span<EntityId> getObjectsForRelation(RelationId relation) const {
+        return relationSpan(relationObjects, relation);
+    }
+
+    Span<EntityId> getObjectsForSubjectRelation(EntityId subject, RelationId relation) const {
+        return subjectRelation2Object.get(relation, subject);
+    }
+
+    Span<EntityId> getSubjectsForRelationObject(RelationId relation, EntityId object) const {
+        return relationObject2Subject.get(relation, object);
+    }
+
+private:
+    std::vector<TripleId> relationOffsets; /** offsets of the triples of each relation, size numberOfRelations + 1 **/
+    std::vector<EntityId> relationSubjects; /** subjects of the triples, grouped by relation **/
+    std::vector<EntityId> relationObjects; /** objects of the triples, grouped by relation **/
+    PairIndex subjectRelation2Object; /** (subject, relation) -> objects **/
+    PairIndex relationObject2Subject; /** (relation, object) -> subjects **/
+
+    TripleId countForRelation(RelationId relation) const {
+        return relationSpan(relationSubjects, relation).size();
+    }
+
+    Span<EntityId> relationSpan(const std::vector<EntityId>& list, RelationId relation) const {
+        if (relation < 0 || relation + 1 >= relationOffsets.size()) {
+            return Span<EntityId>();
+        }
+        return Span<EntityId>(list.data() + relationOffsets[relation], relationOffsets[relation + 1] - relationOffsets[relation]);
+    }
+};
+
+/**
+ * Adjacency index of a knowledge base that supports appending triples. Appended triples are kept in levels of segments
+ * next to the base segment, so an append does not touch the base. Each level is at least twice as large as the next
+ * one: an append adds a level, and the last levels are merged while that does not hold. Each triple is thus merged
+ * O(log n) times, and an append costs O(log n) amortized per triple instead of rebuilding all appended triples.
+ * The levels are merged into the base once they hold more than 1/COMPACTION_RATIO of the triples of the base, which
+ * keeps the amortized cost of the base merges linear in the number of appended triples.
+ * Lookups return the entries of the base and of all levels, each part sorted where the segment is sorted.
+ */
+class AdjacencyIndex {
+public:
+    AdjacencyIndex(): numberOfAppended(0) {}
+
+    /**
+     * Builds the index from triples
+     * @param triples triples or packed triples
+     * @param numberOfRelations
+     */
+    template <typename T>
+    void build(const std::vector<T>& triples, RelationId numberOfRelations) {
+        base.build(triples, numberOfRelations);
+        levels.clear();
+        numberOfAppended = 0;
+    }
+
+    /**
+     * Appends triples to the index
+     * @param triples triples or packed triples
+     * @param numberOfRelations number of relations including the relations of the appended triples
+     */
+    template <typename T>
+    void append(const std::vector<T>& triples, RelationId numberOfRelations) {
+        levels.push_back(AdjacencySegment());
+        levels.back().build(triples, numberOfRelations);
+        numberOfAppended += levels.back().size();
+        // merge the last levels until the sizes decrease geometrically again
+        while (levels.size() > 1 && (2 * levels.back().size() >= levels[levels.size() - 2].size() || levels.size() > MAX_LEVELS)) {
+            mergeLastLevel(numberOfRelations);
+        }
+        if ((size_t)numberOfAppended * COMPACTION_RATIO > (size_t)base.size()) {
+            while (levels.size() > 1) {
+                mergeLastLevel(numberOfRelations);
+            }
+            base.merge(levels.front(), numberOfRelations);
+            levels.clear();
+            numberOfAppended = 0;
+        }
+    }
+
+    /**
+     * Get the subjects of all triples of the relation, with one entry per triple
+     * @param relation
+     * @return
+     */
+    SpanList<EntityId> getSubjectsForRelation(RelationId relation) const {
+        SpanList<EntityId> list;
+        list.add(base.getSubjectsForRelation(relation));
+        for (const AdjacencySegment& level: levels) {
+            list.add(level.getSubjectsForRelation(relation));
+        }
+        return list;
+    }
+
+    /**
+     * Get the objects of all triples of the relation, with one entry per triple
+     * @param relation
+     * @return
+     */
+    SpanList<EntityId> getObjectsForRelation(RelationId relation) const {
+        SpanList<EntityId> list;
+        list.add(base.getObjectsForRelation(relation));
+        for (const AdjacencySegment& level: levels) {
+            list.add(level.getObjectsForRelation(relation));
+        }
+        return list;
+    }
+
+    /**
+     * Get the objects of (subject, relation), each part is sorted
+     * @param subject
+     * @param relation
+     * @return
+     */
+    SpanList<EntityId> getObjectsForSubjectRelation(EntityId subject, RelationId relation) const {
+        SpanList<EntityId> list;
+        list.add(base.getObjectsForSubjectRelation(subject, relation));
+        for (const AdjacencySegment& level: levels) {
+            list.add(level.getObjectsForSubjectRelation(subject, relation));
+        }
+        return list;
+    }
+
+    /**
+     * Get the subjects of (relation, object), each part is sorted
+     * @param relation
+     * @param object
+     * @return
+     */
+    SpanList<EntityId> getSubjectsForRelationObject(RelationId relation, EntityId object) const {
+        SpanList<EntityId> list;
+        list.add(base.getSubjectsForRelationObject(relation, object));
+        for (const AdjacencySegment& level: levels) {
+            list.add(level.getSubjectsForRelationObject(relation, object));
+        }
+        return list;
+    }
+
+private:
+    static const int COMPACTION_RATIO = 8; /** the levels are merged into the base when they exceed 1/COMPACTION_RATIO of the base **/
+    static const size_t MAX_LEVELS = SpanList<EntityId>::MAX_PARTS - 1; /** lookups return one part per level and the base **/
+
+    AdjacencySegment base; /** triples of the last build or compaction **/
+    std::vector<AdjacencySegment> levels; /** triples appended since, in order of appending, each level at least twice as large as the next **/
+    TripleId numberOfAppended; /** number of triples in the levels **/
+
+    /**
+     * Merges the last level into the level before it
+     * @param numberOfRelations
+     */
+    void mergeLastLevel(RelationId numberOfRelations) {
+        levels[levels.size() - 2].merge(levels.back(), numberOfRelations);
+        levels.pop_back();
+    }
+};
+
+
+#endif //THRAX_ADJACENCYINDEX_H
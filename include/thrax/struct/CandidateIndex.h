@@ -0,0 +1,192 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_CANDIDATEINDEX_H
+#define THRAX_CANDIDATEINDEX_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <thrax/struct/Data.h>
+
+/**
+ * Type constraints of the relations: for each relation the sorted candidate subjects (domain) and candidate objects
+ * (range). A relation without candidates for a position is not constrained in that position, i.e. all entities are
+ * candidates.
+ */
+class CandidateIndex {
+public:
+    CandidateIndex(RelationId numberOfRelations): subjects(numberOfRelations), objects(numberOfRelations) {}
+
+    /**
+     * Builds the index from a config value: "train" takes the entities that occur with a relation in data, any other
+     * value is the path of a file with lines <relation>\t<subject|object>\t<entity>
+     * @param source
+     * @param data training data, provides the vocabularies
+     * @return
+     */
+    static CandidateIndex* buildCandidateIndex(const std::string& source, const Data& data) {
+        CandidateIndex* index = new CandidateIndex(data.getNumberOfRelations());
+        if (source == "train") {
+            index->addObserved(data);
+        } else {
+            index->load(source, data);
+        }
+        index->finish();
+        BOOST_LOG_TRIVIAL(info) << "Type constraints from " << source << ": on average " << index->getAverageNumberOfSubjects()
+                                << " candidate subjects and " << index->getAverageNumberOfObjects() << " candidate objects of "
+                                << data.getNumberOfEntities() << " entities per relation";
+        return index;
+    }
+
+    /**
+     * Adds the subjects and objects of the triples of each relation of data
+     * @param data
+     */
+    void addObserved(const Data& data) {
+        for (RelationId relation = 0; relation < subjects.size(); ++relation) {
+            SpanList<EntityId> observedSubjects = data.getSubjectsForRelation(relation);
+            for (size_t i = 0; i < observedSubjects.size(); ++i) {
+                subjects[relation].push_back(observedSubjects[i]);
+            }
+            SpanList<EntityId> observedObjects = data.getObjectsForRelation(relation);
+            for (size_t i = 0; i < observedObjects.size(); ++i) {
+                objects[relation].push_back(observedObjects[i]);
+            }
+        }
+    }
+
+    /**
+     * Adds the candidates listed in a file, lines of unknown relations or entities are skipped
+     * @param path
+     * @param data provides the vocabularies
+     */
+    void load(const std::string& path, const Data& data) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not open type constraints file " << path;
+            exit(1);
+        }
+        std::string line;
+        std::vector<std::string> splits;
+        long skipped = 0;
+        while (std::getline(in, line)) {
+            boost::trim(line);
+            if (line.length() < 1) continue;
+            boost::split(splits, line, boost::is_any_of("\t"));
+            if (splits.size() != 3 || (splits[1] != "subject" && splits[1] != "object")) {
+                BOOST_LOG_TRIVIAL(error) << "Invalid line in type constraints file " << path << ": " << line;
+                exit(1);
+            }
+            RelationId relation = data.getRelationVocabulary()->find(splits[0]);
+            EntityId entity = data.getEntityVocabulary()->find(splits[2]);
+            if (relation < 0 || relation >= subjects.size() || entity < 0) {
+                ++skipped;
+                continue;
+            }
+            if (splits[1] == "subject") {
+                subjects[relation].push_back(entity);
+            } else {
+                objects[relation].push_back(entity);
+            }
+        }
+        if (skipped > 0) {
+            BOOST_LOG_TRIVIAL(info) << "Skipped " << skipped << " type constraints of unknown relations or entities in " << path;
+        }
+    }
+
+    /**
+     * Sorts the candidates and removes duplicates
+     */
+    void finish() {
+        for (std::vector<std::vector<EntityId> >* lists: {&subjects, &objects}) {
+            for (auto& list: *lists) {
+                std::sort(list.begin(), list.end());
+                list.erase(std::unique(list.begin(), list.end()), list.end());
+            }
+        }
+    }
+
+    /**
+     * Candidate subjects of a relation
+     * @param relation
+     * @return sorted entities, empty if the subjects of the relation are not constrained
+     */
+    const std::vector<EntityId>& getSubjects(RelationId relation) const {
+        return subjects[relation];
+    }
+
+    /**
+     * Candidate objects of a relation
+     * @param relation
+     * @return sorted entities, empty if the objects of the relation are not constrained
+     */
+    const std::vector<EntityId>& getObjects(RelationId relation) const {
+        return objects[relation];
+    }
+
+    /**
+     * Draws a fixed sample of the candidates of each relation, lists with at most numberOfCandidates entities are kept
+     * @param numberOfCandidates
+     * @param generator
+     * @return index of the sampled candidates
+     */
+    CandidateIndex sample(EntityId numberOfCandidates, std::mt19937& generator) const {
+        CandidateIndex sampled(subjects.size());
+        for (RelationId relation = 0; relation < subjects.size(); ++relation) {
+            sampled.subjects[relation] = sampleSorted(subjects[relation], numberOfCandidates, generator);
+            sampled.objects[relation] = sampleSorted(objects[relation], numberOfCandidates, generator);
+        }
+        return sampled;
+    }
+
+    /**
+     * Draws entities without replacement
+     * @param entities
+     * @param size number of drawn entities, all entities are returned if there are at most size
+     * @param generator
+     * @return sorted sample
+     */
+    static std::vector<EntityId> sampleSorted(const std::vector<EntityId>& entities, EntityId size, std::mt19937& generator) {
+        std::vector<EntityId> sample(entities);
+        if (sample.size() > size) {
+            // the first size steps of a Fisher-Yates shuffle
+            for (EntityId i = 0; i < size; ++i) {
+                std::swap(sample[i], sample[std::uniform_int_distribution<size_t>(i, sample.size() - 1)(generator)]);
+            }
+            sample.resize(size);
+        }
+        std::sort(sample.begin(), sample.end());
+        return sample;
+    }
+
+    double getAverageNumberOfSubjects() const {
+        return averageSize(subjects);
+    }
+
+    double getAverageNumberOfObjects() const {
+        return averageSize(objects);
+    }
+
+private:
+    std::vector<std::vector<EntityId> > subjects; /** candidate subjects of each relation **/
+    std::vector<std::vector<EntityId> > objects; /** candidate objects of each relation **/
+
+    static double averageSize(const std::vector<std::vector<EntityId> >& lists) {
+        double size = 0.0;
+        for (auto& list: lists) {
+            size += list.size();
+        }
+        return lists.empty() ? 0.0 : size / lists.size();
+    }
+};
+
+
+#endif //THRAX_CANDIDATEINDEX_H
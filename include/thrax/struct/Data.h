@@ -6,25 +6,24 @@
 #define THRAX_DATA_H
 
 #include <iostream>
+#include <memory>
+#include <numeric>
 #include <unordered_map>
 #include <tuple>
 #include <string>
 #include <vector>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/identity.hpp>
-#include <boost/multi_index/member.hpp>
-#include <boost/multi_index/composite_key.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/filesystem.hpp>
 
 #include <thrax/util/FileUtil.h>
-#include <thrax/struct/DataContainer.h>
+#include <thrax/struct/AdjacencyIndex.h>
+#include <thrax/struct/Span.h>
 #include <thrax/struct/Triple.h>
+#include <thrax/struct/TripleIndex.h>
+#include <thrax/struct/Vocabulary.h>
 #include <thrax/util/Typedefs.h>
 
 using namespace boost;
-using namespace boost::multi_index;
 namespace fs = boost::filesystem;
 
 /**
@@ -35,17 +34,18 @@ public:
     /**
      * Default constructor
      */
-    Data() {}
+    Data(): entityVocabulary(std::make_shared<EntityVocabulary>()), relationVocabulary(std::make_shared<RelationVocabulary>()) {}
 
     /**
-     * Sets the internal maps to map from string representations to unique IDs.
-     * Used to use the same maps in train, validation and test data.
-     * @param entityMap
-     * @param relationMap
+     * Shares the vocabularies mapping from string representations to unique IDs.
+     * Used to use the same vocabularies in train, validation and test data without copying them.
+     * A shared vocabulary is copied before this data set adds new names to it.
+     * @param entities
+     * @param relations
      */
-    void setMaps(std::unordered_map<std::string, int> entityMap, std::unordered_map<std::string, int> relationMap) {
-        entity2id = entityMap;
-        relation2id = relationMap;
+    void setVocabularies(std::shared_ptr<EntityVocabulary> entities, std::shared_ptr<RelationVocabulary> relations) {
+        entityVocabulary = entities;
+        relationVocabulary = relations;
     }
 
     /**
@@ -53,7 +53,7 @@ public:
      * @param path
      * @param limit
      */
-    void load(const std::string &path, bool ignoreNewConstituents, int limit=-1) {
+    void load(const std::string &path, bool ignoreNewConstituents, TripleId limit=-1) {
         BOOST_LOG_TRIVIAL(info) << "Loading triples from " << path;
         // load data from file
         loadData(path, ignoreNewConstituents, limit);
@@ -63,23 +63,28 @@ public:
         BOOST_LOG_TRIVIAL(info) << "Number of relations: " << K;
     }
 
-    int getNumberOfTriples() const {
+    TripleId getNumberOfTriples() const {
         return numberOfTriples;
     }
 
-    int getNumberOfEntities() const {
+    EntityId getNumberOfEntities() const {
         return N;
     }
 
-    int getNumberOfRelations() const {
+    RelationId getNumberOfRelations() const {
         return K;
     }
 
-    Triple& getTriple(int i) {
+    /**
+     * Get the i-th triple, unpacked
+     * @param i
+     * @return
+     */
+    Triple getTriple(TripleId i) const {
         return triples[i];
     }
 
-    std::vector<Triple>& getTriples() {
+    const std::vector<PackedTriple>& getTriples() const {
         return triples;
     }
 
@@ -89,73 +94,77 @@ public:
      * @param newTriples
      */
     void addTriples(Data& data) {
-        BOOST_LOG_TRIVIAL(info) << "Adding " << data.getNumberOfTriples() << " triples";
-        triples.insert(triples.end(), data.getTriples().begin(), data.getTriples().end());
-        multiIndex.insert(data.getTriples().begin(), data.getTriples().end());
-        for (auto& kv: data.getSubjectsForRelation()) {
-            relation2Subject[kv.first].insert(relation2Subject[kv.first].begin(), kv.second.begin(), kv.second.end());
-        }
-        for (auto& kv: data.getObjectsForRelation()) {
-            relation2Object[kv.first].insert(relation2Object[kv.first].begin(), kv.second.begin(), kv.second.end());
-        }
-        for (auto& kv: data.getSubjectsForRelationObject()) {
-            subjectRelation2Object[kv.first].insert(subjectRelation2Object[kv.first].begin(), kv.second.begin(), kv.second.end());
-        }
-        for (auto& kv: data.getObjectsForSubjectRelation()) {
-            relationObject2Subject[kv.first].insert(relationObject2Subject[kv.first].begin(), kv.second.begin(), kv.second.end());
-        }
-        init();
+        addTriples(data.getTriples());
+    }
+
+    /**
+     * Append triples to the internal data structures without rebuilding them, e.g. for repeated appends of deltas.
+     * The cost is linear in the number of appended triples, apart from the amortized compaction of the adjacency index.
+     * @param newTriples triples mapped with the vocabularies of this data set
+     */
+    void addTriples(const std::vector<PackedTriple>& newTriples) {
+        BOOST_LOG_TRIVIAL(info) << "Adding " << newTriples.size() << " triples";
+        triples.insert(triples.end(), newTriples.begin(), newTriples.end());
+        tripleIndex.insert(newTriples);
+        update();
+        adjacency.append(newTriples, K);
         BOOST_LOG_TRIVIAL(info) << "Number of triples: " << numberOfTriples;
         BOOST_LOG_TRIVIAL(info) << "Number of entities: " << N;
         BOOST_LOG_TRIVIAL(info) << "Number of relations: " << K;
     }
 
-    std::unordered_map<std::string, int> &getEntityMap() {
-        return entity2id;
+    std::shared_ptr<EntityVocabulary> getEntityVocabulary() const {
+        return entityVocabulary;
     }
 
-    std::unordered_map<std::string, int> &getRelationMap() {
-        return relation2id;
+    std::shared_ptr<RelationVocabulary> getRelationVocabulary() const {
+        return relationVocabulary;
     }
 
-    const std::vector<int>& getEntities() const {
+    const std::vector<EntityId>& getEntities() const {
         return entities;
     }
 
-    const std::vector<int>& getRelations() const {
+    const std::vector<RelationId>& getRelations() const {
         return relations;
     }
 
-    std::vector<int>& getObjectsForSubjectRelation(int subjectId, int relationId) {
-        return subjectRelation2Object[std::make_pair(subjectId, relationId)];
-    }
-
-    Pair2ListMap& getObjectsForSubjectRelation() {
-        return subjectRelation2Object;
-    }
-
-    std::vector<int>& getSubjectsForRelationObject(int relationId, int objectId) {
-        return relationObject2Subject[std::make_pair(relationId, objectId)];
-    }
-
-    Pair2ListMap& getSubjectsForRelationObject() {
-        return relationObject2Subject;
+    /**
+     * Get the sorted objects of all triples (subjectId, relationId, ?)
+     * @param subjectId
+     * @param relationId
+     * @return
+     */
+    SpanList<EntityId> getObjectsForSubjectRelation(EntityId subjectId, RelationId relationId) const {
+        return adjacency.getObjectsForSubjectRelation(subjectId, relationId);
     }
 
-    std::vector<int>& getSubjectsForRelation(int relationId) {
-        return relation2Subject[relationId];
+    /**
+     * Get the sorted subjects of all triples (?, relationId, objectId)
+     * @param relationId
+     * @param objectId
+     * @return
+     */
+    SpanList<EntityId> getSubjectsForRelationObject(RelationId relationId, EntityId objectId) const {
+        return adjacency.getSubjectsForRelationObject(relationId, objectId);
     }
 
-    std::unordered_map<int, std::vector<int> > getSubjectsForRelation() {
-        return relation2Subject;
-    };
-
-    std::vector<int>& getObjectsForRelation(int relationId) {
-        return relation2Object[relationId];
+    /**
+     * Get the subjects of all triples of a relation, one entry per triple
+     * @param relationId
+     * @return
+     */
+    SpanList<EntityId> getSubjectsForRelation(RelationId relationId) const {
+        return adjacency.getSubjectsForRelation(relationId);
     }
 
-    std::unordered_map<int, std::vector<int> >& getObjectsForRelation() {
-        return relation2Object;
+    /**
+     * Get the objects of all triples of a relation, one entry per triple
+     * @param relationId
+     * @return
+     */
+    SpanList<EntityId> getObjectsForRelation(RelationId relationId) const {
+        return adjacency.getObjectsForRelation(relationId);
     }
 
     /**
@@ -163,85 +172,109 @@ public:
      * @param triple
      * @return
      */
-    bool hasTriple(Triple &triple) {
-        return multiIndex.get<byAll>().find(std::make_tuple(triple.subject, triple.relation, triple.object)) != multiIndex.get<byAll>().end();
+    bool hasTriple(const Triple &triple) const {
+        return tripleIndex.contains(triple);
+    }
+
+    const TripleIndex& getTripleIndex() const {
+        return tripleIndex;
     }
 
     /**
      * Dumps the mappings to files
      * @param path
      */
-    void dumpMappings(std::string path) {
+    void dumpMappings(std::string path) const {
         fs::path dir(path);
         fs::create_directories(dir);
         BOOST_LOG_TRIVIAL(info) << "Dumping mappings to " << dir.string();
         // entities
         fs::path entityPath = dir / "entityMappings.csv";
-        FileUtil::dumpMap(entityPath.string(), entity2id);
+        entityVocabulary->dump(entityPath.string());
         // relations
         fs::path relationPath = dir / "relationMappings.csv";
-        FileUtil::dumpMap(relationPath.string(), relation2id);
+        relationVocabulary->dump(relationPath.string());
     }
 
     void loadMappings(std::string path) {
         fs::path dir(path);
         BOOST_LOG_TRIVIAL(info) << "Loading mappings from " << dir.string();
+        detachVocabularies();
         // entities
         fs::path entityPath = dir / "entityMappings.csv";
-        FileUtil::loadMap(entityPath.string(), entity2id);
+        entityVocabulary->load(entityPath.string());
         // relations
         fs::path relationPath = dir / "relationMappings.csv";
-        FileUtil::loadMap(relationPath.string(), relation2id);
+        relationVocabulary->load(relationPath.string());
     }
 
 private:
-    int numberOfTriples; /** number of triples in data */
-    int N; /** number of entities */
-    int K; /** number of relations */
+    TripleId numberOfTriples; /** number of triples in data */
+    EntityId N; /** number of entities */
+    RelationId K; /** number of relations */
 
-    std::unordered_map<std::string, int> entity2id; /** map of entity name -> entity id */
-    std::unordered_map<std::string, int> relation2id; /** map of relation name -> relation id */
+    std::shared_ptr<EntityVocabulary> entityVocabulary; /** entity name <-> entity id, possibly shared with other data sets */
+    std::shared_ptr<RelationVocabulary> relationVocabulary; /** relation name <-> relation id, possibly shared with other data sets */
 
-    // TODO how to handle these indices for validation/test data
-    Pair2ListMap subjectRelation2Object; /** map of (subject, relation) -> list of objects **/
-    Pair2ListMap relationObject2Subject; /** map of (relation, object) -> list of subjects **/
+    AdjacencyIndex adjacency; /** (subject, relation) -> objects, (relation, object) -> subjects, relation -> subjects/objects **/
 
-    std::unordered_map<int, std::vector<int> > relation2Subject; /** map from relation -> list of subjects **/
-    std::unordered_map<int, std::vector<int> > relation2Object; /** map from relation -> list of objects **/
+    std::vector<EntityId> entities; /** list of unique entity ids **/
+    std::vector<RelationId> relations; /** list of unique relation ids **/
 
-    std::vector<int> entities; /** list of unique entity ids **/
-    std::vector<int> relations; /** list of unique relation ids **/
+    std::vector<PackedTriple> triples; /** vector of packed triples */
 
-    std::vector<Triple> triples; /** vector of triples */
-
-    DataContainer multiIndex; /** multi index structure for queries */
+    TripleIndex tripleIndex; /** membership index of the triples */
 
     void init() {
-        // gather statistics
-        numberOfTriples = triples.size();
-        N = entity2id.size();
-        K = relation2id.size();
-
-        // build entity and relation lists
         entities.clear();
-        entities.reserve(N);
         relations.clear();
-        relations.reserve(K);
-        for (auto kv: entity2id) {
-            entities.push_back(kv.second);
-        }
-        for (auto kv: relation2id) {
-            relations.push_back(kv.second);
-        }
+        update();
+
+        // build adjacency index
+        adjacency.build(triples, K);
+    }
+
+    /**
+     * Updates the statistics and extends the entity and relation lists by new ids
+     */
+    void update() {
+        // gather statistics
+        numberOfTriples = triples.size();
+        N = entityVocabulary->size();
+        K = relationVocabulary->size();
+
+        // extend entity and relation lists, ids are consecutive
+        EntityId numberOfListedEntities = entities.size();
+        entities.resize(N);
+        std::iota(entities.begin() + numberOfListedEntities, entities.end(), numberOfListedEntities);
+        RelationId numberOfListedRelations = relations.size();
+        relations.resize(K);
+        std::iota(relations.begin() + numberOfListedRelations, relations.end(), numberOfListedRelations);
     }
 
     /**
      * Load data from files.
      * @param path path to file
      */
-    void loadData(const std::string &path, bool ignoreNewConstituents, int limit){
-        FileUtil::loadData(path, entity2id, relation2id, triples, multiIndex, subjectRelation2Object, relationObject2Subject, relation2Subject, relation2Object, limit, ignoreNewConstituents);
+    void loadData(const std::string &path, bool ignoreNewConstituents, TripleId limit){
+        if (!ignoreNewConstituents) {
+            detachVocabularies();
+        }
+        FileUtil::loadData(path, *entityVocabulary, *relationVocabulary, triples, limit, ignoreNewConstituents);
+        tripleIndex.insert(triples);
     };
+
+    /**
+     * Copies the vocabularies if they are shared with other data sets, so they can be modified
+     */
+    void detachVocabularies() {
+        if (entityVocabulary.use_count() > 1) {
+            entityVocabulary = std::make_shared<EntityVocabulary>(*entityVocabulary);
+        }
+        if (relationVocabulary.use_count() > 1) {
+            relationVocabulary = std::make_shared<RelationVocabulary>(*relationVocabulary);
+        }
+    }
 };
 
 #endif //THRAX_DATA_H
@@ -6,6 +6,7 @@
 #define THRAX_GRADIENT_H
 
 #include <unordered_map>
+#include <vector>
 
 #include <thrax/model/EmbeddingParameterSet.h>
 #include <thrax/util/Typedefs.h>
@@ -20,28 +21,41 @@ using namespace Eigen;
  */
 class Gradient {
 public:
+    typedef MatrixXd::ColXpr Column;
+
     Gradient(EmbeddingParameterSet* parameterSet):
+            Gradient(parameterSet, parameterSet->getNumberOfEmbeddings()) // TODO this can be smaller than max
+    {}
+
+    /**
+     * @param parameterSet
+     * @param max maximum number of embeddings in a gradient, 0 for the parameters of a model that only scores triples
+     */
+    Gradient(EmbeddingParameterSet* parameterSet, int max):
             parameterSet(parameterSet),
-            max(parameterSet->getNumberOfEmbeddings()),
+            max(max),
             size(0),
-            d(parameterSet->getEmbeddingDimension(), max) // TODO this can be smaller than max
+            d(parameterSet->getEmbeddingDimension(), max),
+            counts(max)
     {}
 
     /**
      * Sets the gradient of embedding i to value v
      * @param i id of embedding
      * @param v value of embedding
+     * @param count how often the embedding was used, e.g. when adding a gradient that was summed up elsewhere
      */
-    void add(int i, VectorXd v) {
-        if (idToCol.find(i) != idToCol.end()) {
+    void add(int i, VectorXd v, int count = 1) {
+        std::unordered_map<int, int>::iterator it = idToCol.find(i);
+        if (it != idToCol.end()) {
             // id already present, add to col
-            d.col(idToCol[i]) += v;
-            idToCount[i]++;
+            d.col(it->second) += v;
+            counts[it->second] += count;
         } else {
             // id not present, add new col
             d.col(size) = v;
             idToCol[i] = size;
-            idToCount[i] = 1;
+            counts[size] = count;
             size++;
         }
     }
@@ -64,12 +78,20 @@ public:
         return d.col(idToCol[i]);
     }
 
+    /**
+     * Get a reference to column c of the gradient matrix without copying
+     * @param c column as stored in idToCol
+     * @return
+     */
+    Column col(int c) {
+        return d.col(c);
+    }
+
     /**
      * Resets the gradient matrix by setting the size to 0
      */
     void reset() {
         idToCol.clear();
-        idToCount.clear();
         size = 0;
     }
 
@@ -77,6 +99,15 @@ public:
         return size;
     }
 
+    /**
+     * Get how often the embedding stored in column c was used in the batch
+     * @param c column as stored in idToCol
+     * @return
+     */
+    int getCount(int c) const {
+        return counts[c];
+    }
+
     /**
      * Get the first <size> rows of the gradient matrix
      * @return
@@ -107,7 +138,7 @@ public:
      */
     void l2(double lambda) {
         for (auto& ptr: idToCol) {
-            d.col(ptr.second) +=  2 * lambda * parameterSet->col(ptr.first) * idToCount[ptr.first];
+            d.col(ptr.second) +=  2 * lambda * parameterSet->col(ptr.first) * counts[ptr.second];
         }
     }
 
@@ -125,7 +156,7 @@ private:
     int max; /** maximum number of embeddings **/
     MatrixXd d; /** gradient values **/
     std::unordered_map<int, int> idToCol; /** hash map that maps embedding ids to rows of the gradient matrix **/
-    std::unordered_map<int, int> idToCount; /** hash map that maps embedding ids to counts how often an ID was used in a batch **/
+    std::vector<int> counts; /** counts how often the embedding of each column was used in a batch **/
     EmbeddingParameterSet* parameterSet;
 };
 
@@ -0,0 +1,100 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_SPAN_H
+#define THRAX_SPAN_H
+
+#include <cstddef>
+
+/**
+ * Read-only view on a contiguous range of elements owned by another data structure, e.g. the neighbors of a key in
+ * an adjacency index. A span is invalidated when the owner is rebuilt.
+ */
+template <typename T>
+class Span {
+public:
+    Span(): first(nullptr), n(0) {}
+
+    Span(const T* first, size_t n): first(first), n(n) {}
+
+    const T* begin() const {
+        return first;
+    }
+
+    const T* end() const {
+        return first + n;
+    }
+
+    size_t size() const {
+        return n;
+    }
+
+    bool empty() const {
+        return n == 0;
+    }
+
+    const T& operator[](size_t i) const {
+        return first[i];
+    }
+
+private:
+    const T* first; /** pointer to the first element **/
+    size_t n; /** number of elements **/
+};
+
+/**
+ * Concatenation of a few spans, e.g. the entries of a key in the base and in the appended segments of an index.
+ * The spans are stored inline, so returning a list does not allocate; empty spans are skipped.
+ */
+template <typename T>
+class SpanList {
+public:
+    static const int MAX_PARTS = 16; /** maximum number of non-empty spans **/
+
+    SpanList(): numberOfParts(0), n(0) {}
+
+    /**
+     * Appends a span, at most MAX_PARTS non-empty spans can be added
+     * @param part
+     */
+    void add(Span<T> part) {
+        if (!part.empty()) {
+            parts[numberOfParts++] = part;
+            n += part.size();
+        }
+    }
+
+    size_t size() const {
+        return n;
+    }
+
+    bool empty() const {
+        return n == 0;
+    }
+
+    const T& operator[](size_t i) const {
+        int p = 0;
+        while (i >= parts[p].size()) {
+            i -= parts[p].size();
+            ++p;
+        }
+        return parts[p][i];
+    }
+
+    int getNumberOfParts() const {
+        return numberOfParts;
+    }
+
+    const Span<T>& getPart(int p) const {
+        return parts[p];
+    }
+
+private:
+    Span<T> parts[MAX_PARTS]; /** non-empty parts in order **/
+    int numberOfParts; /** number of parts **/
+    size_t n; /** total number of elements **/
+};
+
+
+#endif //THRAX_SPAN_H
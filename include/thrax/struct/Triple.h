@@ -5,14 +5,29 @@
 #ifndef THRAX_TRIPLE_H
 #define THRAX_TRIPLE_H
 
+#include <cstdint>
+#include <ostream>
+
+/**
+ * Index types. Building with THRAX_64BIT_IDS allows more than 2^31 entities and triples.
+ */
+#ifdef THRAX_64BIT_IDS
+typedef int64_t EntityId; /** entity id, also used for numbers of entities **/
+typedef int64_t TripleId; /** position of a triple, also used for numbers of triples **/
+#else
+typedef int32_t EntityId; /** entity id, also used for numbers of entities **/
+typedef int32_t TripleId; /** position of a triple, also used for numbers of triples **/
+#endif
+typedef int32_t RelationId; /** relation id, with 64 bit ids at most 2^16 relations are supported by packed triples **/
+
 struct Triple{
 public:
-    int subject;
-    int relation;
-    int object;
+    EntityId subject;
+    RelationId relation;
+    EntityId object;
 
     Triple(){};
-    Triple(int subject, int relation, int object):subject(subject), relation(relation), object(object) {}
+    Triple(EntityId subject, RelationId relation, EntityId object):subject(subject), relation(relation), object(object) {}
 
     bool operator==(const Triple &b) const {
         return (this->subject == b.subject) && (this->relation == b.relation) && (this->object == b.object);
@@ -23,4 +38,37 @@ public:
     }
 };
 
+/**
+ * Compact storage representation of a triple. With 64 bit ids subject and object are stored in 48 bit fields and the
+ * relation in a 16 bit field, so a triple takes 16 instead of 24 bytes at the cost of at most 2^16 relations.
+ * With 32 bit ids a triple takes 12 bytes either way, so all fields keep 32 bits and the relations are not limited.
+ */
+struct PackedTriple {
+public:
+#ifdef THRAX_64BIT_IDS
+    static const int ENTITY_BITS = 48;
+    static const int RELATION_BITS = 16;
+    uint64_t subject: 48;
+    uint64_t relation: 16;
+    uint64_t object: 48;
+#else
+    static const int ENTITY_BITS = 32;
+    static const int RELATION_BITS = 32;
+    uint32_t subject;
+    uint32_t relation;
+    uint32_t object;
+#endif
+
+    PackedTriple() {};
+    PackedTriple(const Triple& triple) {
+        subject = triple.subject;
+        relation = triple.relation;
+        object = triple.object;
+    }
+
+    operator Triple() const {
+        return Triple((EntityId)subject, (RelationId)relation, (EntityId)object);
+    }
+};
+
 #endif //THRAX_TRIPLE_H
@@ -0,0 +1,255 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_TRIPLEINDEX_H
+#define THRAX_TRIPLEINDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <boost/log/trivial.hpp>
+
+#include <thrax/struct/Triple.h>
+
+#ifdef THRAX_64BIT_IDS
+typedef unsigned __int128 TripleKey; /** packed triple key, wide enough for two 48 bit entity ids and a relation **/
+#else
+typedef uint64_t TripleKey; /** packed triple key **/
+#endif
+
+/**
+ * Membership index of triples. Triples are packed into keys of subject, relation and object bits and stored
+ * in an open addressing hash table with linear probing. A blocked Bloom filter in front of the table answers most
+ * lookups of non-existing triples, e.g. sampled negatives, by reading a single block of 8 words.
+ * The bit widths grow with the largest id inserted, which rebuilds the index.
+ */
+class TripleIndex {
+public:
+    TripleIndex() {
+        clear();
+    }
+
+    /**
+     * Removes all triples
+     */
+    void clear() {
+        entityBits = 1;
+        relationBits = 1;
+        numberOfTriples = 0;
+        slots.assign(MIN_CAPACITY, 0);
+        bloom.assign(WORDS_PER_BLOCK, 0);
+    }
+
+    /**
+     * Inserts triples, duplicates are ignored
+     * @param triples triples or packed triples
+     */
+    template <typename T>
+    void insert(const std::vector<T>& triples) {
+        // make room for all triples at once
+        int newEntityBits = entityBits;
+        int newRelationBits = relationBits;
+        for (Triple triple: triples) {
+            newEntityBits = std::max(newEntityBits, std::max(bits(triple.subject), bits(triple.object)));
+            newRelationBits = std::max(newRelationBits, bits(triple.relation));
+        }
+        size_t capacity = slots.size();
+        while (2 * (numberOfTriples + triples.size()) > capacity) {
+            capacity *= 2;
+        }
+        if (newEntityBits != entityBits || newRelationBits != relationBits || capacity != slots.size()) {
+            rebuild(newEntityBits, newRelationBits, capacity);
+        }
+        for (Triple triple: triples) {
+            insert(triple);
+        }
+    }
+
+    /**
+     * Inserts a triple, duplicates are ignored
+     * @param triple
+     */
+    void insert(const Triple& triple) {
+        if (!fits(triple)) {
+            rebuild(std::max(entityBits, std::max(bits(triple.subject), bits(triple.object))),
+                    std::max(relationBits, bits(triple.relation)), slots.size());
+        }
+        if (2 * (numberOfTriples + 1) > slots.size()) {
+            rebuild(entityBits, relationBits, 2 * slots.size());
+        }
+        TripleKey key = pack(triple);
+        uint64_t h = hash(key);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            if (slots[i] == key + 1) {
+                return;
+            }
+            if (slots[i] == 0) {
+                slots[i] = key + 1;
+                break;
+            }
+        }
+        addToBloom(h);
+        ++numberOfTriples;
+    }
+
+    /**
+     * Checks if the triple was inserted
+     * @param triple
+     * @return
+     */
+    bool contains(const Triple& triple) const {
+        if (!fits(triple)) {
+            return false;
+        }
+        TripleKey key = pack(triple);
+        uint64_t h = hash(key);
+        if (!maybeContains(h)) {
+            return false;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            if (slots[i] == key + 1) {
+                return true;
+            }
+            if (slots[i] == 0) {
+                return false;
+            }
+        }
+    }
+
+    /**
+     * Checks the Bloom filter only, false positives are possible but no false negatives
+     * @param triple
+     * @return
+     */
+    bool maybeContains(const Triple& triple) const {
+        return fits(triple) && maybeContains(hash(pack(triple)));
+    }
+
+    size_t size() const {
+        return numberOfTriples;
+    }
+
+    /**
+     * Memory of the hash table and the Bloom filter in bytes
+     * @return
+     */
+    size_t getMemoryUsage() const {
+        return slots.size() * sizeof(TripleKey) + bloom.size() * sizeof(uint64_t);
+    }
+
+private:
+    static const size_t MIN_CAPACITY = 16; /** minimum number of slots, a power of two **/
+    static const size_t WORDS_PER_BLOCK = 8; /** 64 bit words per Bloom filter block (512 bits, one cache line) **/
+    static const int BLOOM_PROBES = 4; /** bits set per key within its block **/
+    static const int MAX_KEY_BITS = 8 * sizeof(TripleKey) - 1; /** bits of a packed key, one less than the key type as slots store key + 1 **/
+
+    int entityBits; /** bits of subject and object ids **/
+    int relationBits; /** bits of relation ids **/
+    size_t numberOfTriples; /** number of distinct triples **/
+    std::vector<TripleKey> slots; /** packed key + 1 of each slot, 0 marks an empty slot; size is a power of two **/
+    std::vector<uint64_t> bloom; /** blocked Bloom filter, 8 words per block; number of blocks is a power of two **/
+
+    static int bits(EntityId id) {
+        int n = 1;
+        while (n < 8 * (int)sizeof(EntityId) - 1 && (id >> n) != 0) {
+            ++n;
+        }
+        return n;
+    }
+
+    bool fits(const Triple& triple) const {
+        return triple.subject >= 0 && triple.object >= 0 && triple.relation >= 0
+               && (triple.subject >> entityBits) == 0 && (triple.object >> entityBits) == 0
+               && (triple.relation >> relationBits) == 0;
+    }
+
+    TripleKey pack(const Triple& triple) const {
+        return ((((TripleKey)triple.subject << relationBits) | (TripleKey)triple.relation) << entityBits) | (TripleKey)triple.object;
+    }
+
+    Triple unpack(TripleKey key) const {
+        TripleKey entityMask = ((TripleKey)1 << entityBits) - 1;
+        TripleKey relationMask = ((TripleKey)1 << relationBits) - 1;
+        return Triple((EntityId)(key >> (entityBits + relationBits)), (RelationId)((key >> entityBits) & relationMask), (EntityId)(key & entityMask));
+    }
+
+#ifdef THRAX_64BIT_IDS
+    /**
+     * Hash of a 128 bit key, combines the hashes of both halves
+     * @param key
+     * @return
+     */
+    static uint64_t hash(TripleKey key) {
+        return hash((uint64_t)key ^ hash((uint64_t)(key >> 64)));
+    }
+#endif
+
+    /**
+     * 64 bit finalizer of MurmurHash3
+     * @param key
+     * @return
+     */
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    /**
+     * The high bits of the hash select the block, four groups of 9 low bits select the bits within the block
+     */
+    bool maybeContains(uint64_t h) const {
+        const uint64_t* block = &bloom[((h >> 40) & (bloom.size() / WORDS_PER_BLOCK - 1)) * WORDS_PER_BLOCK];
+        for (int i = 0; i < BLOOM_PROBES; ++i) {
+            int bit = (h >> (9 * i)) & 511;
+            if ((block[bit >> 6] & (1ULL << (bit & 63))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void addToBloom(uint64_t h) {
+        uint64_t* block = &bloom[((h >> 40) & (bloom.size() / WORDS_PER_BLOCK - 1)) * WORDS_PER_BLOCK];
+        for (int i = 0; i < BLOOM_PROBES; ++i) {
+            int bit = (h >> (9 * i)) & 511;
+            block[bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+
+    /**
+     * Re-packs all keys with new bit widths into a table of the given capacity. The Bloom filter gets 16 bits per
+     * triple at the maximum load factor of 0.5.
+     */
+    void rebuild(int newEntityBits, int newRelationBits, size_t capacity) {
+        if (2 * newEntityBits + newRelationBits > MAX_KEY_BITS) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot pack triples with " << newEntityBits << " entity bits and " << newRelationBits << " relation bits into keys of " << MAX_KEY_BITS << " bits";
+            exit(1);
+        }
+        std::vector<Triple> triples;
+        triples.reserve(numberOfTriples);
+        for (TripleKey slot: slots) {
+            if (slot != 0) {
+                triples.push_back(unpack(slot - 1));
+            }
+        }
+        entityBits = newEntityBits;
+        relationBits = newRelationBits;
+        numberOfTriples = 0;
+        slots.assign(capacity, 0);
+        bloom.assign(std::max((size_t)WORDS_PER_BLOCK, capacity / 8), 0);
+        for (auto& triple: triples) {
+            insert(triple);
+        }
+    }
+};
+
+
+#endif //THRAX_TRIPLEINDEX_H
@@ -0,0 +1,194 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_VOCABULARY_H
+#define THRAX_VOCABULARY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <thrax/struct/Triple.h>
+
+/**
+ * Dictionary of names (entities or relations) with consecutive ids.
+ * Names are stored back to back in a single character arena, the id of a name is found in an open addressing table
+ * of ids and the name of an id is found by its offset into the arena. Data sets share a vocabulary by pointer.
+ */
+template <typename Id>
+class Vocabulary {
+public:
+    Vocabulary(): slots(MIN_CAPACITY, -1) {
+        offsets.push_back(0);
+    }
+
+    /**
+     * Get the id of a name
+     * @param name
+     * @return id, -1 if the name does not exist
+     */
+    Id find(const std::string& name) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(name.data(), name.size()) & mask; ; i = (i + 1) & mask) {
+            if (slots[i] == -1 || equals(slots[i], name.data(), name.size())) {
+                return slots[i];
+            }
+        }
+    }
+
+    /**
+     * Adds a name if it does not exist yet
+     * @param name
+     * @return id of the name
+     */
+    Id add(const std::string& name) {
+        if (2 * (size() + 1) > slots.size()) {
+            rehash(2 * slots.size());
+        }
+        size_t mask = slots.size() - 1;
+        size_t i = hash(name.data(), name.size()) & mask;
+        for (; slots[i] != -1; i = (i + 1) & mask) {
+            if (equals(slots[i], name.data(), name.size())) {
+                return slots[i];
+            }
+        }
+        Id id = size();
+        slots[i] = id;
+        arena.insert(arena.end(), name.begin(), name.end());
+        offsets.push_back(arena.size());
+        return id;
+    }
+
+    /**
+     * Get the name of an id
+     * @param id
+     * @return
+     */
+    std::string getName(Id id) const {
+        return std::string(arena.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    /**
+     * Number of names, ids are 0 to size - 1
+     * @return
+     */
+    Id size() const {
+        return offsets.size() - 1;
+    }
+
+    /**
+     * Memory of the arena, offsets and the hash table in bytes
+     * @return
+     */
+    size_t getMemoryUsage() const {
+        return arena.capacity() + offsets.capacity() * sizeof(size_t) + slots.capacity() * sizeof(Id);
+    }
+
+    /**
+     * Dumps the vocabulary to a file with one line <name><sep><id> per name
+     * @param path
+     * @param sep
+     */
+    void dump(const std::string& path, const std::string& sep=",") const {
+        std::ofstream outf(path);
+        if (!outf.is_open()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not open file " << path << " to dump vocabulary";
+            return;
+        }
+        for (Id id = 0; id < size(); ++id) {
+            outf.write(arena.data() + offsets[id], offsets[id + 1] - offsets[id]);
+            outf << sep << id << "\n";
+        }
+        outf.close();
+    }
+
+    /**
+     * Loads names from a file with one line <name><sep><id> per name, the ids have to be 0 to n - 1.
+     * Replaces the current names.
+     * @param path
+     * @param sep
+     */
+    void load(const std::string& path, const std::string& sep=",") {
+        std::ifstream inf(path);
+        if (!inf.good()) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot find file " << path;
+            return;
+        }
+        std::vector<std::pair<Id, std::string> > entries;
+        std::string line;
+        while (std::getline(inf, line)) {
+            boost::trim(line);
+            size_t pos = line.rfind(sep);
+            if (line.empty() || pos == std::string::npos) continue;
+            entries.push_back(std::make_pair((Id)std::stoll(line.substr(pos + sep.size())), line.substr(0, pos)));
+        }
+        std::sort(entries.begin(), entries.end());
+        clear();
+        for (auto& entry: entries) {
+            if (add(entry.second) != entry.first) {
+                BOOST_LOG_TRIVIAL(error) << "Ids in " << path << " have to be unique and count up from 0, found " << entry.first << " for " << entry.second;
+                exit(1);
+            }
+        }
+    }
+
+    /**
+     * Removes all names
+     */
+    void clear() {
+        arena.clear();
+        offsets.assign(1, 0);
+        slots.assign(MIN_CAPACITY, -1);
+    }
+
+private:
+    static const size_t MIN_CAPACITY = 16; /** minimum number of slots, a power of two **/
+
+    std::vector<char> arena; /** names back to back **/
+    std::vector<size_t> offsets; /** offset of the name of each id in the arena, size + 1 entries **/
+    std::vector<Id> slots; /** id of each slot, -1 marks an empty slot; size is a power of two **/
+
+    bool equals(Id id, const char* name, size_t length) const {
+        return offsets[id + 1] - offsets[id] == length && std::memcmp(arena.data() + offsets[id], name, length) == 0;
+    }
+
+    /**
+     * FNV-1a hash followed by the finalizer of MurmurHash3, so the low bits can be used as slot index
+     */
+    static uint64_t hash(const char* name, size_t length) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; ++i) {
+            h = (h ^ (unsigned char)name[i]) * 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void rehash(size_t capacity) {
+        slots.assign(capacity, -1);
+        size_t mask = capacity - 1;
+        for (Id id = 0; id < size(); ++id) {
+            size_t i = hash(arena.data() + offsets[id], offsets[id + 1] - offsets[id]) & mask;
+            while (slots[i] != -1) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = id;
+        }
+    }
+};
+
+typedef Vocabulary<EntityId> EntityVocabulary;
+typedef Vocabulary<RelationId> RelationVocabulary;
+
+
+#endif //THRAX_VOCABULARY_H
@@ -0,0 +1,207 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_BENCHMARK_H
+#define THRAX_BENCHMARK_H
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <boost/timer/timer.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/lossFunction/LossFunction.h>
+#include <thrax/lossFunction/LossFunctionFactory.h>
+#include <thrax/model/AbstractModel.h>
+#include <thrax/parameterServer/GradientCompressor.h>
+#include <thrax/parameterServer/SparseGradient.h>
+#include <thrax/sampler/Sampler.h>
+#include <thrax/sampler/SamplerFactory.h>
+#include <thrax/struct/Data.h>
+#include <thrax/struct/TripleIndex.h>
+#include <thrax/util/RandomUtil.h>
+
+namespace pt = boost::property_tree;
+
+/**
+ * Microbenchmarks of the data structures
+ */
+class Benchmark {
+public:
+    /**
+     * Measures the lookups per second of the triple membership index, for existing triples and for corrupted triples
+     * (as sampled negatives), and for separate lookups in each data set compared to a merged index.
+     * @param dataSets data sets, the first one is used to draw existing triples
+     * @param numberOfLookups
+     */
+    static void benchmarkTripleIndex(std::vector<Data*> dataSets, int numberOfLookups=1000000) {
+        Data* data = dataSets[0];
+        if (data->getNumberOfTriples() == 0) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot benchmark the triple index without triples";
+            return;
+        }
+        TripleIndex merged;
+        for (auto dataSet: dataSets) {
+            merged.insert(dataSet->getTriples());
+        }
+
+        // existing triples and triples with a corrupted object
+        std::vector<Triple> positives(numberOfLookups);
+        std::vector<Triple> negatives(numberOfLookups);
+        for (int i = 0; i < numberOfLookups; ++i) {
+            positives[i] = data->getTriple(RandomUtil::uniformLong(0, data->getNumberOfTriples()));
+            negatives[i] = positives[i];
+            negatives[i].object = RandomUtil::uniformLong(0, data->getNumberOfEntities());
+        }
+
+        BOOST_LOG_TRIVIAL(info) << "Triple index: " << data->getTripleIndex().size() << " triples, " << data->getTripleIndex().getMemoryUsage() / 1024 << " KiB";
+        BOOST_LOG_TRIVIAL(info) << "Merged triple index: " << merged.size() << " triples, " << merged.getMemoryUsage() / 1024 << " KiB";
+
+        int found = 0;
+        boost::timer::cpu_timer timer;
+        for (auto& triple: positives) {
+            found += data->hasTriple(triple);
+        }
+        logThroughput("existing triples", timer, numberOfLookups, found);
+
+        found = 0;
+        timer.start();
+        for (auto& triple: negatives) {
+            found += data->hasTriple(triple);
+        }
+        logThroughput("corrupted triples", timer, numberOfLookups, found);
+
+        int maybe = 0;
+        for (auto& triple: negatives) {
+            maybe += data->getTripleIndex().maybeContains(triple);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Bloom filter passes " << maybe << " of " << numberOfLookups << " corrupted triples, of which " << found << " exist";
+
+        found = 0;
+        timer.start();
+        for (auto& triple: negatives) {
+            for (auto dataSet: dataSets) {
+                if (dataSet->hasTriple(triple)) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        logThroughput("corrupted triples in " + std::to_string(dataSets.size()) + " separate indices", timer, numberOfLookups, found);
+
+        found = 0;
+        timer.start();
+        for (auto& triple: negatives) {
+            found += merged.contains(triple);
+        }
+        logThroughput("corrupted triples in the merged index", timer, numberOfLookups, found);
+    }
+
+    /**
+     * Compares the bytes per batch of exchanging gradients as dense buffers, as sparse columns in double and float16
+     * precision and after top-k sparsification, and of aggregating the sparse gradients of several workers.
+     * Gradients are computed by the model on batches of training triples with sampled negatives.
+     * @param model
+     * @param data training data
+     * @param config
+     * @param numberOfWorkers number of workers whose gradients are aggregated
+     * @param numberOfBatches number of batches per worker
+     */
+    static void benchmarkGradientExchange(AbstractModel* model, Data* data, pt::ptree& config, int numberOfWorkers=4, int numberOfBatches=50) {
+        int batchSize = config.get<int>("optimizer.batchSize");
+        int numberOfNegatives = config.get<int>("optimizer.sampling.numberOfNegatives");
+        double topK = config.get<double>("model.parameterServer.compression.topK", 0.1);
+        LossFunction* lossFunction = LossFunctionFactory::buildLossFunction(model, config);
+        Sampler* sampler = SamplerFactory::buildSampler(data, config.get_child("optimizer.sampling"), model);
+        bool includePositive = lossFunction->getType() == "softmax";
+
+        size_t denseBytes = 0;
+        for (auto& parameter: model->getParameters()) {
+            denseBytes += parameter.second.size() * sizeof(double);
+        }
+        pt::ptree topKConfig;
+        topKConfig.put("topK", topK);
+        topKConfig.put("precision", "float16");
+        GradientCompressor compressor(topKConfig);
+
+        std::vector<Triple> batchTriples(batchSize);
+        std::vector<Triple*> positives(batchSize);
+        std::vector<std::vector<Triple> > negatives(batchSize, std::vector<Triple>(numberOfNegatives + (includePositive ? 1 : 0)));
+        double sparseBytes = 0.0;
+        double halfBytes = 0.0;
+        double topKBytes = 0.0;
+        double aggregatedBytes = 0.0;
+        double halfError = 0.0;
+        int measuredErrors = 0;
+        double columns = 0.0;
+        double aggregatedColumns = 0.0;
+        boost::timer::cpu_timer aggregationTimer;
+        aggregationTimer.stop();
+        for (int batch = 0; batch < numberOfBatches; ++batch) {
+            std::map<std::string, std::vector<SparseGradient> > workerGradients;
+            for (int worker = 0; worker < numberOfWorkers; ++worker) {
+                model->resetGradients();
+                sampler->preBatch();
+                for (int i = 0; i < batchSize; ++i) {
+                    batchTriples[i] = data->getTriple(RandomUtil::uniformLong(0, data->getNumberOfTriples()));
+                    positives[i] = &batchTriples[i];
+                    sampler->sample(batchTriples[i], negatives[i].begin());
+                    if (includePositive) {
+                        negatives[i][numberOfNegatives] = batchTriples[i];
+                    }
+                }
+                lossFunction->gradient(positives, negatives);
+                for (auto& gradient: model->getGradients()) {
+                    SparseGradient sparse = SparseGradient::fromGradient(gradient.second);
+                    sparseBytes += sparse.getEncodedSize(false);
+                    halfBytes += sparse.getEncodedSize(true);
+                    columns += sparse.size();
+                    SparseGradient rounded = sparse;
+                    rounded.roundToHalf();
+                    double norm = sparse.getValues().norm();
+                    if (norm > 0.0) {
+                        halfError += (sparse.getValues() - rounded.getValues()).norm() / norm;
+                        ++measuredErrors;
+                    }
+                    SparseGradient compressed = sparse;
+                    compressor.compress(gradient.first, compressed);
+                    topKBytes += compressed.getEncodedSize(true);
+                    workerGradients[gradient.first].push_back(sparse);
+                }
+            }
+            aggregationTimer.resume();
+            for (auto& gradients: workerGradients) {
+                std::vector<const SparseGradient*> pointers;
+                for (auto& gradient: gradients.second) {
+                    pointers.push_back(&gradient);
+                }
+                SparseGradient aggregated = SparseGradient::aggregate(pointers);
+                aggregatedBytes += aggregated.getEncodedSize(false);
+                aggregatedColumns += aggregated.size();
+            }
+            aggregationTimer.stop();
+        }
+        delete lossFunction;
+        delete sampler;
+
+        double gradients = (double)numberOfWorkers * numberOfBatches;
+        BOOST_LOG_TRIVIAL(info) << "Gradient exchange of " << numberOfWorkers << " workers, " << numberOfBatches << " batches of " << batchSize << " triples";
+        BOOST_LOG_TRIVIAL(info) << "Dense gradients: " << denseBytes / 1024.0 << " KiB per batch";
+        BOOST_LOG_TRIVIAL(info) << "Sparse gradients: " << sparseBytes / gradients / 1024.0 << " KiB per batch (" << 100.0 * sparseBytes / gradients / denseBytes << "% of dense), " << columns / gradients << " columns";
+        BOOST_LOG_TRIVIAL(info) << "Sparse float16 gradients: " << halfBytes / gradients / 1024.0 << " KiB per batch (" << 100.0 * halfBytes / gradients / denseBytes << "% of dense), relative error " << halfError / std::max(1, measuredErrors);
+        BOOST_LOG_TRIVIAL(info) << "Top " << topK << " float16 gradients with error feedback: " << topKBytes / gradients / 1024.0 << " KiB per batch (" << 100.0 * topKBytes / gradients / denseBytes << "% of dense)";
+        BOOST_LOG_TRIVIAL(info) << "Aggregated sparse gradients: " << aggregatedBytes / numberOfBatches / 1024.0 << " KiB per batch of all workers, " << aggregatedColumns / numberOfBatches << " columns, " << numberOfBatches / (aggregationTimer.elapsed().wall / 1000000000.0) << " aggregations per second";
+    }
+
+private:
+    static void logThroughput(const std::string& name, boost::timer::cpu_timer& timer, int numberOfLookups, int found) {
+        timer.stop();
+        double seconds = timer.elapsed().wall / 1000000000.0;
+        BOOST_LOG_TRIVIAL(info) << "Lookups of " << name << ": " << numberOfLookups / seconds << " per second (" << found << " found)";
+    }
+};
+
+
+#endif //THRAX_BENCHMARK_H
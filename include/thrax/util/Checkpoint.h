@@ -0,0 +1,287 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_CHECKPOINT_H
+#define THRAX_CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <thrax/model/AbstractModel.h>
+#include <thrax/model/EmbeddingParameterSet.h>
+#include <thrax/parameterServer/Message.h>
+
+namespace fs = boost::filesystem;
+
+/**
+ * Binary checkpoint of the full training state in a directory: the matrices of AbstractModel::getTrainingState, the
+ * scalar state of the model and the state of the optimizer.
+ *
+ * Each matrix is stored in its own file as a sequence of records: the number of rows and columns and the number of
+ * stored columns n as 64 bit integers, the n column ids and the n columns. The first record holds all columns, later
+ * records only the columns that changed since the previous checkpoint, detected by a hash of each column. Loading
+ * applies the records in order. Once the records of a file are larger than two full records, the file is replaced by
+ * a new file with a single full record.
+ *
+ * The index file state.bin holds the scalar state and the file and valid length of each matrix. It is written last and
+ * renamed into place, so a checkpoint that is interrupted while writing leaves the previous checkpoint intact: records
+ * beyond the valid length are discarded when loading.
+ */
+class Checkpoint {
+public:
+    Checkpoint(std::string directory): directory(directory) {}
+
+    /**
+     * Writes a checkpoint
+     * @param model
+     * @param optimizerState scalar state of the optimizer
+     */
+    void save(AbstractModel* model, Message& optimizerState) {
+        fs::create_directories(directory);
+        Message index;
+        uint32_t version = VERSION;
+        index.write(version);
+        writeMessage(index, optimizerState);
+        Message modelState;
+        model->saveTrainingState(modelState);
+        writeMessage(index, modelState);
+        std::map<std::string, EmbeddingParameterSet*> matrices = model->getTrainingState();
+        index.write<uint32_t>(matrices.size());
+        std::vector<std::string> replaced;
+        uint64_t bytes = 0;
+        for (auto& matrix: matrices) {
+            MatrixFile& file = files[matrix.first];
+            std::string previous = file.name;
+            bytes += saveMatrix(matrix.first, *matrix.second, file);
+            if (!previous.empty() && previous != file.name) {
+                replaced.push_back(previous);
+            }
+            index.writeString(matrix.first);
+            index.writeString(file.name);
+            index.write<uint64_t>(file.length);
+        }
+        fs::path indexPath = fs::path(directory) / "state.bin";
+        fs::path temporaryPath = fs::path(directory) / "state.bin.tmp";
+        writeFile(temporaryPath.string(), index);
+        fs::rename(temporaryPath, indexPath);
+        // files replaced by full records are not referenced anymore
+        for (auto& name: replaced) {
+            fs::remove(fs::path(directory) / name);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Wrote checkpoint to " << directory << ": " << bytes / 1024 << " KiB of changed columns";
+    }
+
+    /**
+     * Loads the last complete checkpoint into the model
+     * @param model
+     * @param optimizerState receives the scalar state of the optimizer
+     */
+    void load(AbstractModel* model, Message& optimizerState) {
+        fs::path indexPath = fs::path(directory) / "state.bin";
+        Message index;
+        if (!readFile(indexPath.string(), index)) {
+            BOOST_LOG_TRIVIAL(error) << "Could not find a checkpoint in " << directory;
+            exit(1);
+        }
+        uint32_t version = index.read<uint32_t>();
+        if (version != VERSION) {
+            BOOST_LOG_TRIVIAL(error) << "Checkpoint version " << version << " in " << directory << " is not supported, expected " << VERSION;
+            exit(1);
+        }
+        readMessage(index, optimizerState);
+        Message modelState;
+        readMessage(index, modelState);
+        model->loadTrainingState(modelState);
+        std::map<std::string, EmbeddingParameterSet*> matrices = model->getTrainingState();
+        uint32_t numberOfMatrices = index.read<uint32_t>();
+        if (numberOfMatrices != matrices.size()) {
+            BOOST_LOG_TRIVIAL(error) << "Checkpoint in " << directory << " holds " << numberOfMatrices << " matrices, the model has " << matrices.size() << ", use the config of the checkpointed run";
+            exit(1);
+        }
+        files.clear();
+        for (uint32_t i = 0; i < numberOfMatrices; ++i) {
+            std::string name = index.readString();
+            MatrixFile& file = files[name];
+            file.name = index.readString();
+            file.length = index.read<uint64_t>();
+            if (matrices.count(name) == 0) {
+                BOOST_LOG_TRIVIAL(error) << "Checkpoint in " << directory << " holds matrix " << name << ", which the model does not have";
+                exit(1);
+            }
+            loadMatrix(name, *matrices.at(name), file);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Loaded checkpoint from " << directory;
+    }
+
+private:
+    static const uint32_t VERSION = 1; /** version of the file format **/
+
+    /**
+     * File of a matrix
+     */
+    struct MatrixFile {
+        std::string name; /** file name in the checkpoint directory, empty if not written yet **/
+        uint64_t length = 0; /** number of valid bytes **/
+        int generation = 0; /** number of files of the matrix so far, part of the file name **/
+        std::vector<uint64_t> hashes; /** hash of each column as of the last checkpoint **/
+    };
+
+    std::string directory; /** directory of the checkpoint **/
+    std::map<std::string, MatrixFile> files; /** file of each matrix by name **/
+
+    /**
+     * Appends the changed columns of a matrix to its file, or starts a new file with all columns
+     * @param name
+     * @param matrix
+     * @param file
+     * @return number of bytes written
+     */
+    uint64_t saveMatrix(const std::string& name, const EmbeddingParameterSet& matrix, MatrixFile& file) {
+        std::vector<uint64_t> hashes(matrix.cols());
+        std::vector<int64_t> changed;
+        for (long id = 0; id < matrix.cols(); ++id) {
+            hashes[id] = hashColumn(matrix.col(id).data(), matrix.rows());
+            if (file.hashes.size() != hashes.size() || file.hashes[id] != hashes[id]) {
+                changed.push_back(id);
+            }
+        }
+        file.hashes.swap(hashes);
+        uint64_t fullLength = recordLength(matrix.rows(), matrix.cols());
+        bool full = file.name.empty() || changed.size() == matrix.cols() || file.length + recordLength(matrix.rows(), changed.size()) > 2 * fullLength;
+        if (!full && changed.empty()) {
+            return 0;
+        }
+        std::ofstream out;
+        if (full) {
+            changed.resize(matrix.cols());
+            for (long id = 0; id < matrix.cols(); ++id) {
+                changed[id] = id;
+            }
+            file.name = name + "." + std::to_string(file.generation++) + ".bin";
+            file.length = 0;
+            out.open((fs::path(directory) / file.name).string(), std::ios::binary | std::ios::trunc);
+        } else {
+            out.open((fs::path(directory) / file.name).string(), std::ios::binary | std::ios::app);
+        }
+        if (!out.is_open()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not open file " << file.name << " in " << directory << " to write a checkpoint";
+            exit(1);
+        }
+        int64_t header[3] = {matrix.rows(), matrix.cols(), (int64_t)changed.size()};
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)changed.data(), sizeof(int64_t) * changed.size());
+        for (int64_t id: changed) {
+            out.write((const char*)matrix.col(id).data(), sizeof(double) * matrix.rows());
+        }
+        out.close();
+        if (out.fail()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not write checkpoint of " << name << " to " << directory;
+            exit(1);
+        }
+        uint64_t length = recordLength(matrix.rows(), changed.size());
+        file.length += length;
+        return length;
+    }
+
+    /**
+     * Applies the valid records of the file of a matrix and drops the records of an interrupted checkpoint
+     * @param name
+     * @param matrix
+     * @param file
+     */
+    void loadMatrix(const std::string& name, EmbeddingParameterSet& matrix, MatrixFile& file) {
+        fs::path path = fs::path(directory) / file.name;
+        std::ifstream in(path.string(), std::ios::binary);
+        uint64_t position = 0;
+        std::vector<int64_t> ids;
+        while (position < file.length) {
+            int64_t header[3];
+            if (!in.read((char*)header, sizeof(header)) || header[0] != matrix.rows() || header[1] != matrix.cols()) {
+                BOOST_LOG_TRIVIAL(error) << "Checkpoint of " << name << " in " << path.string() << " does not fit the " << matrix.rows() << " x " << matrix.cols() << " matrix of the model";
+                exit(1);
+            }
+            ids.resize(header[2]);
+            in.read((char*)ids.data(), sizeof(int64_t) * ids.size());
+            for (int64_t id: ids) {
+                in.read((char*)matrix.col(id).data(), sizeof(double) * matrix.rows());
+            }
+            if (!in) {
+                BOOST_LOG_TRIVIAL(error) << "Checkpoint of " << name << " in " << path.string() << " is truncated";
+                exit(1);
+            }
+            position += recordLength(matrix.rows(), ids.size());
+        }
+        in.close();
+        fs::resize_file(path, file.length);
+        // the generation is the number after the name in the file name
+        std::string suffix = file.name.substr(name.size() + 1);
+        file.generation = std::stoi(suffix.substr(0, suffix.find('.'))) + 1;
+        file.hashes.resize(matrix.cols());
+        for (long id = 0; id < matrix.cols(); ++id) {
+            file.hashes[id] = hashColumn(matrix.col(id).data(), matrix.rows());
+        }
+    }
+
+    static uint64_t recordLength(long rows, long n) {
+        return 3 * sizeof(int64_t) + n * (sizeof(int64_t) + rows * sizeof(double));
+    }
+
+    /**
+     * FNV-1a hash of the bits of a column
+     * @param values
+     * @param n
+     * @return
+     */
+    static uint64_t hashColumn(const double* values, long n) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (long i = 0; i < n; ++i) {
+            uint64_t bits;
+            std::memcpy(&bits, values + i, sizeof(bits));
+            hash = (hash ^ bits) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    static void writeMessage(Message& target, Message& message) {
+        target.write<uint64_t>(message.size());
+        target.write(message.getBuffer().data(), message.size());
+    }
+
+    static void readMessage(Message& source, Message& message) {
+        message.clear();
+        message.getBuffer().resize(source.read<uint64_t>());
+        source.read(message.getBuffer().data(), message.size());
+    }
+
+    static void writeFile(const std::string& path, Message& message) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(message.getBuffer().data(), message.size());
+        out.close();
+        if (out.fail()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not write checkpoint file " << path;
+            exit(1);
+        }
+    }
+
+    static bool readFile(const std::string& path, Message& message) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) {
+            return false;
+        }
+        message.clear();
+        message.getBuffer().resize(in.tellg());
+        in.seekg(0);
+        return (bool)in.read(message.getBuffer().data(), message.size());
+    }
+};
+
+
+#endif //THRAX_CHECKPOINT_H
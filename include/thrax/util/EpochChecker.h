@@ -0,0 +1,79 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_EPOCHCHECKER_H
+#define THRAX_EPOCHCHECKER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <boost/log/trivial.hpp>
+
+#include "SharedMemory.h"
+#include "Typedefs.h"
+
+/**
+ * Checks that an epoch visits every training triple exactly once, including the epochs of partitioned training and of
+ * forked worker processes. The visits are counted in shared memory, so the counter has to be created before the
+ * workers are forked.
+ */
+class EpochChecker {
+public:
+    explicit EpochChecker(TripleId numberOfTriples):
+    numberOfTriples(numberOfTriples) {
+        visits = (std::atomic<uint32_t>*)SharedMemory::allocate(bytes());
+    }
+
+    ~EpochChecker() {
+        SharedMemory::release(visits, bytes());
+    }
+
+    /**
+     * Counts a visit of a triple in a batch
+     * @param index index of the training triple
+     */
+    void visit(TripleId index) {
+        if (index >= numberOfTriples) {
+            BOOST_LOG_TRIVIAL(error) << "Epoch check: batch contains triple " << index << " of " << numberOfTriples << " training triples";
+            exit(1);
+        }
+        visits[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Checks that every triple was visited exactly once since the last check and resets the counters
+     * @param epoch index of the checked epoch
+     */
+    void check(int epoch) {
+        TripleId missed = 0;
+        TripleId repeated = 0;
+        TripleId first = numberOfTriples;
+        for (TripleId i = 0; i < numberOfTriples; ++i) {
+            uint32_t count = visits[i].exchange(0, std::memory_order_relaxed);
+            if (count != 1) {
+                missed += count == 0 ? 1 : 0;
+                repeated += count > 1 ? 1 : 0;
+                first = std::min(first, i);
+            }
+        }
+        if (first < numberOfTriples) {
+            BOOST_LOG_TRIVIAL(error) << "Epoch check: epoch " << epoch + 1 << " missed " << missed << " and repeated " << repeated
+                                     << " of " << numberOfTriples << " training triples, first wrong triple: " << first;
+            exit(1);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Epoch check: epoch " << epoch + 1 << " visited all " << numberOfTriples << " training triples once";
+    }
+
+private:
+    TripleId numberOfTriples; /** number of training triples **/
+    std::atomic<uint32_t>* visits; /** number of visits of each triple in the current epoch, in shared memory **/
+
+    size_t bytes() const {
+        return numberOfTriples * sizeof(std::atomic<uint32_t>);
+    }
+};
+
+
+#endif //THRAX_EPOCHCHECKER_H
\ No newline at end of file
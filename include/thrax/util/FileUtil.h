@@ -9,18 +9,26 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 
 #include <Eigen/Dense>
+#include <omp.h>
 
+#include <algorithm>
 #include <fstream>
+#include <regex>
 #include <vector>
 
 #include <thrax/struct/Triple.h>
-#include <thrax/struct/DataContainer.h>
+#include <thrax/struct/Vocabulary.h>
 #include <thrax/util/Typedefs.h>
 
 namespace pt = boost::property_tree;
 namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
 using namespace Eigen;
 
 /**
@@ -28,108 +36,252 @@ using namespace Eigen;
  */
 namespace FileUtil {
     /**
-     * Loads triple data from a file. Each line is one triple of format <subject><sep><relation><sep><object>
-     * @param path path to file
-     * @param entityMap map from entity name -> entity id
-     * @param relationMap map from relation name -> relation id
-     * @param triples vector of triples
-     * @param sep separtor, default: tab
+     * Exits if an entity id does not fit into the entity field of a packed triple
+     * @param id
      */
-    void loadData(const std::string path,
-                  std::unordered_map<std::string, int> &entityMap,
-                  std::unordered_map<std::string, int> &relationMap,
-                  std::vector<Triple> &triples,
-                  DataContainer &multiIndex,
-                  Pair2ListMap &subjectRelation2Object,
-                  Pair2ListMap &relationObject2Subject,
-                  std::unordered_map<int, std::vector<int> > &relation2Subject,
-                  std::unordered_map<int, std::vector<int> > &relation2Object,
-                  int limit,
-                  bool ignoreNewConstituents,
-                  const std::string sep="\t") {
-        std::ifstream file(path);
-        if (!file.good()) {
-            BOOST_LOG_TRIVIAL(error) << "Cannot find file " << path << std::endl;
+    inline void checkEntityId(EntityId id) {
+        if ((uint64_t)id >> PackedTriple::ENTITY_BITS != 0) {
+            BOOST_LOG_TRIVIAL(error) << "More than 2^" << PackedTriple::ENTITY_BITS << " entities are not supported";
             exit(1);
         }
+    }
 
-        int numTriples = 0;
-        std::string line;
-        std::vector<std::string> splits;
-        int subjectId, relationId, objectId;
-        std::unordered_map<std::string, int>::iterator it;
+    /**
+     * Expands a path to the files it denotes: all files of a directory, the files matching a glob pattern with * and ?
+     * in the file name, or the file itself. The files are sorted by name, so shards are always read in the same order.
+     * @param path
+     * @return
+     */
+    std::vector<std::string> expandPaths(const std::string& path) {
+        std::vector<std::string> paths;
+        fs::path p(path);
+        std::string pattern = p.filename().string();
+        if (fs::is_directory(p)) {
+            for (fs::directory_iterator it(p), end; it != end; ++it) {
+                if (fs::is_regular_file(it->status())) {
+                    paths.push_back(it->path().string());
+                }
+            }
+        } else if (pattern.find_first_of("*?") != std::string::npos) {
+            // translate the glob pattern into a regular expression
+            std::string expression;
+            for (char c: pattern) {
+                if (c == '*') {
+                    expression += ".*";
+                } else if (c == '?') {
+                    expression += ".";
+                } else if (std::string("\\^$.|+()[]{}").find(c) != std::string::npos) {
+                    expression += std::string("\\") + c;
+                } else {
+                    expression += c;
+                }
+            }
+            std::regex regex(expression);
+            fs::path dir = p.has_parent_path() ? p.parent_path() : fs::path(".");
+            if (fs::is_directory(dir)) {
+                for (fs::directory_iterator it(dir), end; it != end; ++it) {
+                    if (fs::is_regular_file(it->status()) && std::regex_match(it->path().filename().string(), regex)) {
+                        paths.push_back(it->path().string());
+                    }
+                }
+            }
+        } else {
+            paths.push_back(path);
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
 
-        while (std::getline(file, line)) {
-            boost::trim(line);
-            if (line.length() < 1) continue;
+    /**
+     * Opens a file for reading, files ending with .gz or .zst are decompressed while reading
+     * @param path
+     * @param in
+     */
+    void openInput(const std::string& path, io::filtering_istream& in) {
+        if (boost::algorithm::ends_with(path, ".gz")) {
+            in.push(io::gzip_decompressor());
+        } else if (boost::algorithm::ends_with(path, ".zst") || boost::algorithm::ends_with(path, ".zstd")) {
+            in.push(io::zstd_decompressor());
+        }
+        in.push(io::file_source(path, std::ios_base::in | std::ios_base::binary));
+    }
 
-            boost::split(splits, line, boost::is_any_of(sep)); // split into subject, relation, object
+    /**
+     * Triples of one input file, mapped with vocabularies local to the file
+     */
+    struct Shard {
+        EntityVocabulary entities;
+        RelationVocabulary relations;
+        std::vector<Triple> triples;
+    };
 
-            for (std::vector<int>::size_type i = 0; i != splits.size(); i++) {
-                boost::trim(splits[i]);
-            }
+    /**
+     * Reads the first limit triples of a file into a shard
+     * @param path
+     * @param shard
+     * @param limit maximum number of triples, -1 reads all
+     * @param sep
+     * @return whether the file could be read
+     */
+    bool loadShard(const std::string& path, Shard& shard, TripleId limit, const std::string& sep) {
+        try {
+            io::filtering_istream file;
+            openInput(path, file);
+            std::string line;
+            std::vector<std::string> splits;
+            while ((limit < 0 || shard.triples.size() < limit) && std::getline(file, line)) {
+                boost::trim(line);
+                if (line.length() < 1) continue;
+
+                boost::split(splits, line, boost::is_any_of(sep)); // split into subject, relation, object
 
-            // map subject
-            it = entityMap.find(splits[0]);
-            if (it == entityMap.end()) {
-                if (ignoreNewConstituents) {
-                    // ignore triple with non-existent constituent
-                    continue;
+                for (std::vector<int>::size_type i = 0; i != splits.size(); i++) {
+                    boost::trim(splits[i]);
                 }
-                // entity not yet mapped, add to map
-                subjectId = entityMap.size();
-                entityMap[splits[0]] = subjectId;
-            } else {
-                subjectId = it->second;
-            }
 
-            // map relation
-            it = relationMap.find(splits[1]);
-            if (it == relationMap.end()) {
-                if (ignoreNewConstituents) {
-                    // ignore triple with non-existent constituent
-                    continue;
+#ifdef THRAX_64BIT_IDS
+                // entity ids of a shard are at most the number of triples, so only relations need to be checked
+                if (shard.relations.find(splits[1]) == -1 && shard.relations.size() >> PackedTriple::RELATION_BITS != 0) {
+                    BOOST_LOG_TRIVIAL(error) << "More than 2^" << PackedTriple::RELATION_BITS << " relations are not supported";
+                    return false;
                 }
-                // relation not yet mapped, add to map
-                relationId = relationMap.size();
-                relationMap[splits[1]] = relationId;
-            } else {
-                relationId = it->second;
+#endif
+                EntityId subjectId = shard.entities.add(splits[0]);
+                RelationId relationId = shard.relations.add(splits[1]);
+                EntityId objectId = shard.entities.add(splits[2]);
+                shard.triples.push_back(Triple(subjectId, relationId, objectId));
             }
+        } catch (std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot read file " << path << ": " << e.what();
+            return false;
+        }
+        return true;
+    }
 
-            // map object
-            it = entityMap.find(splits[2]);
-            if (it == entityMap.end()) {
-                if (ignoreNewConstituents) {
-                    // ignore triple with non-existent constituent
-                    continue;
-                }
-                // entity not yet mapped, add to map
-                objectId = entityMap.size();
-                entityMap[splits[2]] = objectId;
-            } else {
-                objectId = it->second;
+    /**
+     * Loads triple data from a file, a directory of files or a glob pattern of files. Files ending with .gz or .zst are
+     * decompressed while reading. Each line is one triple of format <subject><sep><relation><sep><object>.
+     * Files are read in parallel, each with its own vocabularies, and then mapped to the given vocabularies in order of
+     * the file names, so ids are the same as when reading the files one after the other. Only one file per thread is
+     * held in memory at a time: the files are read in batches, and each batch is mapped before the next one is read.
+     * @param path path to file, directory or glob pattern
+     * @param entities vocabulary of entity name -> entity id
+     * @param relations vocabulary of relation name -> relation id
+     * @param triples vector of triples
+     * @param sep separtor, default: tab
+     */
+    void loadData(const std::string path,
+                  EntityVocabulary &entities,
+                  RelationVocabulary &relations,
+                  std::vector<PackedTriple> &triples,
+                  TripleId limit,
+                  bool ignoreNewConstituents,
+                  const std::string sep="\t") {
+        std::vector<std::string> paths = expandPaths(path);
+        if (paths.empty()) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot find files matching " << path << std::endl;
+            exit(1);
+        }
+        for (auto& shardPath: paths) {
+            if (!fs::is_regular_file(shardPath)) {
+                BOOST_LOG_TRIVIAL(error) << "Cannot find file " << shardPath << std::endl;
+                exit(1);
             }
+        }
+        if (paths.size() > 1) {
+            BOOST_LOG_TRIVIAL(info) << "Reading " << paths.size() << " files";
+        }
 
-            // count triples
-            ++numTriples;
+        TripleId numTriples = 0;
+        const EntityId UNRESOLVED = -2;
+        int batchSize = omp_get_max_threads();
+        std::vector<Shard> shards;
+        for (int first = 0; first < paths.size(); first += batchSize) {
+            // read and tokenize a batch of files in parallel
+            int last = std::min<int>(first + batchSize, paths.size());
+            shards.assign(last - first, Shard());
+            // triples with new constituents are dropped while mapping, so the limit can only be applied to the lines of
+            // a file if every line becomes a triple; otherwise the mapping stops after limit triples
+            TripleId shardLimit = ignoreNewConstituents ? -1 : limit;
+            bool success = true;
+            #pragma omp parallel for schedule(dynamic) reduction(&&:success)
+            for (int i = first; i < last; ++i) {
+                success = loadShard(paths[i], shards[i - first], shardLimit, sep) && success;
+            }
+            if (!success) {
+                exit(1);
+            }
 
-            // finally add mapped triple
-            multiIndex.insert(Triple(subjectId, relationId, objectId));
-            triples.push_back(Triple(subjectId, relationId, objectId));
-            subjectRelation2Object[std::make_pair(subjectId, relationId)].push_back(objectId);
-            relationObject2Subject[std::make_pair(relationId, objectId)].push_back(subjectId);
-            relation2Subject[relationId].push_back(subjectId);
-            relation2Object[relationId].push_back(objectId);
+            // map the local ids of each shard, names are resolved on their first occurrence
+            for (auto& shard: shards) {
+                std::vector<EntityId> entityIds(shard.entities.size(), UNRESOLVED);
+                std::vector<RelationId> relationIds(shard.relations.size(), UNRESOLVED);
+                auto mapEntity = [&](EntityId local) {
+                    if (entityIds[local] == UNRESOLVED) {
+                        std::string name = shard.entities.getName(local);
+                        entityIds[local] = entities.find(name);
+                        if (entityIds[local] == -1 && !ignoreNewConstituents) {
+                            // entity not yet mapped, add to vocabulary
+                            checkEntityId(entities.size());
+                            entityIds[local] = entities.add(name);
+                        }
+                    }
+                    return entityIds[local];
+                };
+                auto mapRelation = [&](RelationId local) {
+                    if (relationIds[local] == UNRESOLVED) {
+                        std::string name = shard.relations.getName(local);
+                        relationIds[local] = relations.find(name);
+                        if (relationIds[local] == -1 && !ignoreNewConstituents) {
+                            // relation not yet mapped, add to vocabulary
+#ifdef THRAX_64BIT_IDS
+                            if (relations.size() >> PackedTriple::RELATION_BITS != 0) {
+                                BOOST_LOG_TRIVIAL(error) << "More than 2^" << PackedTriple::RELATION_BITS << " relations are not supported";
+                                exit(1);
+                            }
+#endif
+                            relationIds[local] = relations.add(name);
+                        }
+                    }
+                    return relationIds[local];
+                };
 
-            BOOST_LOG_TRIVIAL(trace) << "<" << subjectId << "><" << relationId << "><" << objectId << ">, <" << splits[0] << "><" << splits[1] << "><" << splits[2] << ">";
+                for (Triple& local: shard.triples) {
+                    // ignore triples with non-existent constituents
+                    EntityId subjectId = mapEntity(local.subject);
+                    if (subjectId == -1) continue;
+                    RelationId relationId = mapRelation(local.relation);
+                    if (relationId == -1) continue;
+                    EntityId objectId = mapEntity(local.object);
+                    if (objectId == -1) continue;
 
-            if (limit > -1 && limit == numTriples) break;
-        }
+                    // count triples
+                    ++numTriples;
+
+                    // finally add mapped triple
+                    triples.push_back(PackedTriple(Triple(subjectId, relationId, objectId)));
 
-        file.close();
+                    BOOST_LOG_TRIVIAL(trace) << "<" << subjectId << "><" << relationId << "><" << objectId << ">, <" << shard.entities.getName(local.subject) << "><" << shard.relations.getName(local.relation) << "><" << shard.entities.getName(local.object) << ">";
+
+                    if (limit > -1 && limit == numTriples) return;
+                }
+                // release the shard
+                shard = Shard();
+            }
+        }
     };
 
+    /**
+     * Writes the transpose of the given matrix M to a stream in the format of dumpMatrix, without a newline after the
+     * last row, e.g. to dump a matrix in blocks of columns
+     * @param out
+     * @param M
+     * @param sep
+     */
+    void dumpMatrix(std::ostream& out, const Ref<const MatrixXd>& M, std::string sep=",") {
+        out << M.transpose().format(IOFormat(FullPrecision, DontAlignCols, sep, "\n", "", "", "", ""));
+    }
+
     /**
      * Dumps the transpose of the given matrix M to file (easier to load in column major format)
      * @param path
@@ -137,10 +289,10 @@ namespace FileUtil {
      * @param sep
      * @param rowSep
      */
-    void dumpMatrix(std::string path, MatrixXd& M, std::string sep=",") {
+    void dumpMatrix(std::string path, const Ref<const MatrixXd>& M, std::string sep=",") {
         std::ofstream outf(path);
         if (outf.is_open()) {
-            outf << M.transpose().format(IOFormat(FullPrecision, DontAlignCols, sep, "\n", "", "", "", ""));
+            dumpMatrix(outf, M, sep);
         } else {
             BOOST_LOG_TRIVIAL(error) << "Could not open file " << path << " to dump matrix";
         }
@@ -154,7 +306,8 @@ namespace FileUtil {
      * @param sep
      * @param rowSep
      */
-    void loadMatrix(std::string path, MatrixXd& M, std::string sep=",") {
+    template <typename Matrix>
+    void loadMatrix(std::string path, Matrix& M, std::string sep=",") {
         std::ifstream inf(path);
         std::string line;
         std::vector<double> values;
@@ -167,36 +320,46 @@ namespace FileUtil {
             }
             ++cols;
         }
+        M.resize(values.size()/cols, cols);
         M = Map<MatrixXd>(values.data(), values.size()/cols, cols);
     }
 
     /**
-     * Dump a map to given path
+     * Dumps n columns of M starting at column first to a binary file: number of rows and columns as 64 bit integers,
+     * followed by the values in column major order
      * @param path
-     * @param map
-     * @param sep
+     * @param M
+     * @param first
+     * @param n
      */
-    void dumpMap(std::string path, std::unordered_map<std::string, int>& map, std::string sep=",") {
-        std::ofstream outf(path);
-        if (outf.is_open()) {
-            for (auto& kv: map) {
-                outf << kv.first << sep << kv.second << std::endl;
-            }
-        } else {
-            BOOST_LOG_TRIVIAL(error) << "Could not open file " << path << " to dump map";
+    void dumpBinaryColumns(std::string path, const Ref<const MatrixXd>& M, long first, long n) {
+        std::ofstream outf(path, std::ios::binary);
+        if (!outf.is_open()) {
+            BOOST_LOG_TRIVIAL(error) << "Could not open file " << path << " to dump matrix";
+            exit(1);
         }
+        int64_t header[2] = {M.rows(), n};
+        outf.write((const char*)header, sizeof(header));
+        outf.write((const char*)(M.data() + first * M.rows()), sizeof(double) * M.rows() * n);
         outf.close();
     }
 
-    void loadMap(std::string path, std::unordered_map<std::string, int>& map, std::string sep=",") {
-        std::ifstream inf(path);
-        std::string line;
-        std::vector<std::string> splits;
-        while (std::getline(inf, line)) {
-            boost::trim(line);
-            boost::split(splits, line, boost::is_any_of(sep)); // split into key, value
-            map[splits[0]] = std::stoi(splits[1]);
+    /**
+     * Loads the first n columns of a binary file written by dumpBinaryColumns into M starting at column first
+     * @param path
+     * @param M
+     * @param first
+     * @param n
+     */
+    void loadBinaryColumns(std::string path, Ref<MatrixXd> M, long first, long n) {
+        std::ifstream inf(path, std::ios::binary);
+        int64_t header[2];
+        if (!inf.read((char*)header, sizeof(header)) || header[0] != M.rows() || header[1] < n) {
+            BOOST_LOG_TRIVIAL(error) << "Could not load " << n << " columns of " << M.rows() << " rows from " << path;
+            exit(1);
         }
+        inf.read((char*)(M.data() + first * M.rows()), sizeof(double) * M.rows() * n);
+        inf.close();
     }
 
     void dumpConfig(std::string path, pt::ptree config) {
@@ -207,15 +370,15 @@ namespace FileUtil {
         pt::write_json(configPath.string(), config);
     }
 
-    void dumpTrainingStatistics(std::string path, std::vector<double>& losses, std::vector<double>& times, std::vector<double>& mrrs, int& epochsTrained) {
+    void dumpTrainingStatistics(std::string path, std::vector<double>& losses, std::vector<double>& times, std::vector<double>& mrrs, std::vector<double>& gradientCalls, int& epochsTrained) {
         fs::path dir(path);
         fs::create_directories(dir);
         fs::path statsPath = dir / "stats.csv";
         std::ofstream outf(statsPath.string());
         if (outf.is_open()) {
-            outf << "epoch,loss,time,mrr" << std::endl;
+            outf << "epoch,loss,time,mrr,gradientCalls" << std::endl;
             for (int i = 0; i < epochsTrained; ++i) {
-                outf << i << "," << losses[i] << "," << times[i] << "," << mrrs[i] << std::endl;
+                outf << i << "," << losses[i] << "," << times[i] << "," << mrrs[i] << "," << gradientCalls[i] << std::endl;
             }
         } else {
             BOOST_LOG_TRIVIAL(error) << "Could not open file " << path << " to dump training statistics";
@@ -5,12 +5,42 @@
 #ifndef THRAX_RANDOMUTIL_H
 #define THRAX_RANDOMUTIL_H
 
+#include <cstdint>
 #include <random>
+#include <sstream>
+#include <string>
 
 namespace RandomUtil {
     std::random_device rd;
     std::mt19937 gen(rd());
 
+    /**
+     * Re-seeds the generator, e.g. in a forked worker process that must not repeat the samples of the others
+     * @param seed
+     */
+    inline void seed(unsigned seed) {
+        gen.seed(seed);
+    }
+
+    /**
+     * Get the state of the generator, e.g. to continue a checkpointed run with the same random numbers
+     * @return
+     */
+    inline std::string getState() {
+        std::ostringstream state;
+        state << gen;
+        return state.str();
+    }
+
+    /**
+     * Restores a state returned by getState
+     * @param state
+     */
+    inline void setState(const std::string& state) {
+        std::istringstream stream(state);
+        stream >> gen;
+    }
+
     /**
      * Randomly samples from a real uniform distribution; low value inclusive, high value exclusive
      * @param low
@@ -27,6 +57,18 @@ namespace RandomUtil {
         return distribution(gen);
     }
 
+    /**
+     * Randomly samples from a 64 bit integer uniform distribution; low value inclusive, high value exclusive.
+     * Used for entity ids and triple positions, which can exceed 2^31 with 64 bit ids.
+     * @param low
+     * @param high
+     * @return random integer
+     */
+    inline int64_t uniformLong(const int64_t low, const int64_t high) {
+        std::uniform_int_distribution<int64_t> distribution(low, high - 1);
+        return distribution(gen);
+    }
+
     inline double normalReal(const double mean, const double var) {
         std::normal_distribution<double> distribution(mean, var);
         return distribution(gen);
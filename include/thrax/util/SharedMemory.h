@@ -0,0 +1,61 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_SHAREDMEMORY_H
+#define THRAX_SHAREDMEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+
+/**
+ * Allocation of POSIX shared memory that is shared with child processes created by fork.
+ * Segments are unlinked right after they are mapped, so they are released when the last process unmaps them.
+ */
+namespace SharedMemory {
+    /**
+     * Allocates a zero initialized shared memory segment
+     * @param bytes
+     * @return address of the segment
+     */
+    inline void* allocate(size_t bytes) {
+        static std::atomic<long> counter(0);
+        std::string name = "/thrax-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            BOOST_LOG_TRIVIAL(error) << "Could not create shared memory segment " << name;
+            exit(1);
+        }
+        shm_unlink(name.c_str());
+        if (bytes > 0 && ftruncate(fd, bytes) == -1) {
+            close(fd);
+            BOOST_LOG_TRIVIAL(error) << "Could not allocate " << bytes << " bytes of shared memory";
+            exit(1);
+        }
+        void* address = mmap(nullptr, bytes > 0 ? bytes : 1, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            BOOST_LOG_TRIVIAL(error) << "Could not map " << bytes << " bytes of shared memory";
+            exit(1);
+        }
+        return address;
+    }
+
+    /**
+     * Unmaps a segment allocated by allocate
+     * @param address
+     * @param bytes
+     */
+    inline void release(void* address, size_t bytes) {
+        munmap(address, bytes > 0 ? bytes : 1);
+    }
+}
+
+
+#endif //THRAX_SHAREDMEMORY_H
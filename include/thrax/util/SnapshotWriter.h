@@ -0,0 +1,86 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_SNAPSHOTWRITER_H
+#define THRAX_SNAPSHOTWRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <thrax/model/ModelSnapshot.h>
+
+/**
+ * Writes model snapshots to disk on a background thread. At most one snapshot waits while another one is written: a
+ * newer snapshot replaces the waiting one, so memory stays bounded by two snapshots however slow the disk is. Only use
+ * it for snapshots that supersede each other, e.g. the best model so far in one location.
+ */
+class SnapshotWriter {
+public:
+    SnapshotWriter(): pending(nullptr), stopped(false), writing(false) {
+        thread = std::thread(&SnapshotWriter::run, this);
+    }
+
+    ~SnapshotWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    /**
+     * Schedules a snapshot, replacing the snapshot that waits to be written if any. The writer takes ownership.
+     * @param snapshot
+     */
+    void write(ModelSnapshot* snapshot) {
+        ModelSnapshot* replaced;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            replaced = pending;
+            pending = snapshot;
+        }
+        changed.notify_all();
+        delete replaced;
+    }
+
+    /**
+     * Waits until the pending snapshot is written
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return pending == nullptr && !writing; });
+    }
+
+private:
+    std::thread thread; /** writes the queued snapshots **/
+    std::mutex mutex; /** guards pending, writing and stopped **/
+    std::condition_variable changed; /** signals new snapshots, finished snapshots and stopping **/
+    ModelSnapshot* pending; /** latest snapshot not written yet, nullptr if none **/
+    bool stopped; /** whether the thread should exit once the pending snapshot is written **/
+    bool writing; /** whether the thread is writing a snapshot **/
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this]() { return pending != nullptr || stopped; });
+            if (pending == nullptr) {
+                return;
+            }
+            ModelSnapshot* snapshot = pending;
+            pending = nullptr;
+            writing = true;
+            lock.unlock();
+            snapshot->write();
+            delete snapshot;
+            lock.lock();
+            writing = false;
+            changed.notify_all();
+        }
+    }
+};
+
+
+#endif //THRAX_SNAPSHOTWRITER_H
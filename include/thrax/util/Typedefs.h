@@ -9,9 +9,9 @@
 #include <unordered_map>
 #include <thrax/model/EmbeddingParameterSet.h>
 #include <thrax/struct/Gradient.h>
+#include <thrax/struct/Triple.h>
 #include <Eigen/Dense>
 
-typedef std::unordered_map<std::pair<int, int>, std::vector<int>, boost::hash<std::pair<int, int> > > Pair2ListMap;
 typedef std::unordered_map<std::string, EmbeddingParameterSet> ParameterMap;
 typedef std::unordered_map<std::string, Gradient> GradientMap;
 typedef std::unordered_map<std::string, VectorXd> VectorMap;
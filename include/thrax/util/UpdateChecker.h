@@ -0,0 +1,88 @@
+//
+// Created by root on 19.10.26.
+//
+
+#ifndef THRAX_UPDATECHECKER_H
+#define THRAX_UPDATECHECKER_H
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <thrax/model/BaseModel.h>
+#include <thrax/parameterUpdater/ParameterUpdater.h>
+#include <thrax/parameterUpdater/ParameterUpdaterFactory.h>
+#include "Typedefs.h"
+
+namespace pt = boost::property_tree;
+
+/**
+ * Checks the fused update pass of a parameter updater against the multi-pass path
+ */
+class UpdateChecker {
+public:
+    /**
+     * Checks if the fused update pass (L2, update, apply and normalization in one pass) computes the same parameters as
+     * the separate passes Gradient::l2, ParameterUpdater::calculateUpdate, subtraction and Gradient::normalize.
+     * Both paths run numberOfSteps updates with the gradient of the triple, starting from the model's parameters.
+     * The model's parameters are restored afterwards.
+     * @param model
+     * @param triple
+     * @param updateConfig config of the parameter updater
+     * @param numberOfSteps
+     * @param delta error threshold
+     */
+    static void checkFusedUpdate(BaseModel* model, Triple& triple, pt::ptree updateConfig, int numberOfSteps=3, double delta=1e-10) {
+        ParameterMap originalParameters = model->getParameters();
+        ParameterMap fusedParameters = model->getParameters();
+        const RegularizationMap& regularization = model->getRegularization(1.0);
+
+        // both updaters start with fresh state
+        updateConfig.put("fused", false);
+        ParameterUpdater* multiPassUpdater = ParameterUpdaterFactory::buildParameterUpdater(originalParameters, updateConfig);
+        updateConfig.put("fused", true);
+        ParameterUpdater* fusedUpdater = ParameterUpdaterFactory::buildParameterUpdater(fusedParameters, updateConfig);
+
+        for (int i = 0; i < numberOfSteps; ++i) {
+            model->resetGradients();
+            model->gradient(triple, 1.0);
+            GradientMap fusedGradients = model->getGradients();
+
+            // multi-pass path on the model's parameters
+            for (auto& ptr: regularization) {
+                model->getGradient(ptr.first).l2(ptr.second.lambda);
+            }
+            multiPassUpdater->calculateUpdate(model->getGradients());
+            for (auto& gradient: model->getGradients()) {
+                for (auto& ptr: gradient.second.getIdToCol()) {
+                    model->getParameter(gradient.first).col(ptr.first) -= gradient.second.col(ptr.second);
+                }
+            }
+            for (auto& ptr: regularization) {
+                if (ptr.second.normalize) {
+                    model->getGradient(ptr.first).normalize();
+                }
+            }
+
+            // fused path on a copy of the parameters
+            fusedUpdater->update(fusedGradients, fusedParameters, regularization);
+        }
+
+        // compare and restore parameters
+        double error = 0.0;
+        for (auto& parameter: originalParameters) {
+            error = std::max(error, (model->getParameter(parameter.first) - fusedParameters.at(parameter.first)).cwiseAbs().maxCoeff());
+            model->getParameter(parameter.first) = parameter.second;
+        }
+        model->resetGradients();
+        delete multiPassUpdater;
+        delete fusedUpdater;
+
+        if (error < delta) {
+            BOOST_LOG_TRIVIAL(info) << "Passed fused update checking, error: " << error;
+        } else {
+            BOOST_LOG_TRIVIAL(info) << "Failed fused update checking, error: " << error;
+        }
+    }
+};
+
+
+#endif //THRAX_UPDATECHECKER_H
@@ -9,24 +9,36 @@
 #include <boost/log/expressions.hpp>
 #include "boost/variant.hpp"
 
+#include <thrax/struct/CandidateIndex.h>
 #include <thrax/struct/Data.h>
 #include <thrax/model/BaseModel.h>
 #include <thrax/model/TrivialEnsemble.h>
 #include <thrax/model/ModelFactory.h>
 #include <thrax/optimizer/Optimizer.h>
+#include <thrax/optimizer/PartitionedOptimizer.h>
+#include <thrax/optimizer/MultiProcessOptimizer.h>
+#include <thrax/optimizer/ParameterServerOptimizer.h>
 #include <thrax/evaluation/Evaluation.h>
+#include <thrax/evaluation/TripleClassification.h>
 #include <thrax/util/GradientChecker.h>
+#include <thrax/util/UpdateChecker.h>
+#include <thrax/util/Benchmark.h>
 
 namespace pt = boost::property_tree;
+namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 namespace logging = boost::log;
 
 int main(int argc, char** argv) {
     std::string configFilePath;
+    std::string resumeLocation;
+    int serverPort = 0;
     po::options_description description("Allowed options");
     description.add_options()
             ("help,h", "produce help message")
-            ("configFile,c", po::value<std::string>(&configFilePath)->required()->default_value("./config/config.json"), "path to config file");
+            ("configFile,c", po::value<std::string>(&configFilePath)->required()->default_value("./config/config.json"), "path to config file")
+            ("resume,r", po::value<std::string>(&resumeLocation), "model directory of an interrupted run, continues training from its checkpoint; uses the config in the directory unless configFile is given")
+            ("parameter-server", po::value<int>(&serverPort), "run a parameter server on this port for a trainer with the same config and model.parameterServer.hosts, instead of training");
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, description), vm);
     po::notify(vm);
@@ -40,17 +52,28 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    // load config
+    // load config, a resumed run dumps into the directory of the interrupted run
+    fs::path resumePath(resumeLocation);
+    if (resumePath.filename() == ".") {
+        resumePath = resumePath.parent_path();
+    }
+    if (!resumeLocation.empty() && vm["configFile"].defaulted()) {
+        configFilePath = (resumePath / "config.json").string();
+    }
     BOOST_LOG_TRIVIAL(info) << "Using config file " << configFilePath;
     pt::ptree config;
     pt::read_json(configFilePath, config);
+    if (!resumeLocation.empty()) {
+        config.put("model.serialization.dumpDirectory", resumePath.parent_path().empty() ? "." : resumePath.parent_path().string());
+        config.put("model.serialization.dumpLocation", resumePath.filename().string());
+    }
 
     // example access properties
     std::string dataDirectory = config.get<std::string>("data.dir");
     std::string trainPath = dataDirectory + config.get<std::string>("data.trainFile");
     std::string testPath = dataDirectory + config.get<std::string>("data.testFile");
     std::string validPath = dataDirectory + config.get<std::string>("data.validFile");
-    int limit = config.get<int>("data.limit", -1);
+    TripleId limit = config.get<TripleId>("data.limit", -1);
     BOOST_LOG_TRIVIAL(info) << "Using data files in directory " << dataDirectory;
 
     // load train data
@@ -60,7 +83,7 @@ int main(int argc, char** argv) {
         trainData.loadMappings(dumpLocation);
     }
     trainData.load(trainPath, false, limit);
-    if (config.get<bool>("data.dumpMappings", true)) {
+    if (config.get<bool>("data.dumpMappings", true) && serverPort == 0) {
         std::string dumpLocation = config.get<std::string>("data.dumpLocation", "auto");
         trainData.dumpMappings(dumpLocation);
     }
@@ -69,12 +92,12 @@ int main(int argc, char** argv) {
 
     // load validation data
     Data validData;
-    validData.setMaps(trainData.getEntityMap(), trainData.getRelationMap());
+    validData.setVocabularies(trainData.getEntityVocabulary(), trainData.getRelationVocabulary());
     validData.load(validPath, ignoreNewConstituents, limit);
 
     // load test data
     Data testData;
-    testData.setMaps(trainData.getEntityMap(), trainData.getRelationMap());
+    testData.setVocabularies(trainData.getEntityVocabulary(), trainData.getRelationVocabulary());
     testData.load(testPath, ignoreNewConstituents, limit);
 
     // optionally append validation data to train data
@@ -83,6 +106,22 @@ int main(int argc, char** argv) {
         trainData.addTriples(validData);
     }
 
+    // optionally load the type constraints of the relations
+    std::string typeConstraints = config.get<std::string>("data.typeConstraints", "none");
+    CandidateIndex* candidateIndex = nullptr;
+    if (typeConstraints != "none") {
+        candidateIndex = CandidateIndex::buildCandidateIndex(typeConstraints, trainData);
+    } else if (config.get<bool>("optimizer.sampling.typeConstrained", false) || config.get<bool>("optimizer.earlyStopping.typeConstrained", false)) {
+        BOOST_LOG_TRIVIAL(error) << "Type-constrained sampling and early stopping need data.typeConstraints";
+        return 1;
+    }
+
+    // optionally benchmark the data structures
+    bool benchmark = config.get<bool>("benchmark", false);
+    if (benchmark) {
+        Benchmark::benchmarkTripleIndex({&trainData, &validData, &testData});
+    }
+
     // set up model
     AbstractModel* model;
     std::string modelType = config.get<std::string>("model.type");
@@ -96,25 +135,119 @@ int main(int argc, char** argv) {
         model = ModelFactory::buildModel(&trainData, config.get_child("model"));
     }
 
+    // optionally benchmark the exchange of gradients between workers
+    if (benchmark) {
+        Benchmark::benchmarkGradientExchange(model, &trainData, config);
+        return 0;
+    }
+
+    // optionally serve a shard of the parameters to a trainer on another host
+    if (serverPort > 0) {
+        BaseModel* serverModel = dynamic_cast<BaseModel*>(model);
+        if (serverModel == nullptr || serverModel->getNumberOfServers() == 0) {
+            BOOST_LOG_TRIVIAL(error) << "--parameter-server needs model.parameterServer.numberOfServers > 0";
+            return 1;
+        }
+        TcpTransport::runServer(serverPort, serverModel->getNumberOfServers(), ParameterServer::builder(serverModel, trainData.getNumberOfEntities(), config.get_child("model.update")));
+        return 0;
+    }
+
     FileUtil::dumpConfig(model->getDumpLocation(), config);
 
-    // set up optimizer
-    Optimizer* optimizer = new Optimizer(&trainData, &validData, &testData, model, config);
+    // set up optimizer, partitioned training keeps only two entity partitions in memory
+    Optimizer* optimizer;
+    BaseModel* baseModel = dynamic_cast<BaseModel*>(model);
+    bool partitioned = baseModel != nullptr && baseModel->getNumberOfPartitions() > 1;
+    int numberOfProcesses = config.get<int>("optimizer.numberOfProcesses", 1);
+    bool sharded = baseModel != nullptr && baseModel->getNumberOfServers() > 0;
+    if ((partitioned || sharded) && numberOfProcesses > 1) {
+        BOOST_LOG_TRIVIAL(error) << "Partitioned training and parameter servers do not support optimizer.numberOfProcesses > 1";
+        return 1;
+    }
+    if (partitioned && sharded) {
+        BOOST_LOG_TRIVIAL(error) << "Partitioned training does not support parameter servers";
+        return 1;
+    }
+    bool checkpointing = config.get<int>("optimizer.checkpoint.everyNEpochs", 0) > 0 || !resumeLocation.empty();
+    if (checkpointing && (partitioned || sharded || numberOfProcesses > 1)) {
+        BOOST_LOG_TRIVIAL(error) << "Checkpoints are not supported with partitioned training, parameter servers or optimizer.numberOfProcesses > 1";
+        return 1;
+    }
+    if (checkpointing && config.get<bool>("optimizer.earlyStopping.concurrent", false)) {
+        BOOST_LOG_TRIVIAL(error) << "Checkpoints are not supported with optimizer.earlyStopping.concurrent";
+        return 1;
+    }
+    if (partitioned) {
+        optimizer = new PartitionedOptimizer(&trainData, &validData, &testData, baseModel, config);
+    } else if (sharded) {
+        optimizer = new ParameterServerOptimizer(&trainData, &validData, &testData, baseModel, config);
+    } else if (numberOfProcesses > 1) {
+        optimizer = new MultiProcessOptimizer(&trainData, &validData, &testData, model, config);
+    } else {
+        optimizer = new Optimizer(&trainData, &validData, &testData, model, config);
+    }
+    if (candidateIndex != nullptr) {
+        optimizer->setCandidateIndex(candidateIndex);
+    }
+    if (!resumeLocation.empty()) {
+        optimizer->resume();
+    }
     BOOST_LOG_TRIVIAL(info) << "##### START OF TRAINING #####";
     optimizer->fit();
+    if (!optimizer->isModelComplete()) {
+        BOOST_LOG_TRIVIAL(info) << "The entity embeddings are only dumped to " << model->getDumpLocation() << ", evaluation is skipped";
+        return 0;
+    }
 
     // optionally check gradients
     if (config.get<bool>("checkGradients", false)) {
-        Triple& triple = trainData.getTriple(0);
+        Triple triple = trainData.getTriple(0);
         GradientChecker::checkGradients(dynamic_cast<BaseModel*>(model), triple);
         return 0;
     }
 
+    // optionally check the fused update pass
+    if (config.get<bool>("checkUpdates", false)) {
+        Triple triple = trainData.getTriple(0);
+        UpdateChecker::checkFusedUpdate(dynamic_cast<BaseModel*>(model), triple, config.get_child("model.update"));
+        return 0;
+    }
+
+    std::vector<Data*> lookupDataSets {&trainData, &validData, &testData};
+
+    // optionally classify triples with thresholds calibrated on the validation data
+    if (config.get<bool>("classification.useClassification", false)) {
+        BOOST_LOG_TRIVIAL(info) << "##### START OF TRIPLE CLASSIFICATION #####";
+        TripleClassification classification(&trainData, lookupDataSets, candidateIndex, config.get<TripleId>("classification.batchSize", 4096),
+                                             config.get<unsigned>("classification.seed", 1));
+        classification.calibrate(model, &validData, model->getDumpLocation());
+        if (config.get<bool>("optimizer.testOnValidation", false)) {
+            classification.evaluate(model, &validData, model->getDumpLocation());
+        } else {
+            classification.evaluate(model, &testData, model->getDumpLocation());
+        }
+        std::string input = config.get<std::string>("classification.input", "none");
+        if (input != "none") {
+            std::string output = config.get<std::string>("classification.output", "auto");
+            if (output == "auto") {
+                output = (fs::path(model->getDumpLocation()) / "classification.tsv").string();
+            }
+            classification.classify(model, input, output);
+        }
+        if (config.get<bool>("classification.only", false)) {
+            return 0;
+        }
+    }
+
     BOOST_LOG_TRIVIAL(info) << "##### START OF EVALUATION #####";
 
     // set up evaluation
-    std::vector<Data*> lookupDataSets {&trainData, &validData, &testData};
-    Evaluation evaluation(lookupDataSets);
+    Evaluation evaluation(lookupDataSets, candidateIndex, Evaluation::parseTiePolicy(config.get<std::string>("evaluation.ties", "optimistic")));
+    EntityId sampledCandidates = config.get<EntityId>("evaluation.sampled.numberOfCandidates", 0);
+    if (sampledCandidates > 0) {
+        evaluation.setSampledCandidates(trainData.getNumberOfEntities(), sampledCandidates, config.get<unsigned>("evaluation.sampled.seed", 1),
+                                        config.get<bool>("evaluation.sampled.only", false));
+    }
     if (config.get<bool>("optimizer.testOnValidation", false)) {
         evaluation.evaluate(model, &validData, model->getDumpLocation());
     } else {